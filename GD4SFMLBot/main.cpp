@@ -0,0 +1,242 @@
+#include "BotClient.hpp"
+#include "NetworkProtocol.hpp"
+#include "SocketPoller.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//Load generator: connects bots to a GameServer, lets them play, then reports what the server kept up
+//Usage: GD4SFMLBot [--host ADDRESS] [--port N] [--room N] [--bots N] [--duration SECONDS] [--connect-rate N]
+
+namespace
+{
+	volatile std::sig_atomic_t g_running = 1;
+
+	struct BotSettings
+	{
+		sf::IpAddress m_host = sf::IpAddress::LocalHost;
+		unsigned short m_port = SERVER_PORT;
+		sf::Int32 m_room = Client::kAnyRoom;
+		std::size_t m_bots = 16;
+		sf::Time m_duration = sf::seconds(30.f);
+		//Bots connected per second, a slower ramp shows where the server starts to struggle
+		float m_connect_rate = 50.f;
+	};
+
+	const sf::Time kConnectTimeout = sf::seconds(2.f);
+	const sf::Time kPollInterval = sf::milliseconds(5);
+
+	void HandleSignal(int)
+	{
+		g_running = 0;
+	}
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: GD4SFMLBot [--host ADDRESS] [--port N] [--room N] [--bots N] [--duration SECONDS] [--connect-rate N]" << std::endl;
+	}
+
+	bool ParseArguments(int argc, char* argv[], BotSettings& settings)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string argument = argv[i];
+			if (argument == "--help" || argument == "-h")
+			{
+				return false;
+			}
+
+			if (i + 1 >= argc)
+			{
+				std::cout << "Missing value for " << argument << std::endl;
+				return false;
+			}
+
+			std::string value = argv[++i];
+			if (argument == "--host")
+			{
+				settings.m_host = sf::IpAddress(value);
+			}
+			else if (argument == "--port")
+			{
+				settings.m_port = static_cast<unsigned short>(std::stoi(value));
+			}
+			else if (argument == "--room")
+			{
+				settings.m_room = std::stoi(value);
+			}
+			else if (argument == "--bots")
+			{
+				settings.m_bots = static_cast<std::size_t>(std::stoul(value));
+			}
+			else if (argument == "--duration")
+			{
+				settings.m_duration = sf::seconds(std::stof(value));
+			}
+			else if (argument == "--connect-rate")
+			{
+				settings.m_connect_rate = std::stof(value);
+				if (settings.m_connect_rate <= 0.f)
+				{
+					throw std::runtime_error("Connect rate must be positive");
+				}
+			}
+			else
+			{
+				std::cout << "Unknown argument " << argument << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//Milliseconds at the given fraction of the sorted samples
+	float Percentile(std::vector<sf::Int64>& samples, float fraction)
+	{
+		if (samples.empty())
+		{
+			return 0.f;
+		}
+		std::size_t index = std::min(samples.size() - 1, static_cast<std::size_t>(fraction * samples.size()));
+		std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+		return samples[index] / 1000.f;
+	}
+
+	void Report(const std::vector<std::unique_ptr<BotClient>>& bots, std::size_t failed_connections, sf::Time end_time)
+	{
+		std::vector<sf::Int64> tick_intervals;
+		std::vector<sf::Int64> round_trip_times;
+		sf::Int64 ticks = 0;
+		sf::Time tick_span = sf::Time::Zero;
+		float received_rate = 0.f;
+		float sent_rate = 0.f;
+		std::size_t connected = bots.size();
+		std::size_t dropped = 0;
+
+		for (const auto& bot : bots)
+		{
+			const BotStatistics& statistics = bot->GetStatistics();
+			if (!bot->IsConnected())
+			{
+				++dropped;
+			}
+
+			tick_intervals.insert(tick_intervals.end(), statistics.m_tick_intervals.begin(), statistics.m_tick_intervals.end());
+			round_trip_times.insert(round_trip_times.end(), statistics.m_round_trip_times.begin(), statistics.m_round_trip_times.end());
+			ticks += statistics.m_last_tick - statistics.m_first_tick;
+			tick_span += statistics.m_last_tick_time - statistics.m_first_tick_time;
+
+			float seconds = (end_time - statistics.m_connect_time).asSeconds();
+			if (seconds > 0.f)
+			{
+				received_rate += statistics.m_bytes_received / seconds;
+				sent_rate += statistics.m_bytes_sent / seconds;
+			}
+		}
+
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "Bots: " << connected << " connected, " << failed_connections << " failed to connect, " << dropped << " dropped" << std::endl;
+		if (connected == 0)
+		{
+			return;
+		}
+		std::cout << "Ticks: " << (tick_span > sf::Time::Zero ? ticks / tick_span.asSeconds() : 0.f) << "/s" << std::endl;
+		std::cout << "Tick duration: p50 " << Percentile(tick_intervals, 0.5f) << " ms, p99 " << Percentile(tick_intervals, 0.99f) << " ms" << std::endl;
+		std::cout << "Round trip: p50 " << Percentile(round_trip_times, 0.5f) << " ms, p99 " << Percentile(round_trip_times, 0.99f) << " ms" << std::endl;
+		std::cout << "Bandwidth per client: " << received_rate / connected / 1024.f << " KB/s down, " << sent_rate / connected / 1024.f << " KB/s up" << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		BotSettings settings;
+		if (!ParseArguments(argc, argv, settings))
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+
+		std::signal(SIGINT, HandleSignal);
+		std::signal(SIGTERM, HandleSignal);
+
+		std::vector<std::unique_ptr<BotClient>> bots;
+		std::size_t failed_connections = 0;
+		SocketPoller poller;
+		sf::Clock clock;
+
+		//Bots join gradually, then everyone plays until the duration is up
+		std::cout << "Connecting " << settings.m_bots << " bots to " << settings.m_host << ":" << settings.m_port << std::endl;
+		while (g_running && clock.getElapsedTime() < settings.m_duration)
+		{
+			sf::Time now = clock.getElapsedTime();
+			std::size_t attempts = bots.size() + failed_connections;
+			while (attempts < settings.m_bots && attempts < now.asSeconds() * settings.m_connect_rate + 1)
+			{
+				std::unique_ptr<BotClient> bot(new BotClient());
+				if (bot->Connect(settings.m_host, settings.m_port, settings.m_room, kConnectTimeout, clock.getElapsedTime()))
+				{
+					bot->Register(poller, bots.size() * 2, bots.size() * 2 + 1);
+					bots.emplace_back(std::move(bot));
+				}
+				else
+				{
+					++failed_connections;
+				}
+				++attempts;
+			}
+
+			//Each bot has a TCP and a UDP socket, the key tells them apart
+			poller.Wait(kPollInterval);
+			now = clock.getElapsedTime();
+			for (std::size_t key : poller.GetReady())
+			{
+				BotClient& bot = *bots[key / 2];
+				if (key % 2 == 0)
+				{
+					bot.HandlePackets(now);
+				}
+				else
+				{
+					bot.HandleDatagrams(now);
+				}
+
+				//A closed socket stays readable, so a bot the server dropped leaves the poller
+				if (!bot.IsConnected())
+				{
+					bot.Disconnect(poller);
+				}
+			}
+
+			for (auto& bot : bots)
+			{
+				bot->Update(now);
+			}
+		}
+
+		sf::Time end_time = clock.getElapsedTime();
+		Report(bots, failed_connections, end_time);
+
+		for (auto& bot : bots)
+		{
+			bot->Disconnect(poller);
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::cout << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -10,11 +10,12 @@
 
 const sf::Time Application::kTimePerFrame = sf::seconds(1.f / 60.f);
 
-Application::Application()
+Application::Application(const ReplaySettings& replay)
 	: m_window(sf::VideoMode(1024, 768), "Networked", sf::Style::Close)
 	, m_key_binding_1(1)
 	, m_key_binding_2(2)
 	, m_stack(State::Context(m_window, m_textures, m_fonts, m_music, m_sound, m_key_binding_1, m_key_binding_2))
+	, m_replay_settings(replay)
 {
 	m_window.setKeyRepeatEnabled(false);
 
@@ -27,7 +28,7 @@ Application::Application()
 	m_textures.Load(Texture::kGameOver, "Media/Textures/GameOver.jpg");
 
 	RegisterStates();
-	m_stack.PushState(StateID::kTitle);
+	m_stack.PushState(m_replay_settings.m_path.empty() ? StateID::kTitle : StateID::kReplay);
 }
 
 void Application::Run()
@@ -36,6 +37,19 @@ void Application::Run()
 	sf::Time time_since_last_update = sf::Time::Zero;
 	while (m_window.isOpen())
 	{
+		//A benchmark replay steps the usual frame time every frame however long the frame really took
+		if (m_replay_settings.m_unthrottled)
+		{
+			ProcessInput();
+			Update(kTimePerFrame);
+			if (m_stack.IsEmpty())
+			{
+				m_window.close();
+			}
+			Render();
+			continue;
+		}
+
 		time_since_last_update += clock.restart();
 		while (time_since_last_update > kTimePerFrame)
 		{
@@ -85,6 +99,7 @@ void Application::RegisterStates()
 	m_stack.RegisterState<GameState>(StateID::kGame);
 	m_stack.RegisterState<MultiplayerGameState>(StateID::kHostGame, true);
 	m_stack.RegisterState<MultiplayerGameState>(StateID::kJoinGame, false);
+	m_stack.RegisterState<MultiplayerGameState>(StateID::kReplay, false, m_replay_settings);
 	m_stack.RegisterState<PauseState>(StateID::kPause);
 	m_stack.RegisterState<PauseState>(StateID::kNetworkPause, true);
 	m_stack.RegisterState<SettingsState>(StateID::kSettings);
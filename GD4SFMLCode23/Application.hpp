@@ -4,6 +4,7 @@
 #include <SFML/System/Time.hpp>
 
 #include "KeyBinding.hpp"
+#include "ReplaySettings.hpp"
 #include "Player.hpp"
 #include "ResourceHolder.hpp"
 #include "ResourceIdentifiers.hpp"
@@ -15,7 +16,7 @@
 class Application
 {
 public:
-	Application();
+	explicit Application(const ReplaySettings& replay = ReplaySettings());
 	void Run();
 
 private:
@@ -38,5 +39,7 @@ private:
 
 	KeyBinding m_key_binding_1;
 	KeyBinding m_key_binding_2;
+
+	ReplaySettings m_replay_settings;
 };
 
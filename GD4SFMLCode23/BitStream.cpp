@@ -0,0 +1,183 @@
+#include "BitStream.hpp"
+#include <SFML/Network/Packet.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+unsigned int BitsRequired(sf::Uint32 max_value)
+{
+	unsigned int bits = 1;
+	while (bits < 32 && (max_value >> bits) != 0)
+	{
+		++bits;
+	}
+	return bits;
+}
+
+BitWriter::BitWriter()
+	: m_bit_count(0)
+{
+}
+
+void BitWriter::Write(sf::Uint32 value, unsigned int bits)
+{
+	assert(bits <= 32);
+	for (unsigned int i = bits; i > 0; --i)
+	{
+		if (m_bit_count % 8 == 0)
+		{
+			m_data.push_back(0);
+		}
+		if ((value >> (i - 1)) & 1u)
+		{
+			m_data.back() |= static_cast<sf::Uint8>(0x80u >> (m_bit_count % 8));
+		}
+		++m_bit_count;
+	}
+}
+
+void BitWriter::WriteBool(bool value)
+{
+	Write(value ? 1u : 0u, 1);
+}
+
+void BitWriter::WriteCompact(sf::Uint32 value)
+{
+	//The length field holds bits - 1 so that all 32 bit values fit in 5 bits
+	unsigned int bits = BitsRequired(value);
+	Write(bits - 1, 5);
+	Write(value, bits);
+}
+
+void BitWriter::WriteTime(sf::Int64 microseconds)
+{
+	sf::Uint64 value = static_cast<sf::Uint64>(microseconds);
+	Write(static_cast<sf::Uint32>(value >> 32), 32);
+	Write(static_cast<sf::Uint32>(value), 32);
+}
+
+void BitWriter::Append(const BitWriter& other)
+{
+	BitReader reader(other.GetData(), other.GetByteCount());
+	std::size_t remaining = other.GetBitCount();
+	while (remaining > 0)
+	{
+		unsigned int bits = static_cast<unsigned int>(std::min<std::size_t>(remaining, 32));
+		Write(reader.Read(bits), bits);
+		remaining -= bits;
+	}
+}
+
+std::size_t BitWriter::GetBitCount() const
+{
+	return m_bit_count;
+}
+
+std::size_t BitWriter::GetByteCount() const
+{
+	return m_data.size();
+}
+
+const sf::Uint8* BitWriter::GetData() const
+{
+	return m_data.empty() ? nullptr : &m_data[0];
+}
+
+void BitWriter::AppendTo(sf::Packet& packet) const
+{
+	if (!m_data.empty())
+	{
+		packet.append(&m_data[0], m_data.size());
+	}
+}
+
+BitReader::BitReader(const void* data, std::size_t size)
+	: m_data(static_cast<const sf::Uint8*>(data))
+	, m_bit_count(size * 8)
+	, m_bit_position(0)
+	, m_valid(true)
+{
+}
+
+BitReader::BitReader(const sf::Packet& packet, std::size_t byte_offset)
+	: m_data(static_cast<const sf::Uint8*>(packet.getData()) + byte_offset)
+	, m_bit_count(packet.getDataSize() > byte_offset ? (packet.getDataSize() - byte_offset) * 8 : 0)
+	, m_bit_position(0)
+	, m_valid(packet.getDataSize() >= byte_offset)
+{
+}
+
+sf::Uint32 BitReader::Read(unsigned int bits)
+{
+	assert(bits <= 32);
+	if (!m_valid || m_bit_position + bits > m_bit_count)
+	{
+		m_valid = false;
+		return 0;
+	}
+
+	sf::Uint32 value = 0;
+	for (unsigned int i = 0; i < bits; ++i)
+	{
+		sf::Uint8 byte = m_data[m_bit_position / 8];
+		value = (value << 1) | ((byte >> (7 - m_bit_position % 8)) & 1u);
+		++m_bit_position;
+	}
+	return value;
+}
+
+bool BitReader::ReadBool()
+{
+	return Read(1) != 0;
+}
+
+sf::Uint32 BitReader::ReadCompact()
+{
+	unsigned int bits = Read(5) + 1;
+	return Read(bits);
+}
+
+sf::Int64 BitReader::ReadTime()
+{
+	sf::Uint64 high = Read(32);
+	sf::Uint64 low = Read(32);
+	return static_cast<sf::Int64>((high << 32) | low);
+}
+
+bool BitReader::IsValid() const
+{
+	return m_valid;
+}
+
+Quantizer::Quantizer(float min, float max, float precision)
+	: m_min(min)
+	, m_precision(precision)
+	, m_max_value(static_cast<sf::Uint32>(std::ceil((max - min) / precision)))
+	, m_bits(BitsRequired(m_max_value))
+{
+	assert(max > min && precision > 0.f);
+}
+
+sf::Uint32 Quantizer::Quantize(float value) const
+{
+	//Values outside the range are clamped to its edges
+	float steps = std::round((value - m_min) / m_precision);
+	steps = std::max(0.f, std::min(steps, static_cast<float>(m_max_value)));
+	return static_cast<sf::Uint32>(steps);
+}
+
+float Quantizer::Dequantize(sf::Uint32 value) const
+{
+	return m_min + static_cast<float>(value) * m_precision;
+}
+
+unsigned int Quantizer::GetBits() const
+{
+	return m_bits;
+}
+
+sf::Uint32 Quantizer::GetMaxValue() const
+{
+	return m_max_value;
+}
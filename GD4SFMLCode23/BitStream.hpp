@@ -0,0 +1,73 @@
+#pragma once
+#include <SFML/Config.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace sf
+{
+	class Packet;
+}
+
+//Number of bits needed to hold every value from 0 to max_value
+unsigned int BitsRequired(sf::Uint32 max_value);
+
+//Packs values into the smallest number of bits, most significant bit first
+class BitWriter
+{
+public:
+	BitWriter();
+	void Write(sf::Uint32 value, unsigned int bits);
+	void WriteBool(bool value);
+	//Small values cost few bits: a 5 bit length followed by the value itself
+	void WriteCompact(sf::Uint32 value);
+	//Times are sent as 64 bit microsecond counts
+	void WriteTime(sf::Int64 microseconds);
+	void Append(const BitWriter& other);
+
+	std::size_t GetBitCount() const;
+	std::size_t GetByteCount() const;
+	const sf::Uint8* GetData() const;
+	void AppendTo(sf::Packet& packet) const;
+
+private:
+	std::vector<sf::Uint8> m_data;
+	std::size_t m_bit_count;
+};
+
+//Reads back what a BitWriter produced, reading past the end marks the reader invalid and returns zeroes
+class BitReader
+{
+public:
+	BitReader(const void* data, std::size_t size);
+	//Reads the bytes of a packet that follow the first byte_offset bytes
+	BitReader(const sf::Packet& packet, std::size_t byte_offset);
+	sf::Uint32 Read(unsigned int bits);
+	bool ReadBool();
+	sf::Uint32 ReadCompact();
+	sf::Int64 ReadTime();
+	bool IsValid() const;
+
+private:
+	const sf::Uint8* m_data;
+	std::size_t m_bit_count;
+	std::size_t m_bit_position;
+	bool m_valid;
+};
+
+//Maps floats in [min, max] onto integers at a fixed precision
+class Quantizer
+{
+public:
+	Quantizer(float min, float max, float precision);
+	sf::Uint32 Quantize(float value) const;
+	float Dequantize(sf::Uint32 value) const;
+	unsigned int GetBits() const;
+	sf::Uint32 GetMaxValue() const;
+
+private:
+	float m_min;
+	float m_precision;
+	sf::Uint32 m_max_value;
+	unsigned int m_bits;
+};
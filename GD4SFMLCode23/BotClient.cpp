@@ -0,0 +1,448 @@
+#include "BotClient.hpp"
+
+#include "Action.hpp"
+#include "MessageBatch.hpp"
+#include "PositionCodec.hpp"
+#include "Snapshot.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+
+namespace
+{
+	//The same rates MultiplayerGameState runs at, one command per frame and input sent 20 times a second
+	const sf::Time kFrameTime = sf::milliseconds(16);
+	const sf::Time kInputInterval = sf::milliseconds(50);
+	const sf::Time kHelloInterval = sf::milliseconds(250);
+	const std::size_t kMaxPendingCommands = 32;
+
+	//A bot holds a direction for a while, then picks another one
+	const sf::Uint8 kDirections[] =
+	{
+		0,
+		InputCommand::kMoveLeft,
+		InputCommand::kMoveRight,
+		InputCommand::kMoveUp,
+		InputCommand::kMoveDown,
+		InputCommand::kMoveLeft | InputCommand::kMoveUp,
+		InputCommand::kMoveRight | InputCommand::kMoveUp,
+		InputCommand::kMoveLeft | InputCommand::kMoveDown,
+		InputCommand::kMoveRight | InputCommand::kMoveDown
+	};
+
+	sf::Time RandomDelay(int min_milliseconds, int max_milliseconds)
+	{
+		return sf::milliseconds(min_milliseconds + Utility::RandomInt(max_milliseconds - min_milliseconds));
+	}
+}
+
+BotStatistics::BotStatistics()
+	: m_connect_time(sf::Time::Zero)
+	, m_bytes_sent(0)
+	, m_bytes_received(0)
+	, m_snapshots_received(0)
+	, m_first_tick(0)
+	, m_last_tick(0)
+	, m_first_tick_time(sf::Time::Zero)
+	, m_last_tick_time(sf::Time::Zero)
+{
+}
+
+BotClient::BotClient()
+	: m_connected(false)
+	, m_registered(false)
+	, m_udp_token(0)
+	, m_server_udp_port(0)
+	, m_udp_offered(false)
+	, m_udp_confirmed(false)
+	, m_udp_out_sequence(0)
+	, m_udp_in_sequence(0)
+	, m_identifier(0)
+	, m_tick_rate(sf::seconds(1.f / 20.f))
+	, m_buttons(0)
+	, m_aim(0)
+	, m_next_sequence(1)
+	, m_last_command_time(sf::Time::Zero)
+	, m_last_input_time(sf::Time::Zero)
+	, m_next_turn_time(sf::Time::Zero)
+	, m_next_shot_time(sf::Time::Zero)
+	, m_last_ping_time(sf::Time::Zero)
+	, m_last_hello_time(sf::Time::Zero)
+{
+}
+
+bool BotClient::Connect(const sf::IpAddress& address, unsigned short port, sf::Int32 room_identifier, sf::Time timeout, sf::Time now)
+{
+	if (m_socket.connect(address, port, timeout) != sf::Socket::Done)
+	{
+		return false;
+	}
+
+	//The UDP socket is bound up front so it can be registered with the poller straight away
+	if (m_udp_socket.bind(sf::Socket::AnyPort) != sf::Socket::Done)
+	{
+		m_socket.disconnect();
+		return false;
+	}
+
+	m_socket.setBlocking(false);
+	m_udp_socket.setBlocking(false);
+	m_server_address = address;
+	m_connected = true;
+	m_statistics.m_connect_time = now;
+	m_last_command_time = now;
+	m_last_input_time = now;
+	m_last_ping_time = now;
+	m_next_turn_time = now + RandomDelay(500, 2500);
+	m_next_shot_time = now + RandomDelay(1000, 3000);
+
+	sf::Packet packet;
+	packet << static_cast<sf::Int32>(Client::PacketType::kJoinRoom) << room_identifier;
+	Send(packet);
+	return true;
+}
+
+void BotClient::Disconnect(SocketPoller& poller)
+{
+	if (m_connected)
+	{
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(Client::PacketType::kQuit);
+		Send(packet);
+		m_connected = false;
+	}
+
+	if (!m_registered)
+	{
+		return;
+	}
+
+	poller.Remove(m_socket);
+	poller.Remove(m_udp_socket);
+	m_registered = false;
+	m_socket.disconnect();
+	m_udp_socket.unbind();
+}
+
+bool BotClient::IsConnected() const
+{
+	return m_connected;
+}
+
+void BotClient::Register(SocketPoller& poller, std::size_t tcp_key, std::size_t udp_key)
+{
+	poller.Add(m_socket, tcp_key);
+	poller.Add(m_udp_socket, udp_key);
+	m_registered = true;
+}
+
+void BotClient::HandlePackets(sf::Time now)
+{
+	sf::Packet packet;
+	sf::Socket::Status status;
+	while ((status = m_socket.receive(packet)) == sf::Socket::Done)
+	{
+		m_statistics.m_bytes_received += packet.getDataSize() + sizeof(sf::Uint32);
+		sf::Int32 packet_type;
+		packet >> packet_type;
+		HandlePacket(packet_type, packet, now);
+		packet.clear();
+	}
+
+	if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+	{
+		m_connected = false;
+	}
+}
+
+void BotClient::HandleDatagrams(sf::Time now)
+{
+	sf::Packet packet;
+	sf::IpAddress sender;
+	unsigned short sender_port;
+	while (m_udp_socket.receive(packet, sender, sender_port) == sf::Socket::Done)
+	{
+		m_statistics.m_bytes_received += packet.getDataSize();
+		BitReader reader(packet.getData(), packet.getDataSize());
+		sf::Uint16 sequence = static_cast<sf::Uint16>(reader.Read(Datagram::kSequenceBits));
+		Server::PacketType packet_type = static_cast<Server::PacketType>(reader.Read(Server::kPacketTypeBits));
+		if (sender == m_server_address && reader.IsValid() && Datagram::IsNewer(sequence, m_udp_in_sequence))
+		{
+			m_udp_confirmed = true;
+			m_udp_in_sequence = sequence;
+			if (packet_type == Server::PacketType::kUpdateClientState)
+			{
+				HandleSnapshot(reader, now);
+			}
+			else if (packet_type == Server::PacketType::kPong)
+			{
+				HandlePong(reader, now);
+			}
+		}
+		packet.clear();
+	}
+}
+
+void BotClient::Update(sf::Time now)
+{
+	if (!m_connected)
+	{
+		return;
+	}
+
+	if (m_udp_offered && !m_udp_confirmed && now - m_last_hello_time >= kHelloInterval)
+	{
+		SendDatagram(Client::PacketType::kUdpHello, BitWriter());
+		m_last_hello_time = now;
+	}
+
+	if (m_identifier != 0)
+	{
+		if (now >= m_next_turn_time)
+		{
+			//Held keys and aim only travel in the input commands, like a real client's
+			m_buttons = kDirections[Utility::RandomInt(sizeof(kDirections) / sizeof(kDirections[0]))];
+			m_aim = static_cast<sf::Uint8>(Utility::RandomInt(1 << InputCommand::kAimBits));
+			m_next_turn_time = now + RandomDelay(500, 2500);
+		}
+
+		//One command per frame, like a client running at 60 frames a second
+		while (now - m_last_command_time >= kFrameTime)
+		{
+			m_pending_commands.emplace_back(m_next_sequence++, m_buttons, m_aim, kFrameTime);
+			if (m_pending_commands.size() > kMaxPendingCommands)
+			{
+				m_pending_commands.erase(m_pending_commands.begin());
+			}
+			m_last_command_time += kFrameTime;
+		}
+
+		if (now - m_last_input_time >= kInputInterval && !m_pending_commands.empty())
+		{
+			unsigned int identifier_bits = BitsRequired(static_cast<sf::Uint32>(m_identifier));
+			BitWriter input;
+			input.Write(identifier_bits - 1, Datagram::kIdentifierWidthBits);
+			input.WriteCompact(1);
+			input.Write(static_cast<sf::Uint32>(m_identifier), identifier_bits);
+			WriteInputCommands(input, m_pending_commands);
+			SendUnreliable(Client::PacketType::kInput, input);
+			m_last_input_time = now;
+		}
+
+		//Shots claim to have been aimed at what the last snapshot showed
+		if (now >= m_next_shot_time)
+		{
+			sf::Vector2f aim(m_spawn_position.x + static_cast<float>(Utility::RandomInt(800) - 400), m_spawn_position.y - static_cast<float>(Utility::RandomInt(400)));
+			sf::Packet packet;
+			packet << static_cast<sf::Int32>(Client::PacketType::kPlayerEvent);
+			packet << m_identifier;
+			packet << static_cast<sf::Int32>(Action::kFireTrigger);
+			packet << static_cast<sf::Int64>((m_tick_rate * static_cast<sf::Int64>(m_statistics.m_last_tick)).asMicroseconds());
+			PositionCodec::Write(packet, aim);
+			Send(packet);
+			m_next_shot_time = now + RandomDelay(1000, 3000);
+		}
+	}
+	else
+	{
+		m_last_command_time = now;
+	}
+
+	if (now - m_last_ping_time >= sf::milliseconds(Heartbeat::kPingIntervalMilliseconds))
+	{
+		BitWriter ping;
+		ping.WriteTime(now.asMicroseconds());
+		SendUnreliable(Client::PacketType::kPing, ping);
+		m_last_ping_time = now;
+	}
+}
+
+const BotStatistics& BotClient::GetStatistics() const
+{
+	return m_statistics;
+}
+
+void BotClient::HandlePacket(sf::Int32 packet_type, sf::Packet& packet, sf::Time now)
+{
+	switch (static_cast<Server::PacketType>(packet_type))
+	{
+	case Server::PacketType::kInitialState:
+	{
+		//Only the first chunk carries the world, bots never look at the aircraft
+		sf::Uint16 chunk_index;
+		packet >> chunk_index;
+		if (chunk_index == 0)
+		{
+			float world_height, current_scroll;
+			sf::Int32 tick_interval;
+			packet >> world_height >> current_scroll >> tick_interval;
+			m_tick_rate = sf::microseconds(tick_interval);
+		}
+	}
+	break;
+
+	case Server::PacketType::kSpawnSelf:
+	{
+		packet >> m_identifier;
+		m_spawn_position = PositionCodec::Read(packet);
+	}
+	break;
+
+	case Server::PacketType::kPlayerDisconnect:
+	{
+		//Our aircraft was destroyed, the bot stays connected and keeps receiving like a spectator
+		sf::Int32 aircraft_identifier;
+		packet >> aircraft_identifier;
+		if (aircraft_identifier == m_identifier)
+		{
+			m_identifier = 0;
+			m_pending_commands.clear();
+		}
+	}
+	break;
+
+	case Server::PacketType::kUdpHandshake:
+	{
+		packet >> m_udp_token >> m_server_udp_port;
+		m_udp_offered = true;
+	}
+	break;
+
+	case Server::PacketType::kUpdateClientState:
+	{
+		BitReader reader(packet, sizeof(sf::Int32));
+		HandleSnapshot(reader, now);
+	}
+	break;
+
+	case Server::PacketType::kPong:
+	{
+		BitReader reader(packet, sizeof(sf::Int32));
+		HandlePong(reader, now);
+	}
+	break;
+
+	case Server::PacketType::kBatch:
+	{
+		std::vector<sf::Packet> messages;
+		MessageBatch::Split(packet, messages);
+		for (sf::Packet& message : messages)
+		{
+			sf::Int32 message_type;
+			message >> message_type;
+			HandlePacket(message_type, message, now);
+		}
+	}
+	break;
+
+	default:
+		break;
+	}
+}
+
+void BotClient::HandleSnapshot(BitReader& reader, sf::Time now)
+{
+	reader.Read(PositionCodec::AxisY().GetBits());
+
+	//Commands the server has applied no longer need resending
+	sf::Uint32 ack_count = reader.ReadCompact();
+	for (sf::Uint32 i = 0; i < ack_count && reader.IsValid(); ++i)
+	{
+		sf::Int32 aircraft_identifier = static_cast<sf::Int32>(reader.ReadCompact());
+		sf::Uint32 sequence = reader.Read(32);
+		if (aircraft_identifier == m_identifier)
+		{
+			m_pending_commands.erase(std::remove_if(m_pending_commands.begin(), m_pending_commands.end(), [sequence](const InputCommand& command)
+			{
+				return !Datagram::IsNewer(command.m_sequence, sequence);
+			}), m_pending_commands.end());
+		}
+	}
+
+	//The bot never draws anything, so only the header is read, the rest of the delta is skipped
+	sf::Uint32 tick;
+	sf::Uint32 baseline_tick;
+	if (!ReadSnapshotHeader(reader, tick, baseline_tick))
+	{
+		return;
+	}
+
+	if (m_statistics.m_first_tick == 0)
+	{
+		m_statistics.m_first_tick = tick;
+		m_statistics.m_first_tick_time = now;
+	}
+	else if (Datagram::IsNewer(tick, m_statistics.m_last_tick))
+	{
+		sf::Int64 interval = (now - m_statistics.m_last_tick_time).asMicroseconds();
+		m_statistics.m_tick_intervals.emplace_back(interval / static_cast<sf::Int64>(tick - m_statistics.m_last_tick));
+	}
+	else
+	{
+		return;
+	}
+	m_statistics.m_last_tick = tick;
+	m_statistics.m_last_tick_time = now;
+	++m_statistics.m_snapshots_received;
+
+	//Acknowledged like a real client so the server keeps sending deltas
+	BitWriter ack;
+	ack.Write(tick, 32);
+	SendUnreliable(Client::PacketType::kSnapshotAck, ack);
+}
+
+void BotClient::HandlePong(BitReader& reader, sf::Time now)
+{
+	sf::Int64 sent_time = reader.ReadTime();
+	reader.ReadTime();
+	if (reader.IsValid())
+	{
+		m_statistics.m_round_trip_times.emplace_back(now.asMicroseconds() - sent_time);
+	}
+}
+
+void BotClient::Send(sf::Packet& packet)
+{
+	m_statistics.m_bytes_sent += packet.getDataSize() + sizeof(sf::Uint32);
+
+	//The socket is non-blocking, a packet the kernel only took part of has to be finished before anything else is sent
+	sf::Socket::Status status;
+	do
+	{
+		status = m_socket.send(packet);
+	} while (status == sf::Socket::Partial);
+
+	if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+	{
+		m_connected = false;
+	}
+}
+
+void BotClient::SendDatagram(Client::PacketType packet_type, const BitWriter& payload)
+{
+	BitWriter datagram;
+	datagram.Write(m_udp_token, Datagram::kTokenBits);
+	datagram.Write(++m_udp_out_sequence, Datagram::kSequenceBits);
+	datagram.Write(static_cast<sf::Uint32>(packet_type), Client::kPacketTypeBits);
+	datagram.Append(payload);
+
+	sf::Packet packet;
+	datagram.AppendTo(packet);
+	m_udp_socket.send(packet, m_server_address, m_server_udp_port);
+	m_statistics.m_bytes_sent += packet.getDataSize();
+}
+
+void BotClient::SendUnreliable(Client::PacketType packet_type, const BitWriter& payload)
+{
+	if (m_udp_confirmed)
+	{
+		SendDatagram(packet_type, payload);
+	}
+	else
+	{
+		//Until the server has answered over UDP the same payload goes on the TCP stream after the type
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(packet_type);
+		payload.AppendTo(packet);
+		Send(packet);
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/Packet.hpp>
+#include <SFML/Network/TcpSocket.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <vector>
+#include "BitStream.hpp"
+#include "InputCommand.hpp"
+#include "NetworkProtocol.hpp"
+#include "SocketPoller.hpp"
+
+//What one bot measured during a run, the load generator merges these into its report
+struct BotStatistics
+{
+	BotStatistics();
+
+	sf::Time m_connect_time;
+	std::size_t m_bytes_sent;
+	std::size_t m_bytes_received;
+	std::size_t m_snapshots_received;
+
+	//The first and latest server ticks seen and when their snapshots arrived
+	sf::Uint32 m_first_tick;
+	sf::Uint32 m_last_tick;
+	sf::Time m_first_tick_time;
+	sf::Time m_last_tick_time;
+
+	//Microseconds between snapshots per tick they advanced, and ping round trips
+	std::vector<sf::Int64> m_tick_intervals;
+	std::vector<sf::Int64> m_round_trip_times;
+};
+
+//A headless client that joins a GameServer and plays like someone holding random keys
+//It speaks the same protocol as MultiplayerGameState without building a World, so hundreds fit in one process
+class BotClient
+{
+public:
+	BotClient();
+	bool Connect(const sf::IpAddress& address, unsigned short port, sf::Int32 room_identifier, sf::Time timeout, sf::Time now);
+	//Also tidies up after a connection the server closed
+	void Disconnect(SocketPoller& poller);
+	bool IsConnected() const;
+	void Register(SocketPoller& poller, std::size_t tcp_key, std::size_t udp_key);
+
+	void HandlePackets(sf::Time now);
+	void HandleDatagrams(sf::Time now);
+	//Sends whatever is due: input at the client's rate, key changes, shots and pings
+	void Update(sf::Time now);
+	const BotStatistics& GetStatistics() const;
+
+private:
+	void HandlePacket(sf::Int32 packet_type, sf::Packet& packet, sf::Time now);
+	void HandleSnapshot(BitReader& reader, sf::Time now);
+	void HandlePong(BitReader& reader, sf::Time now);
+	void Send(sf::Packet& packet);
+	void SendDatagram(Client::PacketType packet_type, const BitWriter& payload);
+	void SendUnreliable(Client::PacketType packet_type, const BitWriter& payload);
+
+private:
+	Pollable<sf::TcpSocket> m_socket;
+	Pollable<sf::UdpSocket> m_udp_socket;
+	bool m_connected;
+	bool m_registered;
+	sf::IpAddress m_server_address;
+
+	sf::Uint32 m_udp_token;
+	unsigned short m_server_udp_port;
+	bool m_udp_offered;
+	bool m_udp_confirmed;
+	sf::Uint16 m_udp_out_sequence;
+	sf::Uint16 m_udp_in_sequence;
+
+	//0 until the server spawns our aircraft, and again once it is destroyed
+	sf::Int32 m_identifier;
+	sf::Vector2f m_spawn_position;
+	sf::Time m_tick_rate;
+	sf::Uint8 m_buttons;
+	sf::Uint8 m_aim;
+	sf::Uint32 m_next_sequence;
+	std::vector<InputCommand> m_pending_commands;
+
+	sf::Time m_last_command_time;
+	sf::Time m_last_input_time;
+	sf::Time m_next_turn_time;
+	sf::Time m_next_shot_time;
+	sf::Time m_last_ping_time;
+	sf::Time m_last_hello_time;
+
+	BotStatistics m_statistics;
+};
@@ -0,0 +1,72 @@
+#include "ClockSync.hpp"
+
+namespace
+{
+	//Both estimates move an eighth of the way towards each new sample
+	const sf::Int64 kSmoothing = 8;
+}
+
+ClockSync::ClockSync()
+	: m_next_sample(0)
+	, m_synchronised(false)
+	, m_round_trip_time(sf::Time::Zero)
+	, m_offset(sf::Time::Zero)
+{
+}
+
+void ClockSync::OnPong(sf::Time sent_time, sf::Time server_time, sf::Time received_time)
+{
+	sf::Time round_trip_time = received_time - sent_time;
+	if (round_trip_time < sf::Time::Zero)
+	{
+		return;
+	}
+
+	//The server answered about halfway through the round trip
+	Sample sample = { round_trip_time, server_time + round_trip_time / static_cast<sf::Int64>(2) - received_time };
+	if (m_samples.size() < kSampleCount)
+	{
+		m_samples.push_back(sample);
+	}
+	else
+	{
+		m_samples[m_next_sample] = sample;
+	}
+	m_next_sample = (m_next_sample + 1) % kSampleCount;
+
+	const Sample* best = &m_samples.front();
+	for (const Sample& candidate : m_samples)
+	{
+		if (candidate.m_round_trip_time < best->m_round_trip_time)
+		{
+			best = &candidate;
+		}
+	}
+
+	if (!m_synchronised)
+	{
+		m_round_trip_time = round_trip_time;
+		m_offset = best->m_offset;
+		m_synchronised = true;
+	}
+	else
+	{
+		m_round_trip_time += (round_trip_time - m_round_trip_time) / kSmoothing;
+		m_offset += (best->m_offset - m_offset) / kSmoothing;
+	}
+}
+
+bool ClockSync::IsSynchronised() const
+{
+	return m_synchronised;
+}
+
+sf::Time ClockSync::GetServerTime(sf::Time local_time) const
+{
+	return local_time + m_offset;
+}
+
+sf::Time ClockSync::GetRoundTripTime() const
+{
+	return m_round_trip_time;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <vector>
+
+//Estimates the server's clock and the round trip from ping and pong timestamps
+//A pong that came back quickly pins the server time down best, so the offset follows the quickest of the recent samples
+class ClockSync
+{
+public:
+	static const std::size_t kSampleCount = 8;
+
+public:
+	ClockSync();
+	//sent_time and received_time are local, server_time is when the server answered
+	void OnPong(sf::Time sent_time, sf::Time server_time, sf::Time received_time);
+	bool IsSynchronised() const;
+	sf::Time GetServerTime(sf::Time local_time) const;
+	sf::Time GetRoundTripTime() const;
+
+private:
+	struct Sample
+	{
+		sf::Time m_round_trip_time;
+		//Server time minus local time
+		sf::Time m_offset;
+	};
+
+private:
+	std::vector<Sample> m_samples;
+	std::size_t m_next_sample;
+	bool m_synchronised;
+	sf::Time m_round_trip_time;
+	sf::Time m_offset;
+};
@@ -4,33 +4,135 @@
 
 #include <SFML/Network/Packet.hpp>
 
+#include "Action.hpp"
+#include "PositionCodec.hpp"
 #include "Utility.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <thread>
 
-GameServer::RemotePeer::RemotePeer() :m_ready(false), m_timed_out(false)
+namespace
 {
-	m_socket.setBlocking(false);
+	//How far outside the shared view a client may claim something happened, enemies are shot just above the top edge
+	const float kInterestMargin = 128.f;
+	//Hitscan shots, the damage matches the allied bullet in DataTables
+	const float kHitscanRange = 800.f;
+	const sf::Int32 kHitscanDamage = 10;
+	//Shooters claiming to look further back than this are treated as if they saw this far back
+	const sf::Time kMaxRewind = sf::milliseconds(500);
+	const sf::Time kStatisticsInterval = sf::seconds(10.f);
+	const std::size_t kTickTimeCount = 64;
+	//The simulation steps at this rate, snapshots go out at the tick rate
+	const sf::Time kFrameRate = sf::seconds(1.f / 60.f);
+	//Steps run back to back after a stall, any more than this are dropped
+	const unsigned int kMaxCatchUpSteps = 4;
+	//Sleeps wake up late by about a scheduler quantum, so the last stretch before a deadline is spent yielding instead
+	const sf::Time kSpinThreshold = sf::milliseconds(2);
+	const sf::Time kTimerResolution = sf::milliseconds(10);
+	const std::size_t kTimerSlotCount = 256;
+	//Poller keys, peers use their slot in the peer table so these sit at the far end of the range
+	const std::size_t kListenerKey = static_cast<std::size_t>(-1);
+	const std::size_t kUdpKey = static_cast<std::size_t>(-2);
+	//Per pass of the server loop, whatever is left over is picked up on the next pass
+	const std::size_t kMaxAcceptsPerPass = 64;
+	const std::size_t kMaxPacketsPerPeer = 64;
+	//A connection to our own listener that has not asked to join or resume by then is dropped
+	const sf::Time kJoinTimeout = sf::seconds(5.f);
+	//A session missing more reliable messages than this could not be caught up, it ends instead of resuming
+	const std::size_t kMaxSessionBacklog = 4096;
+	//Late joiners get the world in pieces of about this size, so no single message stalls the client
+	const std::size_t kInitialStateChunkBytes = 512;
+	//Chunks handed to a late joiner's socket per step, none while it is lagging
+	const std::size_t kInitialStateChunksPerStep = 4;
+
+	//Serialised messages start with their size, then the packet type
+	sf::Int32 ReadMessageType(const MessageBatch::Message& message)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(message->data() + sizeof(sf::Uint32));
+		return static_cast<sf::Int32>((static_cast<sf::Uint32>(bytes[0]) << 24) | (static_cast<sf::Uint32>(bytes[1]) << 16) | (static_cast<sf::Uint32>(bytes[2]) << 8) | bytes[3]);
+	}
+}
+
+GameServer::RemotePeer::RemotePeer() 
+	: m_socket(new PeerSocket())
+	, m_slot(0)
+	, m_serial(0)
+	, m_timed_out(false)
+	, m_quit(false)
+	, m_session_token(0)
+	, m_lagging(false)
+	, m_udp_token(0)
+	, m_udp_ready(false)
+	, m_udp_port(0)
+	, m_udp_out_sequence(0)
+	, m_udp_in_sequence(0)
+	, m_acked_tick(0)
+	, m_round_trip_time(sf::Time::Zero)
+{
+	m_socket->setBlocking(false);
 }
 
-GameServer::GameServer(sf::Vector2f battlefield_size)
+GameServer::GameServer(sf::Vector2f battlefield_size, const ServerSettings& settings)
 	: m_thread(&GameServer::ExecutionThread, this)
+	, m_room_identifier(settings.m_room_identifier)
+	, m_frame_scheduler(kFrameRate, kMaxCatchUpSteps)
+	, m_tick_scheduler(settings.m_tick_rate, kMaxCatchUpSteps)
+	, m_timers(kTimerResolution, kTimerSlotCount)
+	, m_udp_bound(false)
 	, m_listening_state(false)
+	, m_port(settings.m_port)
+	, m_tick_rate(settings.m_tick_rate)
 	, m_client_timeout(sf::seconds(1.f))
-	, m_max_connected_players(15)
-	, m_connected_players(0)
-	, m_world_height(5000)
-	, m_battlefield_rect(0.f, m_world_height - battlefield_size.y, battlefield_size.x, battlefield_size.y)
-	, m_battlefield_scrollspeed(0)
-	, m_aircraft_count(0)
-	, m_peers(1)
+	, m_max_queued_bytes(settings.m_max_queued_bytes)
+	, m_snapshot_byte_budget(settings.m_snapshot_byte_budget)
+	, m_max_connected_players(settings.m_max_players)
+	, m_world(battlefield_size, 5000.f)
+	, m_pending_socket(new PeerSocket())
+	, m_peer_count(0)
+	, m_next_peer_serial(0)
+	, m_peer_timed_out(false)
+	, m_tick(0)
 	, m_aircraft_identifer_counter(1)
 	, m_waiting_thread_end(false)
-	, m_last_spawn_time(sf::Time::Zero)
-	, m_time_fornext_spawn(sf::seconds(5.f))
+	, m_queued_messages(0)
+	, m_flushed_packets(0)
+	, m_last_batch_report(sf::Time::Zero)
+	, m_statistics(true)
+	, m_last_statistics_update(sf::Time::Zero)
+	, m_tick_times(kTickTimeCount)
+	, m_phase_timings(static_cast<std::size_t>(Phase::kPhaseCount))
 {
 	m_listener_socket.setBlocking(false);
-	m_peers[0].reset(new RemotePeer());
-	m_thread.launch();
+
+	m_frame_scheduler.Reset(Now());
+	m_tick_scheduler.Reset(Now());
+	m_timers.Schedule(Now() + sf::seconds(5.f), TimerEvent{ TimerEvent::kSpawnEnemies, 0, 0 });
+
+	if (!settings.m_replay_path.empty() && !m_recorder.Open(settings.m_replay_path, m_tick_rate))
+	{
+		std::cout << "Could not open " << settings.m_replay_path << " to record the match" << std::endl;
+	}
+
+	//Snapshots and position updates use UDP on the same port number as the listener
+	//Rooms share the host's listener but each has its own UDP port, clients learn it from the handshake
+	m_udp_socket.setBlocking(false);
+	m_udp_bound = (m_udp_socket.bind(m_room_identifier < 0 ? m_port : static_cast<unsigned short>(sf::Socket::AnyPort)) == sf::Socket::Done);
+	if (m_udp_bound)
+	{
+		m_poller.Add(m_udp_socket, kUdpKey);
+	}
+
+	if (m_room_identifier < 0)
+	{
+		//Bind before the thread starts so the caller can tell if the port was taken
+		SetListening(true);
+		m_thread.launch();
+	}
 }
 
 GameServer::~GameServer()
@@ -39,36 +141,52 @@ GameServer::~GameServer()
 	m_thread.wait();
 }
 
-void GameServer::NotifyPlayerSpawn(sf::Int32 aircraft_identifier)
+bool GameServer::IsListening() const
 {
-	sf::Packet packet;
-	//First thing for every packet is what type of packet it is
-	packet << static_cast<sf::Int32>(Server::PacketType::kPlayerConnect);
-	packet << aircraft_identifier << m_aircraft_info[aircraft_identifier].m_position.x << m_aircraft_info[aircraft_identifier].m_position.y;
-	for (std::size_t i = 0; i < m_connected_players; ++i)
+	return m_listening_state;
+}
+
+sf::Time GameServer::Update()
+{
+	m_poller.Wait(sf::Time::Zero);
+	return Step();
+}
+
+bool GameServer::AddConnection(PeerSocketPtr& socket, sf::Uint64 session_token)
+{
+	std::lock_guard<std::mutex> lock(m_incoming_mutex);
+	if (session_token == 0 && m_peer_count + m_incoming_connections.size() >= m_max_connected_players)
 	{
-		if (m_peers[i]->m_ready)
-		{
-			m_peers[i]->m_socket.send(packet);
-		}
+		return false;
 	}
+	m_incoming_connections.emplace_back(IncomingConnection{ std::move(socket), session_token, sf::Time::Zero });
+	return true;
+}
+
+bool GameServer::HasSpace() const
+{
+	std::lock_guard<std::mutex> lock(m_incoming_mutex);
+	return m_peer_count + m_incoming_connections.size() < m_max_connected_players;
 }
 
-void GameServer::NotifyPlayerRealtimeChange(sf::Int32 aircraft_identifier, sf::Int32 action, bool action_enabled)
+Histogram GameServer::GetPhaseTimings(Phase phase) const
+{
+	std::lock_guard<std::mutex> lock(m_timing_mutex);
+	return m_phase_timings[static_cast<std::size_t>(phase)];
+}
+
+void GameServer::NotifyPlayerSpawn(sf::Int32 aircraft_identifier)
 {
 	sf::Packet packet;
 	//First thing for every packet is what type of packet it is
-	packet << static_cast<sf::Int32>(Server::PacketType::kPlayerRealTimeChange);
+	packet << static_cast<sf::Int32>(Server::PacketType::kPlayerConnect);
 	packet << aircraft_identifier;
-	packet << action;
-	packet << action_enabled;
-
-	for (std::size_t i = 0; i < m_connected_players; ++i)
+	PositionCodec::Write(packet, m_world.GetAircraft(aircraft_identifier)->m_position);
+	const MessageBatch::Message message = MessageBatch::Serialize(packet);
+	RecordBroadcast(message);
+	for (RemotePeer* peer : m_peers)
 	{
-		if (m_peers[i]->m_ready)
-		{
-			m_peers[i]->m_socket.send(packet);
-		}
+		Send(*peer, message);
 	}
 }
 
@@ -80,12 +198,11 @@ void GameServer::NotifyPlayerEvent(sf::Int32 aircraft_identifier, sf::Int32 acti
 	packet << aircraft_identifier;
 	packet << action;
 
-	for (std::size_t i = 0; i < m_connected_players; ++i)
+	const MessageBatch::Message message = MessageBatch::Serialize(packet);
+	RecordBroadcast(message);
+	for (RemotePeer* peer : m_peers)
 	{
-		if (m_peers[i]->m_ready)
-		{
-			m_peers[i]->m_socket.send(packet);
-		}
+		Send(*peer, message);
 	}
 }
 
@@ -96,11 +213,19 @@ void GameServer::SetListening(bool enable)
 	{
 		if (!m_listening_state)
 		{
-			m_listening_state = (m_listener_socket.listen(SERVER_PORT) == sf::TcpListener::Done);
+			m_listening_state = (m_listener_socket.listen(m_port) == sf::TcpListener::Done);
+			if (m_listening_state)
+			{
+				m_poller.Add(m_listener_socket, kListenerKey);
+			}
 		}
 	}
 	else
 	{
+		if (m_listening_state)
+		{
+			m_poller.Remove(m_listener_socket);
+		}
 		m_listener_socket.close();
 		m_listening_state = false;
 	}
@@ -109,153 +234,242 @@ void GameServer::SetListening(bool enable)
 
 void GameServer::ExecutionThread()
 {
-	SetListening(true);
-
-	sf::Time frame_rate = sf::seconds(1.f / 60.f);
-	sf::Time frame_time = sf::Time::Zero;
-	sf::Time tick_rate = sf::seconds(1.f / 20.f);
-	sf::Time tick_time = sf::Time::Zero;
-	sf::Clock frame_clock, tick_clock;
-
 	while (!m_waiting_thread_end)
 	{
-		HandleIncomingConnections();
-		HandleIncomingPackets();
-
-		frame_time += frame_clock.getElapsedTime();
-		frame_clock.restart();
-
-		tick_time += tick_clock.getElapsedTime();
-		tick_clock.restart();
+		sf::Time wait = Step();
 
-		//Fixed update step
-		while (frame_time >= frame_rate)
+		//Sleep until a socket has data or shortly before the next fixed step is due, whichever comes first
+		if (wait > kSpinThreshold)
 		{
-			m_battlefield_rect.top += m_battlefield_scrollspeed * frame_rate.asSeconds();
-			frame_time -= frame_rate;
+			m_poller.Wait(wait - kSpinThreshold);
+			continue;
 		}
 
-		//Fixed tick step
-		while (tick_time >= tick_rate)
+		//Close to the deadline, yield until it passes and then collect the sockets that are readable now
+		sf::Time deadline = Now() + wait;
+		while (Now() < deadline && !m_waiting_thread_end)
 		{
-			Tick();
-			tick_time -= tick_rate;
+			std::this_thread::yield();
 		}
+		m_poller.Wait(sf::Time::Zero);
+	}
+}
+
+sf::Time GameServer::Step()
+{
+	sf::Clock phase_clock;
+	HandleTimers(Now());
+	sf::Time timer_time = phase_clock.restart();
+
+	bool received = !m_poller.GetReady().empty();
+	HandleIncomingConnections();
+	HandleIncomingPackets();
+	sf::Time receive_time = phase_clock.restart();
+
+	//Fixed update step, the simulation runs here and the tick step reports its results
+	//Steps are due on deadlines from when the server started, a late pass runs the ones it missed
+	sf::Time now = Now();
+	std::size_t frames = 0;
+	while (m_frame_scheduler.Consume(now))
+	{
+		m_world.Update(kFrameRate);
+		++frames;
+	}
+	sf::Time simulate_time = timer_time + phase_clock.restart();
 
-		//sleep
-		sf::sleep(sf::milliseconds(100));
+	//Fixed tick step
+	std::size_t ticks = 0;
+	while (m_tick_scheduler.Consume(now))
+	{
+		Tick();
+		++ticks;
+	}
+	sf::Time encode_time = phase_clock.restart();
+
+	//Everything this pass generated goes out as one packet per peer
+	FlushOutboxes();
+	sf::Time send_time = phase_clock.restart();
 
+	//Idle passes would bury the real work under zeros, so a phase is only recorded when it had something to do
+	if (received)
+	{
+		RecordPhase(Phase::kReceive, receive_time);
 	}
+	if (frames > 0)
+	{
+		RecordPhase(Phase::kSimulate, simulate_time);
+	}
+	if (ticks > 0)
+	{
+		RecordPhase(Phase::kEncode, encode_time);
+		RecordPhase(Phase::kSend, send_time);
+	}
+	ReportStatistics();
+
+	return std::max(std::min(m_frame_scheduler.GetNextDeadline(), m_tick_scheduler.GetNextDeadline()) - Now(), sf::Time::Zero);
 }
 
 void GameServer::Tick()
 {
+	++m_tick;
+	m_tick_times[m_tick % kTickTimeCount] = Now();
+	m_position_history.Record(m_tick, m_world.GetAllAircraft());
 	UpdateClientState();
+	RecordReplayTick();
 
 	//Check if the game is over = all planes position.y < offset
-	bool all_aircraft_done = true;
-	for (const auto& current : m_aircraft_info)
-	{
-		//As long one player has not crossed the finish line game on
-		if (current.second.m_position.y > 0.f)
-		{
-			all_aircraft_done = false;
-			break;
-		}
-	}
-
-	if (all_aircraft_done)
+	if (m_world.HasEveryAircraftFinished())
 	{
 		sf::Packet mission_success_packet;
 		mission_success_packet << static_cast<sf::Int32>(Server::PacketType::kMissionSuccess);
 		SendToAll(mission_success_packet);
 	}
 
-	//Remove aircraft that have been destroyed
-	for (auto itr = m_aircraft_info.begin(); itr != m_aircraft_info.end();)
+	//Aircraft destroyed in the simulation are removed on every client the same way as a disconnected player's
+	for (sf::Int32 identifier : m_world.TakeDestroyedAircraft())
 	{
-		if (itr->second.m_hitpoints <= 0)
+		SendToAll((sf::Packet() << static_cast<sf::Int32>(Server::PacketType::kPlayerDisconnect) << identifier));
+	}
+}
+
+void GameServer::HandleTimers(sf::Time now)
+{
+	std::vector<TimerEvent> expired;
+	m_timers.Advance(now, expired);
+	for (const TimerEvent& timer : expired)
+	{
+		switch (timer.m_type)
+		{
+		case TimerEvent::kPeerTimeout:
 		{
-			m_aircraft_info.erase(itr++);
+			//Packets only move the peer's last packet time, so the timer fires on the old deadline and is set again from there
+			RemotePeer* peer = m_peers.Get(static_cast<std::size_t>(timer.m_slot));
+			if (!peer || peer->m_serial != timer.m_serial)
+			{
+				break;
+			}
+
+			sf::Time deadline = peer->m_last_packet_time + m_client_timeout;
+			if (now > deadline)
+			{
+				peer->m_timed_out = true;
+				m_peer_timed_out = true;
+			}
+			else
+			{
+				m_timers.Schedule(deadline, timer);
+			}
 		}
-		else
+		break;
+		case TimerEvent::kSpawnEnemies:
+			SpawnEnemies();
+			m_timers.Schedule(now + sf::milliseconds(2000 + Utility::RandomInt(6000)), timer);
+			break;
+		case TimerEvent::kSessionExpiry:
 		{
-			++itr;
+			//A session that was resumed and dropped again has a newer timer of its own
+			sf::Uint64 session_token = timer.m_slot;
+			auto itr = m_suspended_sessions.find(session_token);
+			if (itr != m_suspended_sessions.end() && itr->second.m_peer->m_serial == timer.m_serial)
+			{
+				EndSession(session_token);
+			}
+		}
+		break;
 		}
 	}
+}
 
-	//Check if it is time to spawn enemies
-	if (Now() >= m_time_fornext_spawn + m_last_spawn_time)
+void GameServer::SpawnEnemies()
+{
+	//Not going to spawn enemies near the end
+	if (m_world.GetBattlefieldRect().top <= 600.f)
 	{
-		//Not going to spawn enemies near the end
-		if (m_battlefield_rect.top > 600.f)
-		{
-			std::size_t enemy_count = 1 + Utility::RandomInt(2);
-			float spawn_centre = static_cast<float>(Utility::RandomInt(500) - 250);
+		return;
+	}
 
-			//If there is only one enemy it is at the spawn_centre
-			float plane_distance = 0.f;
-			float next_spawn_position = spawn_centre;
+	std::size_t enemy_count = 1 + Utility::RandomInt(2);
+	float spawn_centre = static_cast<float>(Utility::RandomInt(500) - 250);
 
-			//If there are two then they are centred on the spawn centre
-			if (enemy_count == 2)
-			{
-				plane_distance = static_cast<float>(150 + Utility::RandomInt(250));
-				next_spawn_position = spawn_centre - plane_distance / 2.f;
-			}
+	//If there is only one enemy it is at the spawn_centre
+	float plane_distance = 0.f;
+	float next_spawn_position = spawn_centre;
 
-			//TODO Do we really need two packets here?
-			//Send a spawn packet to the clients
-			for (std::size_t i = 0; i < enemy_count; ++i)
-			{
-				sf::Packet packet;
-				packet << static_cast<sf::Int32>(Server::PacketType::kSpawnEnemy);
+	//If there are two then they are centred on the spawn centre
+	if (enemy_count == 2)
+	{
+		plane_distance = static_cast<float>(150 + Utility::RandomInt(250));
+		next_spawn_position = spawn_centre - plane_distance / 2.f;
+	}
 
-				packet << m_world_height - m_battlefield_rect.top + 500;
-				packet << next_spawn_position;
+	//Send a spawn packet to the clients, both spawns reach each peer in the same batch
+	for (std::size_t i = 0; i < enemy_count; ++i)
+	{
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(Server::PacketType::kSpawnEnemy);
 
-				next_spawn_position += plane_distance / 2.f;
-				SendToAll(packet);
-			}
+		packet << m_world.GetWorldHeight() - m_world.GetBattlefieldRect().top + 500;
+		packet << next_spawn_position;
 
-			m_last_spawn_time = Now();
-			m_time_fornext_spawn = sf::milliseconds(2000 + Utility::RandomInt(6000));
-		}
+		next_spawn_position += plane_distance / 2.f;
+		SendToAll(packet);
 	}
 }
 
+void GameServer::RecordPhase(Phase phase, sf::Time duration)
+{
+	std::lock_guard<std::mutex> lock(m_timing_mutex);
+	m_phase_timings[static_cast<std::size_t>(phase)].Record(duration);
+}
+
 sf::Time GameServer::Now() const
 {
 	return m_clock.getElapsedTime();
 }
 
+sf::Time GameServer::GetServerTime() const
+{
+	return m_tick_rate * static_cast<sf::Int64>(m_tick) + (Now() - m_tick_times[m_tick % kTickTimeCount]);
+}
+
 void GameServer::HandleIncomingPackets()
 {
 	bool detected_timeout = false;
+	std::size_t packets_received = 0;
 
-	for (PeerPtr& peer : m_peers)
+	//Only the peers the last wait found readable are read from
+	for (std::size_t key : m_poller.GetReady())
 	{
-		if (peer->m_ready)
+		RemotePeer* peer = m_peers.Get(key);
+		if (!peer)
 		{
-			sf::Packet packet;
-			while (peer->m_socket.receive(packet) == sf::Socket::Done)
-			{
-				//Interpret the packet and react to it
-				HandleIncomingPacket(packet, *peer, detected_timeout);
-
-				peer->m_last_packet_time = Now();
-				packet.clear();
-			}
+			continue;
+		}
 
-			if (Now() > peer->m_last_packet_time + m_client_timeout)
-			{
-				peer->m_timed_out = true;
-				detected_timeout = true;
-			}
+		//A peer flooding the server is read from again next pass, the others still get their turn
+		sf::Packet packet;
+		std::size_t peer_packets = 0;
+		while (peer_packets < kMaxPacketsPerPeer && peer->m_socket->receive(packet) == sf::Socket::Done)
+		{
+			//Interpret the packet and react to it
+			HandleIncomingPacket(packet, *peer, detected_timeout);
+			++packets_received;
+			++peer_packets;
 
+			peer->m_last_packet_time = Now();
+			packet.clear();
 		}
 	}
 
+	//Silent peers are found by their timeout timers, and peers can also be timed out for not reading what is sent to them
+	if (m_peer_timed_out)
+	{
+		detected_timeout = true;
+	}
+
+	m_statistics.SetReceiveBacklog(packets_received);
+	HandleIncomingDatagrams();
+
 	if (detected_timeout)
 	{
 		std::cout << "PLAYER TIMEOUT" << std::endl;
@@ -268,6 +482,7 @@ void GameServer::HandleIncomingPacket(sf::Packet& packet, RemotePeer& receiving_
 {
 	sf::Int32 packet_type;
 	packet >> packet_type;
+	m_statistics.RecordIncoming(packet_type, packet.getDataSize() + sizeof(sf::Uint32));
 
 	switch (static_cast<Client::PacketType> (packet_type))
 	{
@@ -275,6 +490,7 @@ void GameServer::HandleIncomingPacket(sf::Packet& packet, RemotePeer& receiving_
 	{
 		std::cout << "KQUIT TRIGGERED" << std::endl;
 		receiving_peer.m_timed_out = true;
+		receiving_peer.m_quit = true;
 		detected_timeout = true;
 	}
 	break;
@@ -284,49 +500,47 @@ void GameServer::HandleIncomingPacket(sf::Packet& packet, RemotePeer& receiving_
 		sf::Int32 aircraft_identifier;
 		sf::Int32 action;
 		packet >> aircraft_identifier >> action;
-		NotifyPlayerEvent(aircraft_identifier, action);
-	}
-	break;
 
-	case Client::PacketType::kPlayerRealTimeChange:
-	{
-		sf::Int32 aircraft_identifier;
-		sf::Int32 action;
-		bool action_enabled;
-		packet >> aircraft_identifier >> action >> action_enabled;
-		NotifyPlayerRealtimeChange(aircraft_identifier, action, action_enabled);
+		//Shots carry the moment the shooter was looking at and where it aimed
+		if (static_cast<Action>(action) == Action::kFireTrigger)
+		{
+			sf::Int64 view_time;
+			packet >> view_time;
+			sf::Vector2f aim_position = PositionCodec::Read(packet);
+			if (!packet || !ValidateFire(receiving_peer, aircraft_identifier, sf::microseconds(view_time), aim_position))
+			{
+				break;
+			}
+		}
+		NotifyPlayerEvent(aircraft_identifier, action);
 	}
 	break;
 
 	case Client::PacketType::kRequestCoopPartner:
 	{
 		receiving_peer.m_aircraft_identifiers.emplace_back(m_aircraft_identifer_counter);
-		m_aircraft_info[m_aircraft_identifer_counter].m_position = sf::Vector2f(m_battlefield_rect.width / 2, m_battlefield_rect.top + m_battlefield_rect.height / 2);
-		m_aircraft_info[m_aircraft_identifer_counter].m_hitpoints = 100;
-		m_aircraft_info[m_aircraft_identifer_counter].m_missile_ammo = 2;
+		const ServerWorld::PlayerAircraft& aircraft = m_world.AddAircraft(m_aircraft_identifer_counter);
 
 		sf::Packet request_packet;
 		request_packet << static_cast<sf::Int32>(Server::PacketType::kAcceptCoopPartner);
 		request_packet << m_aircraft_identifer_counter;
-		request_packet << m_aircraft_info[m_aircraft_identifer_counter].m_position.x;
-		request_packet << m_aircraft_info[m_aircraft_identifer_counter].m_position.y;
+		PositionCodec::Write(request_packet, aircraft.m_position);
 
-		receiving_peer.m_socket.send(request_packet);
-		m_aircraft_count++;
+		Send(receiving_peer, request_packet);
 
 		// Tell everyone else about the new plane
 		sf::Packet notify_packet;
 		notify_packet << static_cast<sf::Int32>(Server::PacketType::kPlayerConnect);
 		notify_packet << m_aircraft_identifer_counter;
-		notify_packet << m_aircraft_info[m_aircraft_identifer_counter].m_position.x;
-		notify_packet << m_aircraft_info[m_aircraft_identifer_counter].m_position.y;
+		PositionCodec::Write(notify_packet, aircraft.m_position);
 
-		for (PeerPtr& peer : m_peers)
+		const MessageBatch::Message message = MessageBatch::Serialize(notify_packet);
+		RecordBroadcast(message);
+		for (RemotePeer* peer : m_peers)
 		{
-			if (peer.get() != &receiving_peer && peer->m_ready)
+			if (peer != &receiving_peer)
 			{
-
-				peer->m_socket.send(notify_packet);
+				Send(*peer, message);
 			}
 		}
 
@@ -334,21 +548,21 @@ void GameServer::HandleIncomingPacket(sf::Packet& packet, RemotePeer& receiving_
 	}
 	break;
 
-	case Client::PacketType::kPositionUpdate:
+	//Bit packed messages that fell back to TCP, the payload follows the type
+	case Client::PacketType::kInput:
+	case Client::PacketType::kSnapshotAck:
+	case Client::PacketType::kPing:
 	{
-		sf::Int32 num_aircraft;
-		packet >> num_aircraft;
-
-		for (sf::Int32 i = 0; i < num_aircraft; ++i)
-		{
-			sf::Int32 aircraft_identifier;
-			sf::Vector2f aircraft_position;
-			packet >> aircraft_identifier >> aircraft_position.x >> aircraft_position.y;
-			m_aircraft_info[aircraft_identifier].m_position = aircraft_position;
-		}
+		BitReader reader(packet, sizeof(sf::Int32));
+		HandleUnreliablePacket(static_cast<Client::PacketType>(packet_type), reader, receiving_peer);
 	}
 	break;
 
+	//Only ever the first message, read before the peer reaches a room
+	case Client::PacketType::kJoinRoom:
+	case Client::PacketType::kResumeSession:
+		break;
+
 	case Client::PacketType::kGameEvent:
 	{
 		sf::Int32 action;
@@ -362,121 +576,590 @@ void GameServer::HandleIncomingPacket(sf::Packet& packet, RemotePeer& receiving_
 		//Enemy explodes, with a certain probability, drop a pickup
 		//To avoid multiple messages only listen to the first peer
 		
-		if (action == static_cast<int>(GameActions::Type::kEnemyExplode) && Utility::RandomInt(3) == 0 && &receiving_peer == m_peers[0].get())
+		//The position comes from the client, a pickup nobody can reach is not worth sending to anyone
+		if (action == static_cast<int>(GameActions::Type::kEnemyExplode) && Utility::RandomInt(3) == 0 && &receiving_peer == *m_peers.begin() && IsInView(sf::Vector2f(x, y)))
 		{
 			sf::Packet packet;
 			packet << static_cast<sf::Int32>(Server::PacketType::kSpawnPickup);
 			packet << x;
 			packet << y;
 
-			SendToAll(packet);
+			const MessageBatch::Message message = MessageBatch::Serialize(packet);
+			RecordBroadcast(message);
+			for (RemotePeer* peer : m_peers)
+			{
+				Send(*peer, message);
+			}
 		}
 	}
+	break;
+
+	//Only ever sent as a datagram, HandleIncomingDatagrams matches it to its peer
+	case Client::PacketType::kUdpHello:
+		break;
+
+	default:
+		break;
 	}
 
 }
 
-void GameServer::HandleIncomingConnections()
+void GameServer::HandleIncomingDatagrams()
 {
-	if (!m_listening_state)
+	if (!m_udp_bound || !m_poller.IsReady(kUdpKey))
 	{
 		return;
 	}
 
-	if (m_listener_socket.accept(m_peers[m_connected_players]->m_socket) == sf::TcpListener::Done)
+	sf::Packet packet;
+	sf::IpAddress sender;
+	unsigned short sender_port;
+	while (m_udp_socket.receive(packet, sender, sender_port) == sf::Socket::Done)
 	{
-		//Order the new client to spawn its player 1
-		m_aircraft_info[m_aircraft_identifer_counter].m_position = sf::Vector2f(m_battlefield_rect.width / 2, m_battlefield_rect.top + m_battlefield_rect.height / 2);
-		m_aircraft_info[m_aircraft_identifer_counter].m_hitpoints = 100;
-		m_aircraft_info[m_aircraft_identifer_counter].m_missile_ammo = 2;
+		BitReader reader(packet.getData(), packet.getDataSize());
+		sf::Uint32 token = reader.Read(Datagram::kTokenBits);
+		sf::Uint16 sequence = static_cast<sf::Uint16>(reader.Read(Datagram::kSequenceBits));
+		Client::PacketType packet_type = static_cast<Client::PacketType>(reader.Read(Client::kPacketTypeBits));
+		RemotePeer* peer = nullptr;
+		if (reader.IsValid() && (peer = FindPeerByToken(token)) && peer->m_socket->getRemoteAddress() == sender)
+		{
+			m_statistics.RecordIncoming(static_cast<sf::Int32>(packet_type), packet.getDataSize());
+			if (packet_type == Client::PacketType::kUdpHello)
+			{
+				//The client proved it can reach us, from now on unreliable traffic goes over UDP
+				peer->m_udp_port = sender_port;
+				peer->m_udp_ready = true;
+			}
+			else
+			{
+				//Anything not newer than the last datagram is a duplicate or has been superseded
+				m_statistics.RecordDatagramSequence(sequence, peer->m_udp_in_sequence);
+				if (Datagram::IsNewer(sequence, peer->m_udp_in_sequence))
+				{
+					peer->m_udp_in_sequence = sequence;
+					HandleUnreliablePacket(packet_type, reader, *peer);
+				}
+			}
+			peer->m_last_packet_time = Now();
+		}
+		packet.clear();
+	}
+}
 
-		sf::Packet packet;
-		packet << static_cast<sf::Int32>(Server::PacketType::kSpawnSelf);
-		packet << m_aircraft_identifer_counter;
-		packet << m_aircraft_info[m_aircraft_identifer_counter].m_position.x;
-		packet << m_aircraft_info[m_aircraft_identifer_counter].m_position.y;
+void GameServer::HandleUnreliablePacket(Client::PacketType packet_type, BitReader& reader, RemotePeer& receiving_peer)
+{
+	switch (packet_type)
+	{
+	case Client::PacketType::kInput:
+	{
+		unsigned int identifier_bits = reader.Read(Datagram::kIdentifierWidthBits) + 1;
+		sf::Uint32 num_aircraft = reader.ReadCompact();
 
-		m_peers[m_connected_players]->m_aircraft_identifiers.emplace_back(m_aircraft_identifer_counter);
+		std::vector<InputCommand> commands;
+		for (sf::Uint32 i = 0; i < num_aircraft && reader.IsValid(); ++i)
+		{
+			sf::Int32 aircraft_identifier = static_cast<sf::Int32>(reader.Read(identifier_bits));
+			if (!ReadInputCommands(reader, commands))
+			{
+				break;
+			}
 
-		BroadcastMessage("New player");
-		InformWorldState(m_peers[m_connected_players]->m_socket);
-		NotifyPlayerSpawn(m_aircraft_identifer_counter++);
+			//Peers may only steer their own aircraft, the commands are applied by the next simulation steps
+			const std::vector<sf::Int32>& owned = receiving_peer.m_aircraft_identifiers;
+			if (std::find(owned.begin(), owned.end(), aircraft_identifier) == owned.end())
+			{
+				continue;
+			}
 
-		m_peers[m_connected_players]->m_socket.send(packet);
-		m_peers[m_connected_players]->m_ready = true;
-		m_peers[m_connected_players]->m_last_packet_time = Now();
+			for (const InputCommand& command : commands)
+			{
+				m_world.QueueInput(aircraft_identifier, command);
+			}
+		}
+	}
+	break;
 
-		m_aircraft_count++;
-		m_connected_players++;
+	case Client::PacketType::kSnapshotAck:
+	{
+		//Only move the baseline forward, and only to a snapshot we still have
+		sf::Uint32 tick = reader.Read(32);
+		if (reader.IsValid() && receiving_peer.m_sent_snapshots.Find(tick) && (receiving_peer.m_acked_tick == 0 || Datagram::IsNewer(tick, receiving_peer.m_acked_tick)))
+		{
+			receiving_peer.m_acked_tick = tick;
 
-		if (m_connected_players >= m_max_connected_players)
+			//The acknowledgement is sent as soon as the snapshot arrives, so the wait is about one round trip
+			if (m_tick - tick < kTickTimeCount)
+			{
+				sf::Time sample = Now() - m_tick_times[tick % kTickTimeCount];
+				receiving_peer.m_round_trip_time = receiving_peer.m_round_trip_time == sf::Time::Zero ? sample : receiving_peer.m_round_trip_time + (sample - receiving_peer.m_round_trip_time) / static_cast<sf::Int64>(8);
+			}
+		}
+	}
+	break;
+
+	case Client::PacketType::kPing:
+	{
+		//Echo the client's timestamp with ours, the client works out the round trip and our clock from the pair
+		sf::Int64 client_time = reader.ReadTime();
+		if (reader.IsValid())
 		{
-			SetListening(false);
+			BitWriter pong;
+			pong.WriteTime(client_time);
+			pong.WriteTime(GetServerTime().asMicroseconds());
+			SendUnreliable(receiving_peer, Server::PacketType::kPong, pong);
 		}
-		else
+	}
+	break;
+
+	default:
+		break;
+	}
+}
+
+GameServer::RemotePeer* GameServer::FindPeerByToken(sf::Uint32 token)
+{
+	auto itr = m_peer_slots_by_token.find(token);
+	return itr != m_peer_slots_by_token.end() ? m_peers.Get(itr->second) : nullptr;
+}
+
+void GameServer::HandleIncomingConnections()
+{
+	//Connections a MatchHost routed to this room
+	std::vector<IncomingConnection> incoming_connections;
+	{
+		std::lock_guard<std::mutex> lock(m_incoming_mutex);
+		incoming_connections.swap(m_incoming_connections);
+	}
+	for (IncomingConnection& connection : incoming_connections)
+	{
+		ConnectPeer(std::move(connection.m_socket), connection.m_session_token);
+	}
+
+	HandleJoinRequests();
+
+	if (!m_listening_state || !m_poller.IsReady(kListenerKey))
+	{
+		return;
+	}
+
+	//Take every connection that is waiting, up to a limit so a burst of them cannot hold up the next step
+	for (std::size_t accepted = 0; accepted < kMaxAcceptsPerPass; ++accepted)
+	{
+		if (m_listener_socket.accept(*m_pending_socket) != sf::TcpListener::Done)
 		{
-			m_peers.emplace_back(PeerPtr(new RemotePeer()));
+			break;
 		}
+		m_pending_socket->setBlocking(false);
+		m_unrouted_connections.emplace_back(IncomingConnection{ std::move(m_pending_socket), 0, Now() });
+		m_pending_socket.reset(new PeerSocket());
 	}
 }
 
-void GameServer::HandleDisconnections()
+void GameServer::HandleJoinRequests()
 {
-	for (auto itr = m_peers.begin(); itr != m_peers.end();)
+	for (auto itr = m_unrouted_connections.begin(); itr != m_unrouted_connections.end();)
 	{
-		if ((*itr)->m_timed_out)
+		sf::Packet packet;
+		sf::Socket::Status status = itr->m_socket->receive(packet);
+		if ((status == sf::Socket::NotReady || status == sf::Socket::Partial) && Now() < itr->m_accept_time + kJoinTimeout)
 		{
-			//Inform everyone of a disconnection, erase
-			for (sf::Int32 identifer : (*itr)->m_aircraft_identifiers)
-			{
-				std::cout << "Player disconnecting rn frfr" << std::endl;
-				SendToAll((sf::Packet() << static_cast<sf::Int32>(Server::PacketType::kPlayerDisconnect) << identifer));
-				m_aircraft_info.erase(identifer);
-			}
+			++itr;
+			continue;
+		}
 
-			m_connected_players--;
-			m_aircraft_count -= (*itr)->m_aircraft_identifiers.size();
+		PeerSocketPtr socket = std::move(itr->m_socket);
+		itr = m_unrouted_connections.erase(itr);
 
-			itr = m_peers.erase(itr);
+		//Anything other than a join or resume request first is not a client of ours
+		sf::Int32 packet_type;
+		if (status != sf::Socket::Done || !(packet >> packet_type))
+		{
+			continue;
+		}
 
-			//If the number of peers has dropped below max_connections
-			if (m_connected_players < m_max_connected_players)
+		if (packet_type == static_cast<sf::Int32>(Client::PacketType::kJoinRoom))
+		{
+			ConnectPeer(std::move(socket), 0);
+		}
+		else if (packet_type == static_cast<sf::Int32>(Client::PacketType::kResumeSession))
+		{
+			sf::Uint64 session_token;
+			if (packet >> session_token && session_token != 0)
 			{
-				m_peers.emplace_back(PeerPtr(new RemotePeer()));
-				SetListening(true);
+				ConnectPeer(std::move(socket), session_token);
 			}
+		}
+	}
+}
+
+void GameServer::ConnectPeer(PeerSocketPtr socket, sf::Uint64 session_token)
+{
+	socket->setBlocking(false);
+	if (session_token != 0)
+	{
+		ResumeSession(std::move(socket), session_token);
+	}
+	//Held sessions keep their places, so the room can be full with fewer players connected
+	else if (m_peers.GetSize() + m_suspended_sessions.size() < m_max_connected_players)
+	{
+		PeerPtr peer(new RemotePeer());
+		peer->m_socket = std::move(socket);
+		AddPeer(std::move(peer));
+	}
+	else
+	{
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(Server::PacketType::kBroadcastMessage);
+		packet << std::string("No room for another player");
+		socket->setBlocking(true);
+		socket->send(packet);
+	}
+
+	if (m_peers.GetSize() >= m_max_connected_players)
+	{
+		SetListening(false);
+	}
+}
+
+void GameServer::AddPeer(PeerPtr peer)
+{
+	//The new peer joins the table last, so the broadcasts below do not reach it before its own spawn
+	//Order the new client to spawn its player 1
+	const ServerWorld::PlayerAircraft& aircraft = m_world.AddAircraft(m_aircraft_identifer_counter);
+
+	sf::Packet packet;
+	packet << static_cast<sf::Int32>(Server::PacketType::kSpawnSelf);
+	packet << m_aircraft_identifer_counter;
+	PositionCodec::Write(packet, aircraft.m_position);
+
+	peer->m_aircraft_identifiers.emplace_back(m_aircraft_identifer_counter);
+
+	BroadcastMessage("New player");
+	InformWorldState(*peer);
+	NotifyPlayerSpawn(m_aircraft_identifer_counter++);
+
+	Send(*peer, packet);
 
-			BroadcastMessage("A player has disconnected");
+	//Kept by the client, it brings the player back to these aircraft if the connection drops
+	peer->m_session_token = CreateSessionToken();
+	sf::Packet session_packet;
+	session_packet << static_cast<sf::Int32>(Server::PacketType::kSession) << peer->m_session_token;
+	Send(*peer, session_packet);
 
+	OfferUdp(*peer);
+	RegisterPeer(std::move(peer));
+}
+
+void GameServer::ResumeSession(PeerSocketPtr socket, sf::Uint64 session_token)
+{
+	//The client can give up on a connection before we notice it is dead, the new one takes over from the old
+	const RemotePeer* active_peer = nullptr;
+	for (const RemotePeer* peer : m_peers)
+	{
+		if (peer->m_session_token == session_token && !peer->m_quit)
+		{
+			active_peer = peer;
 		}
-		else
+	}
+	if (active_peer)
+	{
+		DropPeer(active_peer->m_slot);
+	}
+
+	auto itr = m_suspended_sessions.find(session_token);
+	if (itr != m_suspended_sessions.end() && itr->second.m_backlog_full)
+	{
+		EndSession(session_token);
+		itr = m_suspended_sessions.end();
+	}
+
+	//A session token of 0 tells the client its place is gone
+	if (itr == m_suspended_sessions.end())
+	{
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(Server::PacketType::kSession) << static_cast<sf::Uint64>(0);
+		socket->setBlocking(true);
+		socket->send(packet);
+		return;
+	}
+
+	PeerPtr peer = std::move(itr->second.m_peer);
+	std::vector<MessageBatch::Message> backlog = std::move(itr->second.m_backlog);
+	m_suspended_sessions.erase(itr);
+	BroadcastMessage("A player reconnected");
+
+	//Same aircraft and snapshot baseline, only the connection is new
+	//The next snapshot is a delta from what the client last acknowledged, the backlog covers the reliable messages it missed
+	peer->m_socket = std::move(socket);
+	peer->m_timed_out = false;
+	peer->m_lagging = false;
+	Send(*peer, (sf::Packet() << static_cast<sf::Int32>(Server::PacketType::kSession) << session_token));
+	for (const MessageBatch::Message& message : backlog)
+	{
+		Send(*peer, message);
+	}
+
+	std::cout << "Resumed a session with " << backlog.size() << " missed messages" << std::endl;
+	OfferUdp(*peer);
+	RegisterPeer(std::move(peer));
+}
+
+void GameServer::RegisterPeer(PeerPtr peer)
+{
+	peer->m_last_packet_time = Now();
+	peer->m_serial = ++m_next_peer_serial;
+
+	RemotePeer& added_peer = *peer;
+	added_peer.m_slot = m_peers.Add(std::move(peer));
+	m_timers.Schedule(added_peer.m_last_packet_time + m_client_timeout, TimerEvent{ TimerEvent::kPeerTimeout, added_peer.m_slot, added_peer.m_serial });
+	m_poller.Add(*added_peer.m_socket, added_peer.m_slot);
+	if (added_peer.m_udp_token != 0)
+	{
+		m_peer_slots_by_token[added_peer.m_udp_token] = added_peer.m_slot;
+	}
+	UpdatePeerCount();
+}
+
+void GameServer::OfferUdp(RemotePeer& peer)
+{
+	//Offer the unreliable channel, the client answers with a kUdpHello datagram carrying the token
+	if (m_udp_bound)
+	{
+		sf::Uint32 token;
+		do
 		{
-			++itr;
+			token = static_cast<sf::Uint32>(Utility::RandomInt(0x7fffffff)) + 1;
+		} while (FindPeerByToken(token));
+		peer.m_udp_token = token;
+
+		sf::Packet handshake_packet;
+		handshake_packet << static_cast<sf::Int32>(Server::PacketType::kUdpHandshake);
+		handshake_packet << token << m_udp_socket.getLocalPort();
+		Send(peer, handshake_packet);
+	}
+}
+
+sf::Uint64 GameServer::CreateSessionToken() const
+{
+	//Unique among this room's connected and held peers, with the room's number in the top bits
+	//Whoever has the token gets the player's aircraft, so the rest comes from the system's random source rather than the game's
+	const sf::Uint64 room_bits = static_cast<sf::Uint64>(m_room_identifier + 1) << Session::kRoomShift;
+	const sf::Uint64 random_mask = (static_cast<sf::Uint64>(1) << Session::kRoomShift) - 1;
+	std::random_device random_source;
+	sf::Uint64 token;
+	bool in_use;
+	do
+	{
+		sf::Uint64 random_bits = static_cast<sf::Uint64>(random_source()) << 32 | random_source();
+		token = room_bits | (random_bits & random_mask);
+		in_use = token == room_bits || m_suspended_sessions.count(token) != 0;
+		for (const RemotePeer* peer : m_peers)
+		{
+			in_use = in_use || peer->m_session_token == token;
+		}
+	} while (in_use);
+	return token;
+}
+
+void GameServer::HandleDisconnections()
+{
+	//Collected first, removing a peer moves another one into its place in the table
+	std::vector<std::size_t> timed_out_slots;
+	for (const RemotePeer* peer : m_peers)
+	{
+		if (peer->m_timed_out)
+		{
+			timed_out_slots.emplace_back(peer->m_slot);
 		}
 	}
 
+	for (std::size_t slot : timed_out_slots)
+	{
+		DropPeer(slot);
+	}
+
+	UpdatePeerCount();
+	m_peer_timed_out = false;
 
+	//If the number of peers has dropped below max_connections, rooms never listen themselves
+	if (!timed_out_slots.empty() && m_peers.GetSize() < m_max_connected_players && m_room_identifier < 0)
+	{
+		SetListening(true);
+	}
 }
 
-void GameServer::InformWorldState(sf::TcpSocket& socket)
+void GameServer::DropPeer(std::size_t slot)
 {
-	sf::Packet packet;
-	packet << static_cast<sf::Int32>(Server::PacketType::kInitialState);
-	packet << m_world_height << m_battlefield_rect.top + m_battlefield_rect.height;
-	packet << static_cast<sf::Int32>(m_aircraft_count);
+	PeerPtr peer = m_peers.Remove(slot);
+	m_poller.Remove(*peer->m_socket);
+	m_peer_slots_by_token.erase(peer->m_udp_token);
 
-	for (std::size_t i = 0; i < m_connected_players; ++i)
+	//A dropped connection may come back, a player who quit does not
+	if (!peer->m_quit && peer->m_session_token != 0)
 	{
-		if (m_peers[i]->m_ready)
+		SuspendPeer(std::move(peer));
+	}
+	else
+	{
+		RemovePlayer(*peer);
+	}
+}
+
+void GameServer::SuspendPeer(PeerPtr peer)
+{
+	BroadcastMessage("A player lost connection");
+
+	//The aircraft stays in the world where every peer can still see it, only the connection goes
+	//Initial state it has not been sent yet stays queued, the backlog follows it when the player is back
+	peer->m_socket.reset();
+	peer->m_outbox.Clear();
+	peer->m_send_queue.Clear();
+	peer->m_udp_token = 0;
+	peer->m_udp_ready = false;
+	peer->m_udp_port = 0;
+
+	sf::Uint64 session_token = peer->m_session_token;
+	m_timers.Schedule(Now() + sf::milliseconds(Session::kGracePeriodMilliseconds), TimerEvent{ TimerEvent::kSessionExpiry, session_token, peer->m_serial });
+	SuspendedSession& session = m_suspended_sessions[session_token];
+	session.m_peer = std::move(peer);
+	session.m_backlog_full = false;
+	std::cout << "Holding a session for " << Session::kGracePeriodMilliseconds / 1000 << " seconds" << std::endl;
+}
+
+void GameServer::EndSession(sf::Uint64 session_token)
+{
+	auto itr = m_suspended_sessions.find(session_token);
+	PeerPtr peer = std::move(itr->second.m_peer);
+	m_suspended_sessions.erase(itr);
+	RemovePlayer(*peer);
+	UpdatePeerCount();
+}
+
+void GameServer::RemovePlayer(const RemotePeer& peer)
+{
+	//Inform everyone of a disconnection, erase
+	for (sf::Int32 identifer : peer.m_aircraft_identifiers)
+	{
+		std::cout << "Player disconnecting rn frfr" << std::endl;
+		SendToAll((sf::Packet() << static_cast<sf::Int32>(Server::PacketType::kPlayerDisconnect) << identifer));
+		m_world.RemoveAircraft(identifer);
+	}
+
+	BroadcastMessage("A player has disconnected");
+}
+
+void GameServer::UpdatePeerCount()
+{
+	m_peer_count = m_peers.GetSize() + m_suspended_sessions.size();
+}
+
+void GameServer::InformWorldState(RemotePeer& peer)
+{
+	std::vector<sf::Packet> chunks;
+	WriteWorldState(chunks, kInitialStateChunkBytes, &peer);
+
+	//Queued behind any earlier messages, the ones sent after this wait behind the chunks in turn
+	for (const sf::Packet& chunk : chunks)
+	{
+		MessageBatch::Message message = MessageBatch::Serialize(chunk);
+		peer.m_join_queue.emplace_back(message);
+		++m_queued_messages;
+		m_statistics.RecordOutgoing(ReadMessageType(message), message->size());
+	}
+}
+
+void GameServer::WriteWorldState(std::vector<sf::Packet>& chunks, std::size_t max_chunk_bytes, const RemotePeer* viewer) const
+{
+	//The viewer's own aircraft follow in kSpawnSelf
+	std::vector<std::pair<sf::Int32, sf::Vector2f>> aircraft;
+	for (const auto& entry : m_world.GetAllAircraft())
+	{
+		if (!viewer || std::find(viewer->m_aircraft_identifiers.begin(), viewer->m_aircraft_identifiers.end(), entry.first) == viewer->m_aircraft_identifiers.end())
 		{
-			for (sf::Int32 identifier : m_peers[i]->m_aircraft_identifiers)
-			{
-				packet << identifier << m_aircraft_info[identifier].m_position.x << m_aircraft_info[identifier].m_position.y;
-			}
+			aircraft.emplace_back(entry.first, entry.second.m_position);
+		}
+	}
+
+	//Identifiers are sent as the gap from the previous one in the chunk, the map keeps them in order
+	std::size_t next = 0;
+	do
+	{
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(Server::PacketType::kInitialState);
+		packet << static_cast<sf::Uint16>(chunks.size());
+		if (chunks.empty())
+		{
+			packet << m_world.GetWorldHeight() << m_world.GetBattlefieldRect().top + m_world.GetBattlefieldRect().height;
+			packet << static_cast<sf::Int32>(m_tick_rate.asMicroseconds());
+			packet << static_cast<sf::Int32>(aircraft.size());
+		}
+
+		BitWriter entries;
+		std::size_t count = 0;
+		sf::Int32 previous_identifier = 0;
+		while (next + count < aircraft.size() && (count == 0 || entries.GetByteCount() < max_chunk_bytes))
+		{
+			const auto& entry = aircraft[next + count];
+			entries.WriteCompact(static_cast<sf::Uint32>(entry.first - previous_identifier));
+			PositionCodec::Write(entries, entry.second);
+			previous_identifier = entry.first;
+			++count;
 		}
+
+		BitWriter chunk;
+		chunk.WriteCompact(static_cast<sf::Uint32>(count));
+		chunk.Append(entries);
+		chunk.AppendTo(packet);
+		chunks.emplace_back(packet);
+		next += count;
+	} while (next < aircraft.size());
+}
+
+void GameServer::RecordBroadcast(const MessageBatch::Message& message)
+{
+	if (m_recorder.IsOpen())
+	{
+		m_recorder.RecordMessage(m_tick, message);
 	}
 
-	socket.send(packet);
+	for (auto& session : m_suspended_sessions)
+	{
+		SuspendedSession& suspended = session.second;
+		if (suspended.m_backlog.size() < kMaxSessionBacklog)
+		{
+			suspended.m_backlog.emplace_back(message);
+		}
+		else
+		{
+			suspended.m_backlog_full = true;
+		}
+	}
+}
+
+void GameServer::RecordReplayTick()
+{
+	if (!m_recorder.IsOpen())
+	{
+		return;
+	}
+
+	if (m_recorder.IsKeyframeDue(m_tick))
+	{
+		//One chunk holding every aircraft, a seek applies it in one go
+		std::vector<sf::Packet> initial_state;
+		WriteWorldState(initial_state, static_cast<std::size_t>(-1), nullptr);
+		m_recorder.RecordKeyframe(m_tick, initial_state.front());
+	}
+
+	//The spectator sees every aircraft, so the replay does not depend on where any peer was looking
+	std::shared_ptr<Snapshot> snapshot(new Snapshot());
+	snapshot->m_tick = m_tick;
+	for (const auto& aircraft : m_world.GetAllAircraft())
+	{
+		snapshot->m_aircraft[aircraft.first].m_position = PositionCodec::Round(aircraft.second.m_position);
+		snapshot->m_aircraft[aircraft.first].m_aim = aircraft.second.m_aim;
+	}
+	m_recorder.RecordSnapshot(m_world.GetBattlefieldRect().top + m_world.GetBattlefieldRect().height, snapshot);
 }
 
 void GameServer::BroadcastMessage(const std::string& message)
@@ -484,37 +1167,320 @@ void GameServer::BroadcastMessage(const std::string& message)
 	sf::Packet packet;
 	packet << static_cast<sf::Int32>(Server::PacketType::kBroadcastMessage);
 	packet << message;
-	for (std::size_t i = 0; i < m_connected_players; ++i)
+	const MessageBatch::Message serialized = MessageBatch::Serialize(packet);
+	RecordBroadcast(serialized);
+	for (RemotePeer* peer : m_peers)
+	{
+		Send(*peer, serialized);
+	}
+}
+
+void GameServer::SendToAll(const sf::Packet& packet)
+{
+	const MessageBatch::Message message = MessageBatch::Serialize(packet);
+	RecordBroadcast(message);
+	for (RemotePeer* peer : m_peers)
+	{
+		Send(*peer, message);
+	}
+}
+
+void GameServer::Send(RemotePeer& peer, const sf::Packet& packet)
+{
+	Send(peer, MessageBatch::Serialize(packet));
+}
+
+void GameServer::Send(RemotePeer& peer, const MessageBatch::Message& message)
+{
+	//Nothing may overtake the initial state, a removal could reach the client before the aircraft it removes
+	if (!peer.m_join_queue.empty())
+	{
+		peer.m_join_queue.emplace_back(message);
+	}
+	else
+	{
+		peer.m_outbox.Append(message);
+	}
+	++m_queued_messages;
+	m_statistics.RecordOutgoing(ReadMessageType(message), message->size());
+}
+
+void GameServer::FlushOutboxes()
+{
+	for (RemotePeer* peer : m_peers)
 	{
-		if (m_peers[i]->m_ready)
+		//The initial state goes out a few chunks a step and waits while the peer is over the high-water mark, so it never floods the send queue
+		for (std::size_t moved = 0; moved < kInitialStateChunksPerStep && !peer->m_join_queue.empty() && !peer->m_lagging; ++moved)
+		{
+			peer->m_outbox.Append(peer->m_join_queue.front());
+			peer->m_join_queue.pop_front();
+		}
+
+		if (!peer->m_outbox.IsEmpty())
+		{
+			//The messages were counted as they were queued, only the batch header is new
+			if (peer->m_outbox.GetMessageCount() > 1)
+			{
+				m_statistics.RecordOutgoing(static_cast<sf::Int32>(Server::PacketType::kBatch), sizeof(sf::Uint32) + sizeof(sf::Int32));
+			}
+			peer->m_outbox.MoveTo(peer->m_send_queue);
+			++m_flushed_packets;
+		}
+
+		if (peer->m_send_queue.IsEmpty())
 		{
-			m_peers[i]->m_socket.send(packet);
+			continue;
+		}
+
+		//Whatever the socket does not take now stays queued, the step never waits on a slow peer
+		sf::Socket::Status status = peer->m_send_queue.Flush(*peer->m_socket);
+		if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+		{
+			peer->m_send_queue.Clear();
+			peer->m_timed_out = true;
+			m_peer_timed_out = true;
+			continue;
+		}
+
+		std::size_t queued = peer->m_send_queue.GetSize();
+		if (queued > m_max_queued_bytes * 4)
+		{
+			std::cout << "Dropping a peer with " << queued << " bytes it is not reading" << std::endl;
+			peer->m_timed_out = true;
+			m_peer_timed_out = true;
+		}
+		else if (!peer->m_lagging && queued > m_max_queued_bytes)
+		{
+			std::cout << "Peer lagging with " << queued << " bytes queued" << std::endl;
+			peer->m_lagging = true;
+		}
+		else if (peer->m_lagging && queued <= m_max_queued_bytes / 2)
+		{
+			std::cout << "Peer caught up" << std::endl;
+			peer->m_lagging = false;
 		}
 	}
+
 }
 
-void GameServer::SendToAll(sf::Packet& packet)
+void GameServer::ReportStatistics()
 {
-	for (PeerPtr& peer : m_peers)
+	m_statistics.Update(Now() - m_last_statistics_update);
+	m_last_statistics_update = Now();
+
+	sf::Time elapsed = Now() - m_last_batch_report;
+	if (elapsed < kStatisticsInterval)
 	{
-		if (peer->m_ready)
+		return;
+	}
+
+	//Connection figures are averaged over the peers
+	sf::Time round_trip_time = sf::Time::Zero;
+	sf::Time snapshot_age = sf::Time::Zero;
+	sf::Int64 ready_peers = 0;
+	for (const RemotePeer* peer : m_peers)
+	{
+		round_trip_time += peer->m_round_trip_time;
+		snapshot_age += m_tick_rate * static_cast<sf::Int64>(m_tick - peer->m_acked_tick);
+		++ready_peers;
+	}
+	if (ready_peers > 0)
+	{
+		m_statistics.SetRoundTripTime(round_trip_time / ready_peers);
+		m_statistics.SetSnapshotAge(snapshot_age / ready_peers);
+	}
+
+	//Built up first so rooms reporting from different threads do not interleave
+	std::ostringstream report;
+	if (m_room_identifier >= 0)
+	{
+		report << "Room " << m_room_identifier << ", " << m_peers.GetSize() << " players\n";
+	}
+	report << m_statistics.ToString();
+	if (m_queued_messages > 0)
+	{
+		report << "Reliable messages: " << m_queued_messages / elapsed.asSeconds() << "/s sent as " << m_flushed_packets / elapsed.asSeconds() << " packets/s\n";
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_timing_mutex);
+		report << "Receive: " << m_phase_timings[static_cast<std::size_t>(Phase::kReceive)].ToString() << "\n";
+		report << "Simulate: " << m_phase_timings[static_cast<std::size_t>(Phase::kSimulate)].ToString() << "\n";
+		report << "Encode: " << m_phase_timings[static_cast<std::size_t>(Phase::kEncode)].ToString() << "\n";
+		report << "Send: " << m_phase_timings[static_cast<std::size_t>(Phase::kSend)].ToString() << "\n";
+	}
+	if (m_frame_scheduler.GetSkippedCount() > 0 || m_tick_scheduler.GetSkippedCount() > 0)
+	{
+		report << "Steps skipped to catch up: " << m_frame_scheduler.GetSkippedCount() << " frames, " << m_tick_scheduler.GetSkippedCount() << " ticks\n";
+	}
+	std::cout << report.str() << std::flush;
+	m_queued_messages = 0;
+	m_flushed_packets = 0;
+	m_last_batch_report = Now();
+}
+
+void GameServer::SendUnreliable(RemotePeer& peer, Server::PacketType packet_type, const BitWriter& payload)
+{
+	if (peer.m_udp_ready)
+	{
+		BitWriter datagram;
+		datagram.Write(++peer.m_udp_out_sequence, Datagram::kSequenceBits);
+		datagram.Write(static_cast<sf::Uint32>(packet_type), Server::kPacketTypeBits);
+		datagram.Append(payload);
+
+		sf::Packet packet;
+		datagram.AppendTo(packet);
+		m_udp_socket.send(packet, peer.m_socket->getRemoteAddress(), peer.m_udp_port);
+		m_statistics.RecordOutgoing(static_cast<sf::Int32>(packet_type), packet.getDataSize());
+	}
+	else
+	{
+		//Fall back to the TCP stream until the client has answered the UDP handshake
+		//A lagging peer skips these, the next tick supersedes them anyway
+		if (peer.m_lagging)
 		{
-			peer->m_socket.send(packet);
+			return;
 		}
+
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(packet_type);
+		payload.AppendTo(packet);
+		Send(peer, packet);
 	}
 }
 
 void GameServer::UpdateClientState()
 {
-	sf::Packet update_client_state_packet;
-	update_client_state_packet << static_cast<sf::Int32>(Server::PacketType::kUpdateClientState);
-	update_client_state_packet << static_cast<float>(m_battlefield_rect.top + m_battlefield_rect.height);
-	update_client_state_packet << static_cast<sf::Int32>(m_aircraft_count);
+	//Every client draws the same scrolling view and every aircraft is kept inside it, so all peers see all aircraft
+	//They share one snapshot, and peers that acknowledged the same baseline share the encoded delta too
+	std::shared_ptr<Snapshot> full_snapshot(new Snapshot());
+	full_snapshot->m_tick = m_tick;
+	for (const auto& aircraft : m_world.GetAllAircraft())
+	{
+		full_snapshot->m_aircraft[aircraft.first].m_position = PositionCodec::Round(aircraft.second.m_position);
+		full_snapshot->m_aircraft[aircraft.first].m_aim = aircraft.second.m_aim;
+	}
+
+	std::map<const Snapshot*, BitWriter> encoded_deltas;
+	for (RemotePeer* peer : m_peers)
+	{
+		UpdateSendPriorities(*peer);
+
+		//If the acknowledged snapshot has dropped out of the history the peer gets a full snapshot
+		SnapshotPtr baseline = peer->m_sent_snapshots.Find(peer->m_acked_tick);
+		//Nothing was sent to a resumed peer while it was away, so its baseline can be older than a delta can refer to
+		if (baseline && m_tick - baseline->m_tick >= SnapshotBuffer::kCapacity)
+		{
+			baseline = nullptr;
+		}
+		auto itr = encoded_deltas.find(baseline.get());
+		if (itr == encoded_deltas.end())
+		{
+			BitWriter delta;
+			WriteSnapshotDelta(delta, baseline.get(), *full_snapshot);
+			itr = encoded_deltas.emplace(baseline.get(), delta).first;
+		}
+
+		//Tell the peer which of its input commands this snapshot already includes, so it can check its prediction
+		BitWriter update_client_state;
+		update_client_state.Write(PositionCodec::AxisY().Quantize(m_world.GetBattlefieldRect().top + m_world.GetBattlefieldRect().height), PositionCodec::AxisY().GetBits());
+		std::vector<std::pair<sf::Int32, sf::Uint32>> input_acks;
+		for (sf::Int32 identifier : peer->m_aircraft_identifiers)
+		{
+			if (const ServerWorld::PlayerAircraft* aircraft = m_world.GetAircraft(identifier))
+			{
+				input_acks.emplace_back(identifier, aircraft->m_last_input_sequence);
+			}
+		}
+		update_client_state.WriteCompact(static_cast<sf::Uint32>(input_acks.size()));
+		for (const auto& ack : input_acks)
+		{
+			update_client_state.WriteCompact(static_cast<sf::Uint32>(ack.first));
+			update_client_state.Write(ack.second, 32);
+		}
+
+		//A crowded view is cut down to the budget, the peer's snapshot is then its own and so is the delta
+		SnapshotPtr snapshot = full_snapshot;
+		std::size_t budget_bits = m_snapshot_byte_budget * 8;
+		std::size_t header_bits = Datagram::kSequenceBits + Server::kPacketTypeBits + update_client_state.GetBitCount();
+		if (m_snapshot_byte_budget != 0 && header_bits + itr->second.GetBitCount() > budget_bits)
+		{
+			//The peer checks its prediction against the state of its own aircraft, so those always go out
+			snapshot = BuildBudgetedSnapshot(*full_snapshot, baseline.get(), peer->m_aircraft_identifiers, peer->m_send_priorities, budget_bits > header_bits ? budget_bits - header_bits : 0);
+			BitWriter delta;
+			WriteSnapshotDelta(delta, baseline.get(), *snapshot);
+			update_client_state.Append(delta);
+		}
+		else
+		{
+			//Everything fits, so the peer is up to date on every aircraft it can see
+			peer->m_send_priorities.MarkAllSent();
+			update_client_state.Append(itr->second);
+		}
+
+		//Snapshots are superseded every tick, so they go over the unreliable channel
+		SendUnreliable(*peer, Server::PacketType::kUpdateClientState, update_client_state);
+		peer->m_sent_snapshots.Insert(snapshot);
+	}
+}
+
+void GameServer::UpdateSendPriorities(RemotePeer& peer)
+{
+	std::vector<SendPriorities::VisibleAircraft> visible;
+	for (const auto& aircraft : m_world.GetAllAircraft())
+	{
+		visible.push_back({ aircraft.first, aircraft.second.m_position, aircraft.second.m_velocity });
+	}
 
-	for (const auto& aircraft : m_aircraft_info)
+	std::vector<sf::Vector2f> viewers;
+	for (sf::Int32 identifier : peer.m_aircraft_identifiers)
 	{
-		update_client_state_packet << aircraft.first << aircraft.second.m_position.x << aircraft.second.m_position.y;
+		if (const ServerWorld::PlayerAircraft* aircraft = m_world.GetAircraft(identifier))
+		{
+			viewers.emplace_back(aircraft->m_position);
+		}
 	}
 
-	SendToAll(update_client_state_packet);
-}
\ No newline at end of file
+	peer.m_send_priorities.Update(visible, viewers);
+}
+
+bool GameServer::ValidateFire(const RemotePeer& peer, sf::Int32 aircraft_identifier, sf::Time view_time, sf::Vector2f aim_position)
+{
+	//Peers may only fire their own aircraft, and no faster than it reloads
+	const std::vector<sf::Int32>& owned = peer.m_aircraft_identifiers;
+	const ServerWorld::PlayerAircraft* shooter = m_world.GetAircraft(aircraft_identifier);
+	if (!shooter || std::find(owned.begin(), owned.end(), aircraft_identifier) == owned.end() || !m_world.TryFire(aircraft_identifier))
+	{
+		return false;
+	}
+
+	sf::Vector2f direction = aim_position - shooter->m_position;
+	float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+	if (length == 0.f || m_position_history.IsEmpty())
+	{
+		return true;
+	}
+
+	//The shooter drew the others at view_time, clamp it to the history we keep and what is plausible
+	sf::Time newest_time = m_tick_rate * static_cast<sf::Int64>(m_position_history.GetNewestTick());
+	sf::Time oldest_time = m_tick_rate * static_cast<sf::Int64>(m_position_history.GetOldestTick());
+	view_time = std::min(view_time, newest_time);
+	view_time = std::max(view_time, std::max(oldest_time, newest_time - kMaxRewind));
+
+	sf::Uint32 view_tick = static_cast<sf::Uint32>(view_time.asMicroseconds() / m_tick_rate.asMicroseconds());
+	float fraction = static_cast<float>(view_time.asMicroseconds() % m_tick_rate.asMicroseconds()) / m_tick_rate.asMicroseconds();
+
+	//The shooter's own aircraft is predicted on its screen, so the shot starts where the server has it now
+	sf::Vector2f end = shooter->m_position + direction * (kHitscanRange / length);
+	sf::Int32 hit_identifier;
+	if (m_position_history.Raycast(view_tick, fraction, shooter->m_position, end, aircraft_identifier, hit_identifier))
+	{
+		m_world.Damage(hit_identifier, kHitscanDamage);
+	}
+	return true;
+}
+
+bool GameServer::IsInView(sf::Vector2f position) const
+{
+	sf::FloatRect view = m_world.GetBattlefieldRect();
+	return sf::FloatRect(view.left - kInterestMargin, view.top - kInterestMargin, view.width + 2 * kInterestMargin, view.height + 2 * kInterestMargin).contains(position);
+}
@@ -1,81 +1,263 @@
 #pragma once
+#include <atomic>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <SFML/Graphics/Rect.hpp>
 #include <SFML/Network/TcpListener.hpp>
 #include <SFML/Network/TcpSocket.hpp>
+#include <SFML/Network/UdpSocket.hpp>
 #include <SFML/System/Clock.hpp>
 #include <SFML/System/Thread.hpp>
 #include <SFML/System/Vector2.hpp>
+#include "BitStream.hpp"
+#include "Histogram.hpp"
+#include "InputCommand.hpp"
+#include "MessageBatch.hpp"
+#include "NetworkProtocol.hpp"
+#include "NetworkStatistics.hpp"
+#include "OutboundQueue.hpp"
+#include "PositionHistory.hpp"
+#include "ReplayRecorder.hpp"
+#include "SendPriorities.hpp"
+#include "ServerSettings.hpp"
+#include "ServerWorld.hpp"
+#include "Snapshot.hpp"
+#include "SlotTable.hpp"
+#include "SocketPoller.hpp"
+#include "TickScheduler.hpp"
+#include "TimerWheel.hpp"
 
 class GameServer {
 public:
-	explicit GameServer(sf::Vector2f battlefield_size);
+	typedef Pollable<sf::TcpSocket> PeerSocket;
+	typedef std::unique_ptr<PeerSocket> PeerSocketPtr;
+
+	//The parts of a pass that are timed, receive covers connections and packets, encode is the snapshot tick
+	enum class Phase
+	{
+		kReceive,
+		kSimulate,
+		kEncode,
+		kSend,
+		kPhaseCount
+	};
+
+public:
+	explicit GameServer(sf::Vector2f battlefield_size, const ServerSettings& settings = ServerSettings());
 	~GameServer();
+	bool IsListening() const;
+
+	//Rooms of a MatchHost have no thread or listener, the host calls these instead
+	//Polls the sockets without waiting and runs one pass, returns how long until the next fixed step is due
+	sf::Time Update();
+	//Takes a connected socket if the room has space for it, the player joins on the room's next pass
+	//With a session token the socket resumes that session instead, its place in the room is still held
+	bool AddConnection(PeerSocketPtr& socket, sf::Uint64 session_token = 0);
+	bool HasSpace() const;
+
 	void NotifyPlayerSpawn(sf::Int32 airfract_identifier);
-	void NotifyPlayerRealtimeChange(sf::Int32 aircraft_identifer, sf::Int32 action, bool action_enabled);
 	void NotifyPlayerEvent(sf::Int32 aircraft_identifier, sf::Int32 action);
 
+	//Every time the phase did any work since the server started, safe to call from another thread
+	Histogram GetPhaseTimings(Phase phase) const;
+
 private:
 	struct RemotePeer
 	{
 		RemotePeer();
-		sf::TcpSocket m_socket;
+		PeerSocketPtr m_socket;
+		//Where the peer sits in the peer table, stays the same until it disconnects
+		std::size_t m_slot;
+		//Slots are reused, timers check this to tell the peer they were set for from whoever has the slot now
+		sf::Uint32 m_serial;
 		sf::Time m_last_packet_time;
 		std::vector<sf::Int32> m_aircraft_identifiers;
-		bool m_ready;
 		bool m_timed_out;
+		//A peer that quit is not held for a reconnection
+		bool m_quit;
+		sf::Uint64 m_session_token;
+
+		//Reliable messages generated this step, flushed as one packet
+		MessageBatch m_outbox;
+		//The initial state of a late joiner and every reliable message after it, fed to the outbox a few at a time
+		std::deque<MessageBatch::Message> m_join_queue;
+		//Bytes the socket has not taken yet, a peer is lagging while this is over the high-water mark
+		OutboundQueue m_send_queue;
+		bool m_lagging;
+
+		//Unreliable channel, usable once the client has answered the handshake over UDP
+		sf::Uint32 m_udp_token;
+		bool m_udp_ready;
+		unsigned short m_udp_port;
+		sf::Uint16 m_udp_out_sequence;
+		sf::Uint16 m_udp_in_sequence;
+
+		//Snapshots sent to this peer, deltas are encoded against the latest one it acknowledged
+		SnapshotBuffer m_sent_snapshots;
+		sf::Uint32 m_acked_tick;
+
+		//Kept for every aircraft, the ones owed most fill the snapshot when not all of them fit the byte budget
+		SendPriorities m_send_priorities;
+
+		//Smoothed from how long snapshots take to be acknowledged
+		sf::Time m_round_trip_time;
 	};
 
-	struct AircraftInfo
+	typedef std::unique_ptr<RemotePeer> PeerPtr;
+
+	struct TimerEvent
 	{
-		sf::Vector2f m_position;
-		sf::Int32 m_hitpoints;
-		sf::Int32 m_missile_ammo;
-		std::map<sf::Int32, bool> m_realtime_actions;
+		enum Type
+		{
+			kPeerTimeout,
+			kSpawnEnemies,
+			kSessionExpiry
+		};
+
+		Type m_type;
+		//The peer's slot, or its session token for kSessionExpiry
+		sf::Uint64 m_slot;
+		sf::Uint32 m_serial;
 	};
 
-	typedef std::unique_ptr<RemotePeer> PeerPtr;
+	//A socket and what it asked for: a new player, or the session it is resuming
+	struct IncomingConnection
+	{
+		PeerSocketPtr m_socket;
+		sf::Uint64 m_session_token;
+		sf::Time m_accept_time;
+	};
+
+	//A peer whose connection dropped, the reliable messages it misses are kept for when it comes back
+	struct SuspendedSession
+	{
+		PeerPtr m_peer;
+		std::vector<MessageBatch::Message> m_backlog;
+		bool m_backlog_full;
+	};
 
 private:
 	void SetListening(bool enable);
 	void ExecutionThread();
+	//One pass of the server loop: read, run whichever fixed steps are due, send
+	sf::Time Step();
 	void Tick();
+	void HandleTimers(sf::Time now);
+	void SpawnEnemies();
+	void RecordPhase(Phase phase, sf::Time duration);
 	sf::Time Now() const;
+	//Server time on the tick timeline clients interpolate on, tick * tick rate plus the time since that tick
+	sf::Time GetServerTime() const;
 
 	void HandleIncomingPackets();
 	void HandleIncomingPacket(sf::Packet& packet, RemotePeer& receiving_peer, bool& detected_timeout);
+	void HandleIncomingDatagrams();
+	void HandleUnreliablePacket(Client::PacketType packet_type, BitReader& reader, RemotePeer& receiving_peer);
+	RemotePeer* FindPeerByToken(sf::Uint32 token);
 
 	void HandleIncomingConnections();
+	//Connections to our own listener say whether they join or resume in their first message
+	void HandleJoinRequests();
+	void ConnectPeer(PeerSocketPtr socket, sf::Uint64 session_token);
+	void AddPeer(PeerPtr peer);
+	void ResumeSession(PeerSocketPtr socket, sf::Uint64 session_token);
+	void RegisterPeer(PeerPtr peer);
+	void OfferUdp(RemotePeer& peer);
+	sf::Uint64 CreateSessionToken() const;
 	void HandleDisconnections();
+	//Takes the peer out of the peer table, holding its session if it may come back
+	void DropPeer(std::size_t slot);
+	void SuspendPeer(PeerPtr peer);
+	void EndSession(sf::Uint64 session_token);
+	void RemovePlayer(const RemotePeer& peer);
+	void UpdatePeerCount();
 
-	void InformWorldState(sf::TcpSocket& socket);
+	void InformWorldState(RemotePeer& peer);
+	//kInitialState split into chunks of about max_chunk_bytes of aircraft, the first also carries the world and the aircraft count
+	void WriteWorldState(std::vector<sf::Packet>& chunks, std::size_t max_chunk_bytes, const RemotePeer* viewer) const;
+	//Messages every peer is sent go into the replay and the backlogs of suspended sessions as well, whether or not a peer can currently see what they are about
+	void RecordBroadcast(const MessageBatch::Message& message);
+	void RecordReplayTick();
 	void BroadcastMessage(const std::string& message);
-	void SendToAll(sf::Packet& packet);
+	void SendToAll(const sf::Packet& packet);
+	void Send(RemotePeer& peer, const sf::Packet& packet);
+	void Send(RemotePeer& peer, const MessageBatch::Message& message);
+	void FlushOutboxes();
+	void ReportStatistics();
+	void SendUnreliable(RemotePeer& peer, Server::PacketType packet_type, const BitWriter& payload);
 	void UpdateClientState();
+	void UpdateSendPriorities(RemotePeer& peer);
+
+	bool ValidateFire(const RemotePeer& peer, sf::Int32 aircraft_identifier, sf::Time view_time, sf::Vector2f aim_position);
+
+	//Clients share one camera that follows the battlefield, this is whether a position is on or just off that view
+	bool IsInView(sf::Vector2f position) const;
 
 private:
 	sf::Thread m_thread;
 	sf::Clock m_clock;
-	sf::TcpListener m_listener_socket;
+	//-1 for a server with its own thread and listener
+	sf::Int32 m_room_identifier;
+	TickScheduler m_frame_scheduler;
+	TickScheduler m_tick_scheduler;
+	//Enemy spawns and peer timeouts, a pass only looks at the timers that have come due
+	TimerWheel<TimerEvent> m_timers;
+	Pollable<sf::TcpListener> m_listener_socket;
+	Pollable<sf::UdpSocket> m_udp_socket;
+	//Every socket the server reads from, each pass only the readable ones are visited
+	SocketPoller m_poller;
+	bool m_udp_bound;
 	bool m_listening_state;
+	unsigned short m_port;
+	sf::Time m_tick_rate;
 	sf::Time m_client_timeout;
+	std::size_t m_max_queued_bytes;
+	std::size_t m_snapshot_byte_budget;
 
 	std::size_t m_max_connected_players;
-	std::size_t m_connected_players;
-
-	float m_world_height;
-	sf::FloatRect m_battlefield_rect;
-	float m_battlefield_scrollspeed;
 
-	std::size_t m_aircraft_count;
-	std::map<sf::Int32, AircraftInfo> m_aircraft_info;
+	ServerWorld m_world;
+	//Positions as of each recent tick, shots are checked against the moment their shooter was looking at
+	PositionHistory m_position_history;
 
-	std::vector<PeerPtr> m_peers;
+	SlotTable<RemotePeer> m_peers;
+	//Accepted into before the connection waits for its first message
+	PeerSocketPtr m_pending_socket;
+	//Connections to our own listener that have not said what they want yet
+	//Only a handful at a time and only until their first message, so they are read every pass instead of going through the poller
+	std::vector<IncomingConnection> m_unrouted_connections;
+	//Sockets handed over by a MatchHost's listener thread, they join on the next pass
+	std::vector<IncomingConnection> m_incoming_connections;
+	mutable std::mutex m_incoming_mutex;
+	//Session tokens to the peers held for them
+	std::unordered_map<sf::Uint64, SuspendedSession> m_suspended_sessions;
+	//Connected and suspended peers as the host's thread sees it, a suspended peer keeps its place
+	std::atomic<std::size_t> m_peer_count;
+	//UDP tokens to peer slots, every datagram is matched to its sender through this
+	std::unordered_map<sf::Uint32, std::size_t> m_peer_slots_by_token;
+	sf::Uint32 m_next_peer_serial;
+	//Set when a peer is found timed out outside of packet handling, its disconnection waits for the next pass
+	bool m_peer_timed_out;
+	sf::Uint32 m_tick;
 	sf::Int32 m_aircraft_identifer_counter;
 	bool m_waiting_thread_end;
 
-	sf::Time m_last_spawn_time;
-	sf::Time m_time_fornext_spawn;
+	//Reliable messages queued against the packets that actually went out, reported every few seconds with the rest of the statistics
+	std::size_t m_queued_messages;
+	std::size_t m_flushed_packets;
+	sf::Time m_last_batch_report;
+	NetworkStatistics m_statistics;
+	sf::Time m_last_statistics_update;
+	//When each recent tick's snapshots went out, acknowledgements are timed against these
+	std::vector<sf::Time> m_tick_times;
+
+	std::vector<Histogram> m_phase_timings;
+	mutable std::mutex m_timing_mutex;
 
+	ReplayRecorder m_recorder;
 };
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "Histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+	//Values below this many microseconds get a bucket each, above it every power of two is split this many ways
+	const unsigned int kSubBucketBits = 4;
+	const sf::Int64 kSubBuckets = 1 << kSubBucketBits;
+	//Covers up to 2^40 microseconds, about 12 days
+	const unsigned int kMaxExponent = 40;
+	const std::size_t kBucketCount = kSubBuckets + (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+	unsigned int HighestBit(sf::Uint64 value)
+	{
+		unsigned int bit = 0;
+		while (value >>= 1)
+		{
+			++bit;
+		}
+		return bit;
+	}
+}
+
+Histogram::Histogram()
+	: m_buckets(kBucketCount, 0)
+	, m_count(0)
+	, m_total(0)
+	, m_max(0)
+{
+}
+
+void Histogram::Record(sf::Time duration)
+{
+	sf::Int64 microseconds = std::max(duration.asMicroseconds(), static_cast<sf::Int64>(0));
+	++m_buckets[GetBucket(microseconds)];
+	++m_count;
+	m_total += microseconds;
+	m_max = std::max(m_max, microseconds);
+}
+
+void Histogram::Merge(const Histogram& other)
+{
+	for (std::size_t i = 0; i < kBucketCount; ++i)
+	{
+		m_buckets[i] += other.m_buckets[i];
+	}
+	m_count += other.m_count;
+	m_total += other.m_total;
+	m_max = std::max(m_max, other.m_max);
+}
+
+void Histogram::Clear()
+{
+	std::fill(m_buckets.begin(), m_buckets.end(), 0);
+	m_count = 0;
+	m_total = 0;
+	m_max = 0;
+}
+
+std::size_t Histogram::GetCount() const
+{
+	return m_count;
+}
+
+sf::Time Histogram::GetMean() const
+{
+	return m_count > 0 ? sf::microseconds(m_total / static_cast<sf::Int64>(m_count)) : sf::Time::Zero;
+}
+
+sf::Time Histogram::GetMax() const
+{
+	return sf::microseconds(m_max);
+}
+
+sf::Time Histogram::GetPercentile(float fraction) const
+{
+	if (m_count == 0)
+	{
+		return sf::Time::Zero;
+	}
+
+	std::size_t rank = std::max(static_cast<std::size_t>(1), static_cast<std::size_t>(std::ceil(fraction * m_count)));
+	std::size_t seen = 0;
+	for (std::size_t i = 0; i < kBucketCount; ++i)
+	{
+		seen += m_buckets[i];
+		if (seen >= rank)
+		{
+			//Never report more than the largest sample actually seen
+			return sf::microseconds(std::min(GetUpperBound(i), m_max));
+		}
+	}
+	return sf::microseconds(m_max);
+}
+
+std::string Histogram::ToString() const
+{
+	std::ostringstream text;
+	text << "p50 " << GetPercentile(0.5f).asMicroseconds() / 1000.f << " ms, p99 " << GetPercentile(0.99f).asMicroseconds() / 1000.f << " ms, max " << GetMax().asMicroseconds() / 1000.f << " ms";
+	return text.str();
+}
+
+std::size_t Histogram::GetBucket(sf::Int64 microseconds)
+{
+	if (microseconds < kSubBuckets)
+	{
+		return static_cast<std::size_t>(microseconds);
+	}
+
+	unsigned int exponent = std::min(HighestBit(static_cast<sf::Uint64>(microseconds)), kMaxExponent);
+	sf::Int64 sub_bucket = (microseconds >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+	return std::min(static_cast<std::size_t>(kSubBuckets + (exponent - kSubBucketBits) * kSubBuckets + sub_bucket), kBucketCount - 1);
+}
+
+sf::Int64 Histogram::GetUpperBound(std::size_t bucket)
+{
+	if (bucket < static_cast<std::size_t>(kSubBuckets))
+	{
+		return static_cast<sf::Int64>(bucket);
+	}
+
+	unsigned int exponent = static_cast<unsigned int>((bucket - kSubBuckets) / kSubBuckets) + kSubBucketBits;
+	sf::Int64 sub_bucket = static_cast<sf::Int64>((bucket - kSubBuckets) % kSubBuckets);
+	return ((kSubBuckets + sub_bucket + 1) << (exponent - kSubBucketBits)) - 1;
+}
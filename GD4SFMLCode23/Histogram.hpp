@@ -0,0 +1,36 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//Counts durations in buckets that widen with the value, so any percentile is within about 6% from a microsecond to hours
+//Recording is a couple of shifts and an increment, cheap enough to time every phase of every pass
+class Histogram
+{
+public:
+	Histogram();
+	void Record(sf::Time duration);
+	void Merge(const Histogram& other);
+	void Clear();
+
+	std::size_t GetCount() const;
+	sf::Time GetMean() const;
+	sf::Time GetMax() const;
+	//The upper edge of the bucket holding the sample at this fraction of the way through, 0.99 for p99
+	sf::Time GetPercentile(float fraction) const;
+	//p50, p99 and max in milliseconds
+	std::string ToString() const;
+
+private:
+	static std::size_t GetBucket(sf::Int64 microseconds);
+	static sf::Int64 GetUpperBound(std::size_t bucket);
+
+private:
+	std::vector<sf::Uint32> m_buckets;
+	std::size_t m_count;
+	sf::Int64 m_total;
+	sf::Int64 m_max;
+};
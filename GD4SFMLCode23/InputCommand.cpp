@@ -0,0 +1,129 @@
+#include "InputCommand.hpp"
+#include "BitStream.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//AircraftMover's 200 scaled by the player aircraft's speed in the data table
+	const float kPlayerSpeed = 400.f;
+	const float kBorderDistance = 10.f;
+}
+
+InputCommand::InputCommand()
+	: m_sequence(0)
+	, m_buttons(0)
+	, m_aim(0)
+	, m_milliseconds(0)
+{
+}
+
+InputCommand::InputCommand(sf::Uint32 sequence, sf::Uint8 buttons, sf::Uint8 aim, sf::Time duration)
+	: m_sequence(sequence)
+	, m_buttons(buttons)
+	, m_aim(aim)
+	, m_milliseconds(static_cast<sf::Uint8>(std::min<sf::Int32>(std::max<sf::Int32>(static_cast<sf::Int32>(std::lround(duration.asSeconds() * 1000.f)), 0), kMaxDuration)))
+{
+}
+
+sf::Time InputCommand::GetDuration() const
+{
+	return sf::milliseconds(m_milliseconds);
+}
+
+sf::Uint8 InputCommand::QuantizeAim(float degrees)
+{
+	const float steps = static_cast<float>(1 << kAimBits);
+	return static_cast<sf::Uint8>(static_cast<sf::Int32>(std::lround(degrees / 360.f * steps)) & ((1 << kAimBits) - 1));
+}
+
+float InputCommand::DequantizeAim(sf::Uint8 aim)
+{
+	return aim * 360.f / static_cast<float>(1 << kAimBits);
+}
+
+sf::Vector2f ApplyInput(sf::Vector2f position, const InputCommand& command, const sf::FloatRect& bounds)
+{
+	sf::Vector2f velocity;
+	if (command.m_buttons & InputCommand::kMoveLeft)
+	{
+		velocity.x -= kPlayerSpeed;
+	}
+	if (command.m_buttons & InputCommand::kMoveRight)
+	{
+		velocity.x += kPlayerSpeed;
+	}
+	if (command.m_buttons & InputCommand::kMoveUp)
+	{
+		velocity.y -= kPlayerSpeed;
+	}
+	if (command.m_buttons & InputCommand::kMoveDown)
+	{
+		velocity.y += kPlayerSpeed;
+	}
+
+	//If moving diagonally, reduce velocity (to have always same velocity)
+	if (velocity.x != 0.f && velocity.y != 0.f)
+	{
+		velocity /= std::sqrt(2.f);
+	}
+
+	position += velocity * command.GetDuration().asSeconds();
+	position.x = std::max(position.x, bounds.left + kBorderDistance);
+	position.x = std::min(position.x, bounds.left + bounds.width - kBorderDistance);
+	position.y = std::max(position.y, bounds.top + kBorderDistance);
+	position.y = std::min(position.y, bounds.top + bounds.height - kBorderDistance);
+	return position;
+}
+
+void WriteInputCommands(BitWriter& writer, const std::vector<InputCommand>& commands)
+{
+	writer.WriteCompact(static_cast<sf::Uint32>(commands.size()));
+	if (commands.empty())
+	{
+		return;
+	}
+
+	writer.Write(commands.front().m_sequence, 32);
+	writer.Write(commands.front().m_aim, InputCommand::kAimBits);
+	sf::Uint8 aim = commands.front().m_aim;
+	for (const InputCommand& command : commands)
+	{
+		writer.Write(command.m_buttons, InputCommand::kButtonBits);
+		writer.Write(command.m_milliseconds, InputCommand::kDurationBits);
+		writer.WriteBool(command.m_aim != aim);
+		if (command.m_aim != aim)
+		{
+			writer.Write(command.m_aim, InputCommand::kAimBits);
+			aim = command.m_aim;
+		}
+	}
+}
+
+bool ReadInputCommands(BitReader& reader, std::vector<InputCommand>& commands)
+{
+	commands.clear();
+	sf::Uint32 count = reader.ReadCompact();
+	if (count == 0)
+	{
+		return reader.IsValid();
+	}
+
+	sf::Uint32 sequence = reader.Read(32);
+	sf::Uint8 aim = static_cast<sf::Uint8>(reader.Read(InputCommand::kAimBits));
+	for (sf::Uint32 i = 0; i < count && reader.IsValid(); ++i)
+	{
+		InputCommand command;
+		command.m_sequence = sequence + i;
+		command.m_buttons = static_cast<sf::Uint8>(reader.Read(InputCommand::kButtonBits));
+		command.m_milliseconds = static_cast<sf::Uint8>(reader.Read(InputCommand::kDurationBits));
+		if (reader.ReadBool())
+		{
+			aim = static_cast<sf::Uint8>(reader.Read(InputCommand::kAimBits));
+		}
+		command.m_aim = aim;
+		commands.push_back(command);
+	}
+	return reader.IsValid();
+}
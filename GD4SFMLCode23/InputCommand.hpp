@@ -0,0 +1,50 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/System/Time.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <vector>
+
+class BitWriter;
+class BitReader;
+
+//One frame of input for a player aircraft: every held movement Action as a bit and where the aircraft is aiming
+//The client and the server apply it the same way
+struct InputCommand
+{
+	enum Button
+	{
+		kMoveLeft = 1 << 0,
+		kMoveRight = 1 << 1,
+		kMoveUp = 1 << 2,
+		kMoveDown = 1 << 3
+	};
+
+	static const unsigned int kButtonBits = 4;
+	//Durations are whole milliseconds so both ends step by exactly the same amount
+	static const unsigned int kDurationBits = 6;
+	static const sf::Uint8 kMaxDuration = (1 << kDurationBits) - 1;
+	//A full turn of the sprite's rotation in 256 steps
+	static const unsigned int kAimBits = 8;
+
+	InputCommand();
+	InputCommand(sf::Uint32 sequence, sf::Uint8 buttons, sf::Uint8 aim, sf::Time duration);
+	sf::Time GetDuration() const;
+
+	static sf::Uint8 QuantizeAim(float degrees);
+	static float DequantizeAim(sf::Uint8 aim);
+
+	//The client tick the input was sampled on, consecutive frames have consecutive sequences
+	sf::Uint32 m_sequence;
+	sf::Uint8 m_buttons;
+	sf::Uint8 m_aim;
+	sf::Uint8 m_milliseconds;
+};
+
+//Moves a player aircraft for one command and keeps it inside the view, like World::AdaptPlayerPosition
+sf::Vector2f ApplyInput(sf::Vector2f position, const InputCommand& command, const sf::FloatRect& bounds);
+
+//Commands must have consecutive sequence numbers, the aim is only written where it changed
+void WriteInputCommands(BitWriter& writer, const std::vector<InputCommand>& commands);
+bool ReadInputCommands(BitReader& reader, std::vector<InputCommand>& commands);
@@ -0,0 +1,86 @@
+#include "InputPredictor.hpp"
+#include "NetworkProtocol.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//Snapshots round positions, so only differences well above that rounding count as a misprediction
+	const float kCorrectionThreshold = 8 * POSITION_PRECISION;
+}
+
+InputPredictor::InputPredictor()
+	: m_next_sequence(1)
+	, m_correction_count(0)
+{
+}
+
+void InputPredictor::Reset(sf::Vector2f position)
+{
+	m_position = position;
+	m_pending_commands.clear();
+	m_predicted_positions.clear();
+}
+
+void InputPredictor::Predict(sf::Uint8 buttons, sf::Uint8 aim, sf::Time dt, const sf::FloatRect& bounds)
+{
+	InputCommand command(m_next_sequence++, buttons, aim, dt);
+	m_position = ApplyInput(m_position, command, bounds);
+
+	m_pending_commands.push_back(command);
+	m_predicted_positions.push_back(m_position);
+	if (m_pending_commands.size() > kMaxPendingCommands)
+	{
+		m_pending_commands.erase(m_pending_commands.begin());
+		m_predicted_positions.erase(m_predicted_positions.begin());
+	}
+}
+
+void InputPredictor::Reconcile(sf::Uint32 sequence, sf::Vector2f position, const sf::FloatRect& bounds)
+{
+	//Acknowledgements for commands that are already confirmed tell us nothing new
+	auto acknowledged = std::find_if(m_pending_commands.begin(), m_pending_commands.end(), [sequence](const InputCommand& command)
+	{
+		return command.m_sequence == sequence;
+	});
+	if (acknowledged == m_pending_commands.end())
+	{
+		return;
+	}
+
+	std::size_t count = acknowledged - m_pending_commands.begin() + 1;
+	sf::Vector2f predicted = m_predicted_positions[count - 1];
+	m_pending_commands.erase(m_pending_commands.begin(), m_pending_commands.begin() + count);
+	m_predicted_positions.erase(m_predicted_positions.begin(), m_predicted_positions.begin() + count);
+
+	sf::Vector2f error = predicted - position;
+	if (std::abs(error.x) <= kCorrectionThreshold && std::abs(error.y) <= kCorrectionThreshold)
+	{
+		return;
+	}
+
+	//Rewind to what the server says and apply every command it has not seen yet
+	++m_correction_count;
+	m_position = position;
+	for (std::size_t i = 0; i < m_pending_commands.size(); ++i)
+	{
+		m_position = ApplyInput(m_position, m_pending_commands[i], bounds);
+		m_predicted_positions[i] = m_position;
+	}
+}
+
+sf::Vector2f InputPredictor::GetPosition() const
+{
+	return m_position;
+}
+
+const std::vector<InputCommand>& InputPredictor::GetPendingCommands() const
+{
+	return m_pending_commands;
+}
+
+std::size_t InputPredictor::GetCorrectionCount() const
+{
+	return m_correction_count;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "InputCommand.hpp"
+
+#include <cstddef>
+#include <vector>
+
+//A local aircraft moves as soon as a key is pressed, the server's answer later confirms or corrects the prediction
+class InputPredictor
+{
+public:
+	//Commands the server has not acknowledged are resent, a long outage drops the oldest
+	static const std::size_t kMaxPendingCommands = 32;
+
+public:
+	InputPredictor();
+	void Reset(sf::Vector2f position);
+	void Predict(sf::Uint8 buttons, sf::Uint8 aim, sf::Time dt, const sf::FloatRect& bounds);
+	//The server applied every command up to sequence and ended at position
+	//If the prediction for that command was off, rewind to the server's position and replay the rest
+	void Reconcile(sf::Uint32 sequence, sf::Vector2f position, const sf::FloatRect& bounds);
+
+	sf::Vector2f GetPosition() const;
+	const std::vector<InputCommand>& GetPendingCommands() const;
+	std::size_t GetCorrectionCount() const;
+
+private:
+	sf::Uint32 m_next_sequence;
+	sf::Vector2f m_position;
+	std::vector<InputCommand> m_pending_commands;
+	//Where the prediction put the aircraft after each pending command
+	std::vector<sf::Vector2f> m_predicted_positions;
+	std::size_t m_correction_count;
+};
@@ -0,0 +1,142 @@
+#include "Interpolation.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	const sf::Int64 kDelayTicks = 2;
+	const sf::Int64 kMaxDelayTicks = InterpolationBuffer::kCapacity / 2;
+	const float kJitterMultiplier = 3.f;
+	const float kJitterSmoothing = 0.1f;
+	//Lets the latency creep up when the route gets slower
+	const float kLatencyDrift = 0.01f;
+
+	sf::Time Abs(sf::Time time)
+	{
+		return time < sf::Time::Zero ? -time : time;
+	}
+}
+
+InterpolationBuffer::InterpolationBuffer()
+	: m_states(kCapacity)
+	, m_oldest(0)
+	, m_size(0)
+{
+}
+
+void InterpolationBuffer::Push(sf::Time server_time, sf::Vector2f position)
+{
+	if (m_size > 0 && server_time <= At(m_size - 1).m_time)
+	{
+		return;
+	}
+
+	if (m_size == kCapacity)
+	{
+		m_oldest = (m_oldest + 1) % kCapacity;
+		--m_size;
+	}
+	m_states[(m_oldest + m_size) % kCapacity] = { server_time, position };
+	++m_size;
+}
+
+void InterpolationBuffer::Hold(sf::Time server_time)
+{
+	if (m_size > 0)
+	{
+		Push(server_time, At(m_size - 1).m_position);
+	}
+}
+
+bool InterpolationBuffer::Sample(sf::Time server_time, sf::Vector2f& position) const
+{
+	if (m_size == 0)
+	{
+		return false;
+	}
+
+	if (server_time <= At(0).m_time)
+	{
+		position = At(0).m_position;
+		return true;
+	}
+
+	for (std::size_t i = 1; i < m_size; ++i)
+	{
+		const State& to = At(i);
+		if (server_time <= to.m_time)
+		{
+			const State& from = At(i - 1);
+			float t = (server_time - from.m_time) / (to.m_time - from.m_time);
+			position = from.m_position + (to.m_position - from.m_position) * t;
+			return true;
+		}
+	}
+
+	//Nothing newer has arrived yet, hold the last known state rather than guess
+	position = At(m_size - 1).m_position;
+	return true;
+}
+
+const InterpolationBuffer::State& InterpolationBuffer::At(std::size_t index) const
+{
+	return m_states[(m_oldest + index) % kCapacity];
+}
+
+InterpolationClock::InterpolationClock(sf::Time tick_interval)
+	: m_tick_interval(tick_interval)
+	, m_measured(false)
+	, m_latency(sf::Time::Zero)
+	, m_jitter(sf::Time::Zero)
+{
+}
+
+void InterpolationClock::SetTickInterval(sf::Time tick_interval)
+{
+	m_tick_interval = tick_interval;
+	m_measured = false;
+}
+
+sf::Time InterpolationClock::GetServerTime(sf::Uint32 tick) const
+{
+	return m_tick_interval * static_cast<sf::Int64>(tick);
+}
+
+void InterpolationClock::OnSnapshot(sf::Uint32 tick, sf::Time server_time)
+{
+	sf::Time latency = server_time - GetServerTime(tick);
+	if (!m_measured)
+	{
+		m_latency = latency;
+		m_jitter = sf::Time::Zero;
+		m_measured = true;
+		return;
+	}
+
+	//The quickest arrival is the best estimate of the latency, later ones were held up on the way
+	m_jitter += (Abs(latency - m_latency) - m_jitter) * kJitterSmoothing;
+	if (latency < m_latency)
+	{
+		m_latency = latency;
+	}
+	else
+	{
+		m_latency += (latency - m_latency) * kLatencyDrift;
+	}
+}
+
+sf::Time InterpolationClock::GetRenderTime(sf::Time server_time) const
+{
+	return server_time - m_latency - GetDelay();
+}
+
+sf::Time InterpolationClock::GetDelay() const
+{
+	sf::Time delay = m_tick_interval * kDelayTicks + m_jitter * kJitterMultiplier;
+	return std::min(delay, m_tick_interval * kMaxDelayTicks);
+}
+
+sf::Time InterpolationClock::GetJitter() const
+{
+	return m_jitter;
+}
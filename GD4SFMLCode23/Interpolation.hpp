@@ -0,0 +1,63 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System/Time.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstddef>
+#include <vector>
+
+//Recent server states of one remote aircraft, stamped with server time
+class InterpolationBuffer
+{
+public:
+	static const std::size_t kCapacity = 32;
+
+public:
+	InterpolationBuffer();
+	//States older than the newest one are ignored
+	void Push(sf::Time server_time, sf::Vector2f position);
+	//Repeats the newest state at server_time, for ticks the server sent nothing new about this aircraft
+	//The next state then moves on from there instead of being spread over the whole gap
+	void Hold(sf::Time server_time);
+	//Interpolates between the two states around server_time, holding the oldest or newest state outside of them
+	bool Sample(sf::Time server_time, sf::Vector2f& position) const;
+
+private:
+	struct State
+	{
+		sf::Time m_time;
+		sf::Vector2f m_position;
+	};
+
+private:
+	const State& At(std::size_t index) const;
+
+private:
+	std::vector<State> m_states;
+	std::size_t m_oldest;
+	std::size_t m_size;
+};
+
+//Maps server ticks onto server time and picks how far in the past remote aircraft are drawn
+//The server's clock comes from ClockSync, this only measures how late and how unevenly snapshots arrive by it
+//The delay covers the snapshot latency, two ticks and a multiple of the measured arrival jitter
+class InterpolationClock
+{
+public:
+	explicit InterpolationClock(sf::Time tick_interval);
+	void SetTickInterval(sf::Time tick_interval);
+	sf::Time GetServerTime(sf::Uint32 tick) const;
+	//server_time is the server's clock when the snapshot arrived
+	void OnSnapshot(sf::Uint32 tick, sf::Time server_time);
+	//Server time to draw remote aircraft at, given the server's clock now
+	sf::Time GetRenderTime(sf::Time server_time) const;
+	sf::Time GetDelay() const;
+	sf::Time GetJitter() const;
+
+private:
+	sf::Time m_tick_interval;
+	bool m_measured;
+	//How long after its tick a snapshot arrives when nothing holds it up
+	sf::Time m_latency;
+	sf::Time m_jitter;
+};
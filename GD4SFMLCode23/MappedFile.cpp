@@ -0,0 +1,146 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+	: m_data(nullptr)
+	, m_size(0)
+	, m_file(INVALID_HANDLE_VALUE)
+	, m_mapping(nullptr)
+{
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<std::size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile()
+	: m_data(nullptr)
+	, m_size(0)
+	, m_file(-1)
+{
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+	m_file = open(path.c_str(), O_RDONLY);
+	if (m_file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(m_file, &status) != 0 || status.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	//Playback reads front to back, so the kernel can read ahead
+	madvise(data, static_cast<std::size_t>(status.st_size), MADV_SEQUENTIAL);
+	m_data = static_cast<const char*>(data);
+	m_size = static_cast<std::size_t>(status.st_size);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+	{
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+	if (m_file >= 0)
+	{
+		close(m_file);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_file = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+const char* MappedFile::GetData() const
+{
+	return m_data;
+}
+
+std::size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <SFML/System/NonCopyable.hpp>
+
+#include <cstddef>
+#include <string>
+
+//A read-only view of a whole file through the OS's memory mapping, pages are only read in as they are touched
+class MappedFile : private sf::NonCopyable
+{
+public:
+	MappedFile();
+	~MappedFile();
+	bool Open(const std::string& path);
+	void Close();
+	const char* GetData() const;
+	std::size_t GetSize() const;
+
+private:
+	const char* m_data;
+	std::size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+};
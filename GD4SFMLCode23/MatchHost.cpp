@@ -0,0 +1,268 @@
+#include "MatchHost.hpp"
+#include "NetworkProtocol.hpp"
+
+#include <SFML/Network/Packet.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	//Poller key of the listener, pending connections use their slot
+	const std::size_t kListenerKey = static_cast<std::size_t>(-1);
+	const std::size_t kMaxAcceptsPerPass = 64;
+	//A client that has not asked for a room by then is dropped
+	const sf::Time kJoinTimeout = sf::seconds(5.f);
+	//Rooms finishing a pass do not wake the host, so it checks for due rooms at least this often
+	const sf::Time kMaxWait = sf::milliseconds(1);
+
+	//Each room records to its own file, match.replay becomes match-room0.replay
+	std::string GetRoomReplayPath(const std::string& path, std::size_t room)
+	{
+		std::size_t extension = path.find_last_of('.');
+		std::size_t directory = path.find_last_of("/\\");
+		if (extension == std::string::npos || (directory != std::string::npos && extension < directory))
+		{
+			extension = path.size();
+		}
+		return path.substr(0, extension) + "-room" + std::to_string(room) + path.substr(extension);
+	}
+}
+
+MatchHost::Room::Room()
+	: m_busy(false)
+	, m_due_time(0)
+{
+}
+
+MatchHost::MatchHost(sf::Vector2f battlefield_size, const ServerSettings& settings, std::size_t room_count, std::size_t thread_count)
+	: m_thread(&MatchHost::ExecutionThread, this)
+	, m_listening_state(false)
+	, m_pool(thread_count)
+	, m_waiting_thread_end(false)
+{
+	for (std::size_t i = 0; i < room_count; ++i)
+	{
+		ServerSettings room_settings = settings;
+		room_settings.m_room_identifier = static_cast<sf::Int32>(i);
+		if (!settings.m_replay_path.empty())
+		{
+			room_settings.m_replay_path = GetRoomReplayPath(settings.m_replay_path, i);
+		}
+
+		RoomPtr room(new Room());
+		room->m_server.reset(new GameServer(battlefield_size, room_settings));
+		m_rooms.emplace_back(std::move(room));
+	}
+
+	//Bind before the thread starts so the caller can tell if the port was taken
+	m_listener_socket.setBlocking(false);
+	m_listening_state = (m_listener_socket.listen(settings.m_port) == sf::TcpListener::Done);
+	if (m_listening_state)
+	{
+		m_poller.Add(m_listener_socket, kListenerKey);
+		m_thread.launch();
+	}
+}
+
+MatchHost::~MatchHost()
+{
+	m_waiting_thread_end = true;
+	m_thread.wait();
+}
+
+bool MatchHost::IsListening() const
+{
+	return m_listening_state;
+}
+
+std::size_t MatchHost::GetThreadCount() const
+{
+	return m_pool.GetThreadCount();
+}
+
+void MatchHost::ExecutionThread()
+{
+	while (!m_waiting_thread_end)
+	{
+		HandleIncomingConnections();
+		HandleJoinRequests();
+		m_poller.Wait(std::min(ScheduleRooms(), kMaxWait));
+	}
+}
+
+void MatchHost::HandleIncomingConnections()
+{
+	if (!m_poller.IsReady(kListenerKey))
+	{
+		return;
+	}
+
+	for (std::size_t accepted = 0; accepted < kMaxAcceptsPerPass; ++accepted)
+	{
+		GameServer::PeerSocketPtr socket(new GameServer::PeerSocket());
+		if (m_listener_socket.accept(*socket) != sf::TcpListener::Done)
+		{
+			break;
+		}
+		socket->setBlocking(false);
+
+		std::unique_ptr<PendingConnection> connection(new PendingConnection());
+		connection->m_socket = std::move(socket);
+		connection->m_accept_time = m_clock.getElapsedTime();
+		PendingConnection& added_connection = *connection;
+		added_connection.m_slot = m_pending_connections.Add(std::move(connection));
+		m_poller.Add(*added_connection.m_socket, added_connection.m_slot);
+	}
+}
+
+void MatchHost::HandleJoinRequests()
+{
+	std::vector<std::size_t> finished_slots;
+	for (std::size_t key : m_poller.GetReady())
+	{
+		PendingConnection* connection = m_pending_connections.Get(key);
+		if (!connection)
+		{
+			continue;
+		}
+
+		sf::Packet packet;
+		sf::Socket::Status status = connection->m_socket->receive(packet);
+		if (status == sf::Socket::NotReady || status == sf::Socket::Partial)
+		{
+			continue;
+		}
+
+		//Anything other than a join or resume request first is not a client of ours
+		sf::Int32 packet_type;
+		if (status == sf::Socket::Done && packet >> packet_type)
+		{
+			sf::Int32 room_identifier;
+			sf::Uint64 session_token;
+			if (packet_type == static_cast<sf::Int32>(Client::PacketType::kJoinRoom) && packet >> room_identifier)
+			{
+				RouteConnection(*connection, room_identifier);
+			}
+			else if (packet_type == static_cast<sf::Int32>(Client::PacketType::kResumeSession) && packet >> session_token)
+			{
+				ResumeConnection(*connection, session_token);
+			}
+		}
+		finished_slots.emplace_back(key);
+	}
+
+	//A connection that answered just as its time ran out is already finished, it must not be dropped twice
+	for (const PendingConnection* connection : m_pending_connections)
+	{
+		if (m_clock.getElapsedTime() > connection->m_accept_time + kJoinTimeout && std::find(finished_slots.begin(), finished_slots.end(), connection->m_slot) == finished_slots.end())
+		{
+			finished_slots.emplace_back(connection->m_slot);
+		}
+	}
+
+	for (std::size_t slot : finished_slots)
+	{
+		DropPendingConnection(slot);
+	}
+}
+
+void MatchHost::RouteConnection(PendingConnection& connection, sf::Int32 room_identifier)
+{
+	//The socket leaves this poller before the room adds it to its own
+	m_poller.Remove(*connection.m_socket);
+
+	if (room_identifier == Client::kAnyRoom)
+	{
+		//Fill the rooms in order, so players find each other instead of spreading out
+		for (RoomPtr& room : m_rooms)
+		{
+			if (room->m_server->AddConnection(connection.m_socket))
+			{
+				return;
+			}
+		}
+	}
+	else if (room_identifier >= 0 && static_cast<std::size_t>(room_identifier) < m_rooms.size())
+	{
+		if (m_rooms[room_identifier]->m_server->AddConnection(connection.m_socket))
+		{
+			return;
+		}
+	}
+
+	//The room is full or does not exist, say so before the connection is closed
+	sf::Packet packet;
+	packet << static_cast<sf::Int32>(Server::PacketType::kBroadcastMessage);
+	packet << std::string("No room for another player");
+	connection.m_socket->setBlocking(true);
+	connection.m_socket->send(packet);
+	connection.m_socket.reset();
+	std::cout << "Turned away a player asking for room " << room_identifier << std::endl;
+}
+
+void MatchHost::ResumeConnection(PendingConnection& connection, sf::Uint64 session_token)
+{
+	m_poller.Remove(*connection.m_socket);
+
+	//Rooms put their number in the tokens they hand out, the room checks the rest
+	std::size_t room = static_cast<std::size_t>(session_token >> Session::kRoomShift) - 1;
+	if (session_token != 0 && room < m_rooms.size() && m_rooms[room]->m_server->AddConnection(connection.m_socket, session_token))
+	{
+		return;
+	}
+
+	sf::Packet packet;
+	packet << static_cast<sf::Int32>(Server::PacketType::kSession) << static_cast<sf::Uint64>(0);
+	connection.m_socket->setBlocking(true);
+	connection.m_socket->send(packet);
+	connection.m_socket.reset();
+}
+
+void MatchHost::DropPendingConnection(std::size_t slot)
+{
+	std::unique_ptr<PendingConnection> connection = m_pending_connections.Remove(slot);
+	if (!connection)
+	{
+		return;
+	}
+
+	//A routed connection has already left the poller, its socket now belongs to a room or has been closed
+	if (connection->m_socket)
+	{
+		m_poller.Remove(*connection->m_socket);
+	}
+}
+
+sf::Time MatchHost::ScheduleRooms()
+{
+	sf::Int64 now = m_clock.getElapsedTime().asMicroseconds();
+	sf::Int64 next_due = now + kMaxWait.asMicroseconds();
+
+	for (RoomPtr& room_ptr : m_rooms)
+	{
+		Room& room = *room_ptr;
+		if (room.m_busy)
+		{
+			continue;
+		}
+
+		if (room.m_due_time <= now)
+		{
+			room.m_busy = true;
+			m_pool.Submit([this, &room]()
+			{
+				sf::Time next_step = room.m_server->Update();
+				room.m_due_time = (m_clock.getElapsedTime() + next_step).asMicroseconds();
+				room.m_busy = false;
+			});
+		}
+		else
+		{
+			next_due = std::min(next_due, room.m_due_time.load());
+		}
+	}
+
+	return sf::microseconds(std::max(next_due - now, static_cast<sf::Int64>(0)));
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <SFML/Network/TcpListener.hpp>
+#include <SFML/System/Clock.hpp>
+#include <SFML/System/Thread.hpp>
+#include <SFML/System/Vector2.hpp>
+#include "GameServer.hpp"
+#include "ServerSettings.hpp"
+#include "SlotTable.hpp"
+#include "SocketPoller.hpp"
+#include "ThreadPool.hpp"
+
+//Hosts many independent matches in one process
+//One listener takes every connection and hands it to the room named in the client's kJoinRoom
+//Rooms have no thread of their own, each pass of a room is a task on a pool sized to the core count
+class MatchHost
+{
+public:
+	MatchHost(sf::Vector2f battlefield_size, const ServerSettings& settings, std::size_t room_count, std::size_t thread_count = 0);
+	~MatchHost();
+	bool IsListening() const;
+	std::size_t GetThreadCount() const;
+
+private:
+	struct Room
+	{
+		Room();
+		std::unique_ptr<GameServer> m_server;
+		//Set while a pass of the room is queued or running, so a room never runs on two workers at once
+		std::atomic<bool> m_busy;
+		//When the room next needs a pass, in microseconds on the host's clock
+		std::atomic<sf::Int64> m_due_time;
+	};
+
+	//Accepted, but the client has not said which room it wants yet
+	struct PendingConnection
+	{
+		GameServer::PeerSocketPtr m_socket;
+		sf::Time m_accept_time;
+		std::size_t m_slot;
+	};
+
+	typedef std::unique_ptr<Room> RoomPtr;
+
+private:
+	void ExecutionThread();
+	void HandleIncomingConnections();
+	void HandleJoinRequests();
+	void RouteConnection(PendingConnection& connection, sf::Int32 room_identifier);
+	//A dropped player coming back goes to the room that holds their session
+	void ResumeConnection(PendingConnection& connection, sf::Uint64 session_token);
+	void DropPendingConnection(std::size_t slot);
+	//Queues a pass for every room that is due and returns how long until the next one is
+	sf::Time ScheduleRooms();
+
+private:
+	sf::Thread m_thread;
+	sf::Clock m_clock;
+	Pollable<sf::TcpListener> m_listener_socket;
+	bool m_listening_state;
+	SocketPoller m_poller;
+	SlotTable<PendingConnection> m_pending_connections;
+
+	//Declared before the pool, so the workers have finished with the rooms before they are destroyed
+	std::vector<RoomPtr> m_rooms;
+	ThreadPool m_pool;
+	bool m_waiting_thread_end;
+};
@@ -0,0 +1,107 @@
+#include "MessageBatch.hpp"
+#include "NetworkProtocol.hpp"
+
+#include <memory>
+
+namespace
+{
+	//sf::Packet writes integers in network byte order, and frames each packet with its size the same way
+	void WriteUint32(std::vector<char>& buffer, sf::Uint32 value)
+	{
+		buffer.push_back(static_cast<char>(value >> 24));
+		buffer.push_back(static_cast<char>(value >> 16));
+		buffer.push_back(static_cast<char>(value >> 8));
+		buffer.push_back(static_cast<char>(value));
+	}
+
+	sf::Uint32 ReadUint32(const char* data)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		return (static_cast<sf::Uint32>(bytes[0]) << 24) | (static_cast<sf::Uint32>(bytes[1]) << 16) | (static_cast<sf::Uint32>(bytes[2]) << 8) | bytes[3];
+	}
+}
+
+MessageBatch::MessageBatch()
+	: m_size(0)
+{
+}
+
+MessageBatch::Message MessageBatch::Serialize(const sf::Packet& packet)
+{
+	std::shared_ptr<std::vector<char>> message(new std::vector<char>());
+	message->reserve(sizeof(sf::Uint32) + packet.getDataSize());
+	WriteUint32(*message, static_cast<sf::Uint32>(packet.getDataSize()));
+	const char* data = static_cast<const char*>(packet.getData());
+	message->insert(message->end(), data, data + packet.getDataSize());
+	return message;
+}
+
+void MessageBatch::Append(const Message& message)
+{
+	m_messages.emplace_back(message);
+	m_size += message->size();
+}
+
+bool MessageBatch::IsEmpty() const
+{
+	return m_messages.empty();
+}
+
+std::size_t MessageBatch::GetMessageCount() const
+{
+	return m_messages.size();
+}
+
+void MessageBatch::MoveTo(OutboundQueue& queue)
+{
+	if (m_messages.size() == 1)
+	{
+		//No point wrapping a single message, its own size prefix already frames it
+		queue.Push(m_messages.front());
+	}
+	else if (m_messages.size() > 1)
+	{
+		std::shared_ptr<std::vector<char>> header(new std::vector<char>());
+		WriteUint32(*header, static_cast<sf::Uint32>(sizeof(sf::Int32) + m_size));
+		WriteUint32(*header, static_cast<sf::Uint32>(Server::PacketType::kBatch));
+		queue.Push(header);
+		for (const Message& message : m_messages)
+		{
+			queue.Push(message);
+		}
+	}
+	Clear();
+}
+
+void MessageBatch::Clear()
+{
+	m_messages.clear();
+	m_size = 0;
+}
+
+bool MessageBatch::Split(const sf::Packet& batch, std::vector<sf::Packet>& messages)
+{
+	const char* data = static_cast<const char*>(batch.getData());
+	std::size_t size = batch.getDataSize();
+	std::size_t offset = sizeof(sf::Int32);
+
+	while (offset < size)
+	{
+		if (size - offset < sizeof(sf::Uint32))
+		{
+			return false;
+		}
+
+		std::size_t message_size = ReadUint32(data + offset);
+		offset += sizeof(sf::Uint32);
+		if (message_size > size - offset)
+		{
+			return false;
+		}
+
+		messages.emplace_back();
+		messages.back().append(data + offset, message_size);
+		offset += message_size;
+	}
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/Network/Packet.hpp>
+
+#include <cstddef>
+#include <vector>
+#include "OutboundQueue.hpp"
+
+//Reliable messages queued for one peer during a step, sent together as a single packet
+//Several messages go out as a Server::PacketType::kBatch packet holding each message's size and bytes, a lone message is sent as it is
+class MessageBatch
+{
+public:
+	//A message's size followed by its bytes, built once and shared by every peer it goes to
+	typedef OutboundQueue::Buffer Message;
+
+public:
+	MessageBatch();
+	static Message Serialize(const sf::Packet& packet);
+	void Append(const Message& message);
+	bool IsEmpty() const;
+	std::size_t GetMessageCount() const;
+	//Frames the batch the way sf::Packet does on the wire, queues it and empties the batch
+	void MoveTo(OutboundQueue& queue);
+	void Clear();
+
+	//Splits a received kBatch packet back into the messages it carries
+	static bool Split(const sf::Packet& batch, std::vector<sf::Packet>& messages);
+
+private:
+	std::vector<Message> m_messages;
+	std::size_t m_size;
+};
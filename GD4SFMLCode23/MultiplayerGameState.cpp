@@ -1,11 +1,14 @@
 #include "MultiplayerGameState.hpp"
 #include "MusicPlayer.hpp"
+#include "PositionCodec.hpp"
 #include "Utility.hpp"
 
 #include <SFML/Graphics/RenderWindow.hpp>
 #include <SFML/Network/Packet.hpp>
 #include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/UdpSocket.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include "PickupType.hpp"
 #include <iostream>
@@ -30,23 +33,74 @@ sf::IpAddress GetAddressFromFile()
 
 }
 
-MultiplayerGameState::MultiplayerGameState(StateStack& stack, Context context, bool is_host) 
+namespace
+{
+	const sf::Time kReplaySeekStep = sf::seconds(5.f);
+	//While resuming a session a non-blocking connect is started this often
+	//One still in progress when the interval is up is dropped and a fresh one started
+	const sf::Time kResumeRetryInterval = sf::seconds(1.f);
+
+	std::string FormatReplayTime(sf::Time time)
+	{
+		sf::Int32 seconds = std::max(time.asMilliseconds() / 1000, 0);
+		std::string remainder = std::to_string(seconds % 60);
+		return std::to_string(seconds / 60) + ":" + (remainder.size() < 2 ? "0" : "") + remainder;
+	}
+}
+
+MultiplayerGameState::MultiplayerGameState(StateStack& stack, Context context, bool is_host, const ReplaySettings& replay)
 	:State(stack, context)
 	, m_world(*context.window, *context.fonts, *context.sounds, true)
 	, m_window(*context.window)
 	, m_texture_holder(*context.textures)
 	, m_connected(false)
+	, m_server_udp_port(0)
+	, m_udp_token(0)
+	, m_udp_offered(false)
+	, m_udp_confirmed(false)
+	, m_udp_out_sequence(0)
+	, m_udp_in_sequence(0)
+	, m_last_snapshot_tick(0)
+	, m_interpolation_clock(sf::seconds(1.f / 20.f))
 	, m_game_server(nullptr)
 	, m_active_state(true)
 	, m_has_focus(true)
 	, m_host(is_host)
 	, m_game_started(false)
-	, m_client_timeout(sf::seconds(900.f))
+	, m_client_timeout(sf::seconds(5.f))
 	, m_time_since_last_packet(sf::Time::Zero)
+	, m_server_closed(false)
+	, m_session_token(0)
+	, m_resuming(false)
+	, m_resume_connecting(false)
+	, m_resume_connected(false)
+	, m_next_resume_attempt(sf::Time::Zero)
+	, m_receive_budget(sf::milliseconds(2))
+	, m_backlog_depth(0)
+	, m_max_backlog_depth(0)
+	, m_join_total(0)
+	, m_join_built(0)
+	, m_join_budget(sf::milliseconds(2))
+	, m_statistics(false)
+	, m_show_statistics(false)
+	, m_replay_time(sf::Time::Zero)
+	, m_replay_paused(false)
+	, m_replay_finished(false)
+	, m_replay_unthrottled(replay.m_unthrottled)
 {
 	m_broadcast_text.setFont(context.fonts->Get(Font::kMain));
 	m_broadcast_text.setPosition(1024.f / 2, 100.f);
 
+	m_statistics_text.setFont(context.fonts->Get(Font::kMain));
+	m_statistics_text.setCharacterSize(14);
+	m_statistics_text.setFillColor(sf::Color::White);
+	m_statistics_text.setPosition(10.f, 10.f);
+
+	m_join_text.setFont(context.fonts->Get(Font::kMain));
+	m_join_text.setCharacterSize(20);
+	m_join_text.setFillColor(sf::Color::White);
+	m_join_text.setPosition(m_window.getSize().x / 2.f, m_window.getSize().y - 60.f);
+
 	m_player_invitation_text.setFont(context.fonts->Get(Font::kMain));
 	m_player_invitation_text.setCharacterSize(20);
 	m_player_invitation_text.setFillColor(sf::Color::White);
@@ -68,6 +122,29 @@ MultiplayerGameState::MultiplayerGameState(StateStack& stack, Context context, b
 	m_failed_connection_text.setString("Failed to connect to server");
 	Utility::CentreOrigin(m_failed_connection_text);
 
+	//A replay stands in for the server, nothing is hosted or connected to
+	if (!replay.m_path.empty())
+	{
+		m_replay.reset(new ReplayReader());
+		if (m_replay->Open(replay.m_path))
+		{
+			m_connected = true;
+			m_interpolation_clock.SetTickInterval(m_replay->GetTickInterval());
+			SeekReplay(m_interpolation_clock.GetServerTime(m_replay->GetFirstTick()));
+			m_replay_run_clock.restart();
+			m_replay_frame_clock.restart();
+		}
+		else
+		{
+			std::cout << "Could not open the replay " << replay.m_path << std::endl;
+			m_replay.reset();
+			m_failed_connection_text.setString("Could not open the replay");
+			Utility::CentreOrigin(m_failed_connection_text);
+			m_failed_connection_clock.restart();
+		}
+		return;
+	}
+
 	//If this is the host, create a server
 	sf::IpAddress ip;
 
@@ -85,7 +162,14 @@ MultiplayerGameState::MultiplayerGameState(StateStack& stack, Context context, b
 	if (m_socket.connect(ip, SERVER_PORT, sf::seconds(5.f)) == sf::TcpSocket::Done)
 	{
 		m_connected = true;
+		m_server_address = ip;
 		std::cout << "Connected to Server. " << "IP: " << ip << " PORT: " << SERVER_PORT << " Remote Address: " << m_socket.getRemoteAddress() << std::endl;
+
+		//A dedicated server hosts several matches and puts us in one with space
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(Client::PacketType::kJoinRoom) << Client::kAnyRoom;
+		m_statistics.RecordOutgoing(static_cast<sf::Int32>(Client::PacketType::kJoinRoom), packet.getDataSize() + sizeof(sf::Uint32));
+		m_socket.send(packet);
 	}
 	else
 	{
@@ -96,6 +180,7 @@ MultiplayerGameState::MultiplayerGameState(StateStack& stack, Context context, b
 
 	//Set socket to non-blocking
 	m_socket.setBlocking(false);
+	m_udp_socket.setBlocking(false);
 
 	//Play the game music
 	//context.music->Play(MusicThemes::kMissionTheme);
@@ -103,7 +188,7 @@ MultiplayerGameState::MultiplayerGameState(StateStack& stack, Context context, b
 
 MultiplayerGameState::~MultiplayerGameState()
 {
-	if (!m_host && m_connected)
+	if (!m_host && m_connected && !m_replay)
 	{
 		//Inform server this client is dying
 		sf::Packet packet;
@@ -126,6 +211,21 @@ void MultiplayerGameState::Draw()
 			m_window.draw(m_broadcast_text);
 		}
 
+		if (m_show_statistics || m_replay)
+		{
+			m_window.draw(m_statistics_text);
+		}
+
+		if (IsJoining())
+		{
+			m_window.draw(m_join_text);
+		}
+
+		if (m_resuming)
+		{
+			m_window.draw(m_failed_connection_text);
+		}
+
 		//Draw Custom Text here
 		/*if (m_local_player_identifiers.size() < 2 && m_player_invitation_time < sf::seconds(0.5f))
 		{
@@ -140,10 +240,44 @@ void MultiplayerGameState::Draw()
 
 bool MultiplayerGameState::Update(sf::Time dt)
 {
+	if (m_replay)
+	{
+		UpdateReplay(dt);
+		return true;
+	}
+
+	//The world is held as it was while the connection is being resumed
+	if (m_resuming)
+	{
+		UpdateResume();
+		return true;
+	}
+
 	//Connected to the Server: Handle all the network logic
 	if (m_connected)
 	{
+		//Handle everything the server sent since last frame before the world moves, so remote changes apply this frame
+		std::size_t packets_received = HandlePackets();
+		packets_received += HandleDatagrams();
+		if (m_server_closed || (packets_received == 0 && m_time_since_last_packet > m_client_timeout))
+		{
+			//Check for timeout with the server, with a session we try to get back in first
+			if (m_session_token != 0)
+			{
+				BeginResume();
+				return true;
+			}
+			OnConnectionLost("Lost connection to the server");
+		}
+
+		if (IsJoining())
+		{
+			BuildJoiningAircraft(m_join_budget);
+		}
+
 		m_world.Update(dt);
+		PredictLocalAircraft(dt);
+		InterpolateRemoteAircraft();
 
 		//Remove players whose aircraft were destroyed
 		bool found_local_plane = false;
@@ -185,43 +319,11 @@ bool MultiplayerGameState::Update(sf::Time dt)
 			RequestStackPush(StateID::kGameOver);
 		}
 
-		//Only handle the realtime input if the window has focus and the game is unpaused
-		if (m_active_state && m_has_focus)
-		{
-			CommandQueue& commands = m_world.GetCommandQueue();
-			for (auto& pair : m_players)
-			{
-				pair.second->HandleRealtimeInput(commands);
-			}
-		}
-
-		//Always handle the network input
-		CommandQueue& commands = m_world.GetCommandQueue();
-		for (auto& pair : m_players)
+		//Keep offering the UDP handshake until the server answers over UDP
+		if (m_udp_offered && !m_udp_confirmed && m_udp_hello_clock.getElapsedTime() > sf::seconds(0.25f))
 		{
-			pair.second->HandleRealtimeNetworkInput(commands);
-		}
-
-		//Handle messages from the server that may have arrived
-		sf::Packet packet;
-		if (m_socket.receive(packet) == sf::Socket::Done)
-		{
-			m_time_since_last_packet = sf::seconds(0.f);
-			sf::Int32 packet_type;
-			packet >> packet_type;
-			HandlePacket(packet_type, packet);
-		}
-		else
-		{
-			//Check for timeout with the server
-			if (m_time_since_last_packet > m_client_timeout)
-			{
-				m_connected = false;
-				m_failed_connection_text.setString("Lost connection to the server");
-				Utility::CentreOrigin(m_failed_connection_text);
-
-				m_failed_connection_clock.restart();
-			}
+			SendDatagram(Client::PacketType::kUdpHello, BitWriter());
+			m_udp_hello_clock.restart();
 		}
 
 		UpdateBroadcastMessage(dt);
@@ -243,28 +345,43 @@ bool MultiplayerGameState::Update(sf::Time dt)
 			packet << game_action.position.x;
 			packet << game_action.position.y;
 
+			m_statistics.RecordOutgoing(static_cast<sf::Int32>(Client::PacketType::kGameEvent), packet.getDataSize() + sizeof(sf::Uint32));
 			m_socket.send(packet);
 		}
 
-		//Regular position updates
+		//Regular input updates, every command the server has not acknowledged is sent again so a lost datagram loses no input
 		if (m_tick_clock.getElapsedTime() > sf::seconds(1.f / 20.f))
 		{
-			sf::Packet position_update_packet;
-			position_update_packet << static_cast<sf::Int32>(Client::PacketType::kPositionUpdate);
-			position_update_packet << static_cast<sf::Int32>(m_local_player_identifiers.size());
+			sf::Uint32 max_identifier = 0;
+			for (const auto& predictor : m_predictors)
+			{
+				max_identifier = std::max(max_identifier, static_cast<sf::Uint32>(predictor.first));
+			}
 
-			for (sf::Int32 identifier : m_local_player_identifiers)
+			BitWriter input;
+			unsigned int identifier_bits = BitsRequired(max_identifier);
+			input.Write(identifier_bits - 1, Datagram::kIdentifierWidthBits);
+			input.WriteCompact(static_cast<sf::Uint32>(m_predictors.size()));
+			for (const auto& predictor : m_predictors)
 			{
-				if (Aircraft* aircraft = m_world.GetAircraft(identifier))
-				{
-					//UPDATE STATS
-					position_update_packet << identifier << aircraft->getPosition().x << aircraft->getPosition().y;
-				}
+				input.Write(static_cast<sf::Uint32>(predictor.first), identifier_bits);
+				WriteInputCommands(input, predictor.second.GetPendingCommands());
 			}
-			m_socket.send(position_update_packet);
+			SendUnreliable(Client::PacketType::kInput, input);
 			m_tick_clock.restart();
 		}
+
+		//Ping at the input rate until the server's clock is known, remote aircraft cannot be drawn before that
+		sf::Time ping_interval = m_clock_sync.IsSynchronised() ? sf::milliseconds(Heartbeat::kPingIntervalMilliseconds) : sf::seconds(1.f / 20.f);
+		if (m_ping_clock.getElapsedTime() >= ping_interval)
+		{
+			BitWriter ping;
+			ping.WriteTime(m_network_clock.getElapsedTime().asMicroseconds());
+			SendUnreliable(Client::PacketType::kPing, ping);
+			m_ping_clock.restart();
+		}
 		m_time_since_last_packet += dt;
+		UpdateStatistics(dt);
 	}
 
 	//Failed to connect and waited for more than 5 seconds: Back to menu
@@ -279,12 +396,42 @@ bool MultiplayerGameState::Update(sf::Time dt)
 
 bool MultiplayerGameState::HandleEvent(const sf::Event& event)
 {
+	//Playback only takes the replay controls
+	if (m_replay)
+	{
+		if (event.type == sf::Event::KeyPressed)
+		{
+			if (event.key.code == sf::Keyboard::Escape)
+			{
+				RequestStackPush(StateID::kNetworkPause);
+			}
+			else if (event.key.code == sf::Keyboard::Space)
+			{
+				m_replay_paused = !m_replay_paused;
+			}
+			else if (event.key.code == sf::Keyboard::Left)
+			{
+				SeekReplay(m_replay_time - kReplaySeekStep);
+			}
+			else if (event.key.code == sf::Keyboard::Right)
+			{
+				SeekReplay(m_replay_time + kReplaySeekStep);
+			}
+		}
+		return true;
+	}
+
 	//Game input handling
 	CommandQueue& commands = m_world.GetCommandQueue();
 
+	//Shots are aimed at the mouse and checked by the server against the moment remote aircraft are drawn at
+	sf::Time view_time = m_interpolation_clock.GetRenderTime(GetServerTime());
+	sf::Vector2f aim_position = m_window.mapPixelToCoords(sf::Mouse::getPosition(m_window), sf::View(m_world.GetViewBounds()));
+
 	//Forward events to all players
 	for (auto& pair : m_players)
 	{
+		pair.second->SetAim(view_time, aim_position);
 		pair.second->HandleEvent(event, commands);
 	}
 
@@ -296,6 +443,10 @@ bool MultiplayerGameState::HandleEvent(const sf::Event& event)
 			DisableAllRealtimeActions();
 			RequestStackPush(StateID::kNetworkPause);
 		}
+		else if (event.key.code == sf::Keyboard::F3)
+		{
+			m_show_statistics = !m_show_statistics;
+		}
 	}
 	else if (event.type == sf::Event::GainedFocus)
 	{
@@ -315,7 +466,7 @@ void MultiplayerGameState::OnActivate()
 
 void MultiplayerGameState::OnDestroy()
 {
-	if (!m_host && m_connected)
+	if (!m_host && m_connected && !m_replay)
 	{
 		//Inform server this client is dying
 		sf::Packet packet;
@@ -326,11 +477,8 @@ void MultiplayerGameState::OnDestroy()
 
 void MultiplayerGameState::DisableAllRealtimeActions()
 {
+	//Held keys are sampled into every InputCommand, so the next ones simply go out empty
 	m_active_state = false;
-	for (sf::Int32 identifier : m_local_player_identifiers)
-	{
-		m_players[identifier]->DisableAllRealtimeActions();
-	}
 }
 
 void MultiplayerGameState::UpdateBroadcastMessage(sf::Time elapsed_time)
@@ -357,6 +505,449 @@ void MultiplayerGameState::UpdateBroadcastMessage(sf::Time elapsed_time)
 	}
 }
 
+std::size_t MultiplayerGameState::HandlePackets()
+{
+	//Stop at the budget and leave the rest for next frame rather than stalling rendering
+	sf::Clock receive_clock;
+	std::size_t packets_received = 0;
+	sf::Packet packet;
+	sf::Socket::Status status = sf::Socket::NotReady;
+	while (receive_clock.getElapsedTime() < m_receive_budget && (status = m_socket.receive(packet)) == sf::Socket::Done)
+	{
+		m_time_since_last_packet = sf::seconds(0.f);
+		sf::Int32 packet_type;
+		packet >> packet_type;
+
+		//A batch is counted message by message when it is split
+		if (packet_type != static_cast<sf::Int32>(Server::PacketType::kBatch))
+		{
+			m_statistics.RecordIncoming(packet_type, packet.getDataSize() + sizeof(sf::Uint32));
+		}
+		HandlePacket(packet_type, packet);
+		packet.clear();
+		++packets_received;
+	}
+
+	if (status == sf::Socket::Disconnected)
+	{
+		m_server_closed = true;
+	}
+
+	//Track how far behind we are, a budget hit means more was still waiting
+	m_backlog_depth = packets_received;
+	m_max_backlog_depth = std::max(m_max_backlog_depth, packets_received);
+	if (receive_clock.getElapsedTime() >= m_receive_budget)
+	{
+		m_statistics.RecordReceiveBudgetHit();
+	}
+	return packets_received;
+}
+
+std::size_t MultiplayerGameState::HandleDatagrams()
+{
+	if (!m_udp_offered)
+	{
+		return 0;
+	}
+
+	sf::Clock receive_clock;
+	std::size_t datagrams_received = 0;
+	sf::Packet packet;
+	sf::IpAddress sender;
+	unsigned short sender_port;
+	while (receive_clock.getElapsedTime() < m_receive_budget && m_udp_socket.receive(packet, sender, sender_port) == sf::Socket::Done)
+	{
+		++datagrams_received;
+		BitReader reader(packet.getData(), packet.getDataSize());
+		sf::Uint16 sequence = static_cast<sf::Uint16>(reader.Read(Datagram::kSequenceBits));
+		Server::PacketType packet_type = static_cast<Server::PacketType>(reader.Read(Server::kPacketTypeBits));
+		if (sender == m_server_address && reader.IsValid())
+		{
+			m_udp_confirmed = true;
+			m_statistics.RecordIncoming(static_cast<sf::Int32>(packet_type), packet.getDataSize());
+			m_statistics.RecordDatagramSequence(sequence, m_udp_in_sequence);
+
+			//Late or duplicate datagrams carry stale state, drop them
+			if (Datagram::IsNewer(sequence, m_udp_in_sequence))
+			{
+				m_udp_in_sequence = sequence;
+				m_time_since_last_packet = sf::seconds(0.f);
+				if (packet_type == Server::PacketType::kUpdateClientState)
+				{
+					HandleSnapshot(reader);
+				}
+				else if (packet_type == Server::PacketType::kPong)
+				{
+					HandlePong(reader);
+				}
+			}
+		}
+		packet.clear();
+	}
+
+	if (receive_clock.getElapsedTime() >= m_receive_budget)
+	{
+		m_statistics.RecordReceiveBudgetHit();
+	}
+	return datagrams_received;
+}
+
+void MultiplayerGameState::SendDatagram(Client::PacketType packet_type, const BitWriter& payload)
+{
+	BitWriter datagram;
+	datagram.Write(m_udp_token, Datagram::kTokenBits);
+	datagram.Write(++m_udp_out_sequence, Datagram::kSequenceBits);
+	datagram.Write(static_cast<sf::Uint32>(packet_type), Client::kPacketTypeBits);
+	datagram.Append(payload);
+
+	sf::Packet packet;
+	datagram.AppendTo(packet);
+	m_udp_socket.send(packet, m_server_address, m_server_udp_port);
+	m_statistics.RecordOutgoing(static_cast<sf::Int32>(packet_type), packet.getDataSize());
+}
+
+void MultiplayerGameState::SendUnreliable(Client::PacketType packet_type, const BitWriter& payload)
+{
+	if (m_udp_confirmed)
+	{
+		SendDatagram(packet_type, payload);
+	}
+	else
+	{
+		//Until the server has answered over UDP the same payload goes on the TCP stream after the type
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(packet_type);
+		payload.AppendTo(packet);
+		m_statistics.RecordOutgoing(static_cast<sf::Int32>(packet_type), packet.getDataSize() + sizeof(sf::Uint32));
+		m_socket.send(packet);
+	}
+}
+
+void MultiplayerGameState::HandleSnapshot(BitReader& reader)
+{
+	//The client scrolls its own view, the server's battlefield position is skipped
+	reader.Read(PositionCodec::AxisY().GetBits());
+
+	//The last input command the server applied for each of our aircraft when it took this snapshot
+	std::vector<std::pair<sf::Int32, sf::Uint32>> input_acks;
+	sf::Uint32 ack_count = reader.ReadCompact();
+	for (sf::Uint32 i = 0; i < ack_count && reader.IsValid(); ++i)
+	{
+		sf::Int32 aircraft_identifier = static_cast<sf::Int32>(reader.ReadCompact());
+		sf::Uint32 sequence = reader.Read(32);
+		input_acks.emplace_back(aircraft_identifier, sequence);
+	}
+
+	sf::Uint32 tick;
+	sf::Uint32 baseline_tick;
+	if (!ReadSnapshotHeader(reader, tick, baseline_tick))
+	{
+		return;
+	}
+
+	//Ignore snapshots older than the one already applied
+	if (m_last_snapshot_tick != 0 && !Datagram::IsNewer(tick, m_last_snapshot_tick))
+	{
+		return;
+	}
+
+	//Without the baseline the delta cannot be applied, the server falls back to a full snapshot once the baseline ages out
+	SnapshotPtr baseline = m_snapshots.Find(baseline_tick);
+	if (baseline_tick != 0 && !baseline)
+	{
+		return;
+	}
+
+	std::shared_ptr<Snapshot> snapshot(new Snapshot());
+	snapshot->m_tick = tick;
+	std::vector<sf::Int32> written;
+	if (!ReadSnapshotDelta(reader, baseline.get(), *snapshot, &written))
+	{
+		return;
+	}
+	m_snapshots.Insert(snapshot);
+	m_last_snapshot_tick = tick;
+	if (HasServerTime())
+	{
+		m_interpolation_clock.OnSnapshot(tick, GetServerTime());
+	}
+
+	//Let the server use this snapshot as the next baseline
+	if (!m_replay)
+	{
+		BitWriter ack;
+		ack.Write(tick, 32);
+		SendUnreliable(Client::PacketType::kSnapshotAck, ack);
+	}
+
+	for (const auto& ack : input_acks)
+	{
+		auto predictor = m_predictors.find(ack.first);
+		auto state = snapshot->m_aircraft.find(ack.first);
+		if (predictor != m_predictors.end() && state != snapshot->m_aircraft.end())
+		{
+			predictor->second.Reconcile(ack.second, state->second.m_position, m_world.GetViewBounds());
+		}
+	}
+
+	for (const auto& state : snapshot->m_aircraft)
+	{
+		bool is_local_plane = std::find(m_local_player_identifiers.begin(), m_local_player_identifiers.end(), state.first) != m_local_player_identifiers.end();
+		if (is_local_plane)
+		{
+			continue;
+		}
+
+		//Under its bandwidth budget the server leaves out aircraft it had less reason to update, they stay where they were last seen
+		//Their state here is the baseline's, which may be older than a snapshot we already drew from
+		if (!std::binary_search(written.begin(), written.end(), state.first))
+		{
+			m_remote_states[state.first].Hold(m_interpolation_clock.GetServerTime(tick));
+			continue;
+		}
+
+		m_remote_states[state.first].Push(m_interpolation_clock.GetServerTime(tick), state.second.m_position);
+		//Aim is shown as it arrives, a late turn of the sprite is not worth buffering for
+		if (Aircraft* aircraft = m_world.GetAircraft(state.first))
+		{
+			aircraft->RotateSprite(InputCommand::DequantizeAim(state.second.m_aim));
+		}
+	}
+}
+
+void MultiplayerGameState::OnConnectionLost(const std::string& message)
+{
+	m_connected = false;
+	m_resuming = false;
+	m_failed_connection_text.setString(message);
+	Utility::CentreOrigin(m_failed_connection_text);
+	m_failed_connection_clock.restart();
+}
+
+void MultiplayerGameState::BeginResume()
+{
+	std::cout << "Lost the connection, trying to resume the session" << std::endl;
+	m_resuming = true;
+	m_resume_connecting = false;
+	m_resume_connected = false;
+	m_server_closed = false;
+	m_udp_offered = false;
+	m_udp_confirmed = false;
+	m_resume_clock.restart();
+	m_next_resume_attempt = sf::Time::Zero;
+	m_failed_connection_text.setString("Reconnecting...");
+	Utility::CentreOrigin(m_failed_connection_text);
+}
+
+void MultiplayerGameState::UpdateResume()
+{
+	sf::Time elapsed = m_resume_clock.getElapsedTime();
+	if (elapsed > sf::milliseconds(Session::kGracePeriodMilliseconds))
+	{
+		OnConnectionLost("Lost connection to the server");
+		return;
+	}
+
+	//The connect runs in the background so the frame never waits on it, it has gone through once the socket knows the server's address
+	if (m_resume_connecting && m_socket.getRemoteAddress() != sf::IpAddress::None)
+	{
+		sf::Packet packet;
+		packet << static_cast<sf::Int32>(Client::PacketType::kResumeSession) << m_session_token;
+		m_statistics.RecordOutgoing(static_cast<sf::Int32>(Client::PacketType::kResumeSession), packet.getDataSize() + sizeof(sf::Uint32));
+		m_socket.send(packet);
+		m_resume_connecting = false;
+		m_resume_connected = true;
+	}
+	else if (!m_resume_connected && elapsed >= m_next_resume_attempt)
+	{
+		m_next_resume_attempt = elapsed + kResumeRetryInterval;
+		m_socket.disconnect();
+		m_socket.setBlocking(false);
+		sf::Socket::Status status = m_socket.connect(m_server_address, SERVER_PORT);
+		m_resume_connecting = status == sf::Socket::Done || status == sf::Socket::NotReady;
+	}
+
+	//The answer is a kSession packet, whatever the server missed sending us follows it
+	if (m_resume_connected)
+	{
+		HandlePackets();
+		if (m_server_closed)
+		{
+			m_server_closed = false;
+			m_resume_connected = false;
+		}
+	}
+}
+
+void MultiplayerGameState::HandleInitialStateChunk(sf::Packet& packet)
+{
+	sf::Uint16 chunk_index;
+	packet >> chunk_index;
+	std::size_t header_size = sizeof(sf::Int32) + sizeof(sf::Uint16);
+
+	//The first chunk describes the world and how many aircraft are coming
+	if (chunk_index == 0)
+	{
+		float world_height, current_scroll;
+		sf::Int32 tick_interval;
+		sf::Int32 aircraft_count;
+		packet >> world_height >> current_scroll >> tick_interval >> aircraft_count;
+		header_size += 2 * sizeof(float) + 2 * sizeof(sf::Int32);
+
+		m_world.SetWorldHeight(world_height);
+		m_world.SetCurrentBattleFieldPosition(current_scroll);
+		m_interpolation_clock.SetTickInterval(sf::microseconds(tick_interval));
+
+		m_joining_aircraft.clear();
+		m_join_total = static_cast<std::size_t>(std::max(aircraft_count, 0));
+		m_join_built = 0;
+	}
+
+	BitReader reader(packet, header_size);
+	sf::Uint32 count = reader.ReadCompact();
+	sf::Int32 identifier = 0;
+	for (sf::Uint32 i = 0; i < count && reader.IsValid(); ++i)
+	{
+		JoiningAircraft aircraft;
+		identifier += static_cast<sf::Int32>(reader.ReadCompact());
+		aircraft.m_identifier = identifier;
+		aircraft.m_position = PositionCodec::Read(reader);
+		if (reader.IsValid())
+		{
+			m_joining_aircraft.emplace_back(aircraft);
+		}
+	}
+}
+
+void MultiplayerGameState::BuildJoiningAircraft(sf::Time budget)
+{
+	sf::Clock clock;
+	while (!m_joining_aircraft.empty())
+	{
+		JoiningAircraft joining = m_joining_aircraft.front();
+		m_joining_aircraft.pop_front();
+		++m_join_built;
+
+		//Anything that spawned through another message while this one waited is already there
+		if (!m_world.GetAircraft(joining.m_identifier))
+		{
+			Aircraft* aircraft = m_world.AddAircraft(joining.m_identifier);
+			aircraft->setPosition(joining.m_position);
+			m_players[joining.m_identifier].reset(new Player(&m_socket, joining.m_identifier, nullptr));
+		}
+
+		if (clock.getElapsedTime() >= budget)
+		{
+			break;
+		}
+	}
+
+	if (IsJoining())
+	{
+		m_join_text.setString("Joining match " + std::to_string(m_join_built * 100 / m_join_total) + "%");
+		Utility::CentreOrigin(m_join_text);
+	}
+}
+
+bool MultiplayerGameState::IsJoining() const
+{
+	return m_join_built < m_join_total;
+}
+
+void MultiplayerGameState::HandlePong(BitReader& reader)
+{
+	sf::Time sent_time = sf::microseconds(reader.ReadTime());
+	sf::Time server_time = sf::microseconds(reader.ReadTime());
+	if (reader.IsValid())
+	{
+		m_clock_sync.OnPong(sent_time, server_time, m_network_clock.getElapsedTime());
+	}
+}
+
+void MultiplayerGameState::PredictLocalAircraft(sf::Time dt)
+{
+	//Local movement is predicted here instead of going through the command queue, so it can be replayed when the server disagrees
+	for (auto itr = m_predictors.begin(); itr != m_predictors.end();)
+	{
+		Aircraft* aircraft = m_world.GetAircraft(itr->first);
+		if (!aircraft)
+		{
+			itr = m_predictors.erase(itr);
+			continue;
+		}
+
+		//Only handle the realtime input if the window has focus and the game is unpaused
+		sf::Uint8 buttons = 0;
+		auto player = m_players.find(itr->first);
+		if (m_active_state && m_has_focus && player != m_players.end())
+		{
+			buttons = player->second->GetInputButtons();
+		}
+
+		//The sprite already points where the player last aimed, it keeps doing so while the window is in the background
+		sf::Uint8 aim = InputCommand::QuantizeAim(aircraft->GetSprite().getRotation());
+		itr->second.Predict(buttons, aim, dt, m_world.GetViewBounds());
+		aircraft->setPosition(itr->second.GetPosition());
+		++itr;
+	}
+}
+
+void MultiplayerGameState::InterpolateRemoteAircraft()
+{
+	//Until the first pong there is no telling where the server's clock is, the aircraft stay where the world put them
+	if (!HasServerTime())
+	{
+		return;
+	}
+
+	sf::Time render_time = m_interpolation_clock.GetRenderTime(GetServerTime());
+	for (auto itr = m_remote_states.begin(); itr != m_remote_states.end();)
+	{
+		Aircraft* aircraft = m_world.GetAircraft(itr->first);
+		if (!aircraft)
+		{
+			itr = m_remote_states.erase(itr);
+			continue;
+		}
+
+		sf::Vector2f position;
+		if (itr->second.Sample(render_time, position))
+		{
+			aircraft->setPosition(position);
+		}
+		++itr;
+	}
+}
+
+void MultiplayerGameState::UpdateStatistics(sf::Time dt)
+{
+	m_statistics.Update(dt);
+	m_statistics.SetReceiveBacklog(m_backlog_depth);
+	m_statistics.SetInterpolation(m_interpolation_clock.GetDelay(), m_interpolation_clock.GetJitter());
+
+	std::size_t corrections = 0;
+	for (const auto& predictor : m_predictors)
+	{
+		corrections += predictor.second.GetCorrectionCount();
+	}
+	m_statistics.SetPredictionCorrections(corrections);
+
+	//How far the newest snapshot lags behind where the server's clock is now
+	if (m_clock_sync.IsSynchronised())
+	{
+		m_statistics.SetRoundTripTime(m_clock_sync.GetRoundTripTime());
+		if (m_last_snapshot_tick != 0)
+		{
+			m_statistics.SetSnapshotAge(GetServerTime() - m_interpolation_clock.GetServerTime(m_last_snapshot_tick));
+		}
+	}
+
+	if (m_show_statistics)
+	{
+		m_statistics_text.setString(m_statistics.ToString());
+	}
+}
+
 void MultiplayerGameState::HandlePacket(sf::Int32 packet_type, sf::Packet& packet)
 {
 	switch (static_cast<Server::PacketType>(packet_type))
@@ -383,11 +974,12 @@ void MultiplayerGameState::HandlePacket(sf::Int32 packet_type, sf::Packet& packe
 		case Server::PacketType::kSpawnSelf:
 		{
 			sf::Int32 aircraft_identifier;
-			sf::Vector2f aircraft_position;
-			packet >> aircraft_identifier >> aircraft_position.x >> aircraft_position.y;
+			packet >> aircraft_identifier;
+			sf::Vector2f aircraft_position = PositionCodec::Read(packet);
 			Aircraft* aircraft = m_world.AddAircraft(aircraft_identifier);
 			aircraft->setPosition(aircraft_position);
-			m_players[aircraft_identifier].reset(new Player(&m_socket, aircraft_identifier, GetContext().keys1));
+			m_predictors[aircraft_identifier].Reset(aircraft_position);
+			m_players[aircraft_identifier].reset(new Player(&m_socket, aircraft_identifier, GetContext().keys1, &m_statistics));
 			m_local_player_identifiers.push_back(aircraft_identifier);
 			m_game_started = true;
 		}
@@ -396,8 +988,8 @@ void MultiplayerGameState::HandlePacket(sf::Int32 packet_type, sf::Packet& packe
 		case Server::PacketType::kPlayerConnect:
 		{
 			sf::Int32 aircraft_identifier;
-			sf::Vector2f aircraft_position;
-			packet >> aircraft_identifier >> aircraft_position.x >> aircraft_position.y;
+			packet >> aircraft_identifier;
+			sf::Vector2f aircraft_position = PositionCodec::Read(packet);
 
 			Aircraft* aircraft = m_world.AddAircraft(aircraft_identifier);
 			aircraft->setPosition(aircraft_position);
@@ -411,33 +1003,23 @@ void MultiplayerGameState::HandlePacket(sf::Int32 packet_type, sf::Packet& packe
 			packet >> aircraft_identifier;
 			m_world.RemoveAircraft(aircraft_identifier);
 			m_players.erase(aircraft_identifier);
+
+			//It may not have been built yet
+			auto joining = std::find_if(m_joining_aircraft.begin(), m_joining_aircraft.end(), [aircraft_identifier](const JoiningAircraft& aircraft)
+			{
+				return aircraft.m_identifier == aircraft_identifier;
+			});
+			if (joining != m_joining_aircraft.end())
+			{
+				m_joining_aircraft.erase(joining);
+				--m_join_total;
+			}
 		}
 		break;
 
 		case Server::PacketType::kInitialState:
 		{
-			sf::Int32 aircraft_count;
-			float world_height, current_scroll;
-			packet >> world_height >> current_scroll;
-
-			m_world.SetWorldHeight(world_height);
-			m_world.SetCurrentBattleFieldPosition(current_scroll);
-
-			packet >> aircraft_count;
-			for (sf::Int32 i = 0; i < aircraft_count; ++i)
-			{
-				sf::Int32 aircraft_identifier;
-				sf::Int32 hitpoints;
-				sf::Int32 missile_ammo;
-				sf::Vector2f aircraft_position;
-				packet >> aircraft_identifier >> aircraft_position.x >> aircraft_position.y;
-
-				Aircraft* aircraft = m_world.AddAircraft(aircraft_identifier);
-				aircraft->setPosition(aircraft_position);
-				//TODO SET POINTS
-
-				m_players[aircraft_identifier].reset(new Player(&m_socket, aircraft_identifier, nullptr));
-			}
+			HandleInitialStateChunk(packet);
 		}
 		break;
 
@@ -445,9 +1027,12 @@ void MultiplayerGameState::HandlePacket(sf::Int32 packet_type, sf::Packet& packe
 		{
 			sf::Int32 aircraft_identifier;
 			packet >> aircraft_identifier;
+			sf::Vector2f aircraft_position = PositionCodec::Read(packet);
 
-			m_world.AddAircraft(aircraft_identifier);
-			m_players[aircraft_identifier].reset(new Player(&m_socket, aircraft_identifier, GetContext().keys2));
+			Aircraft* aircraft = m_world.AddAircraft(aircraft_identifier);
+			aircraft->setPosition(aircraft_position);
+			m_predictors[aircraft_identifier].Reset(aircraft_position);
+			m_players[aircraft_identifier].reset(new Player(&m_socket, aircraft_identifier, GetContext().keys2, &m_statistics));
 			m_local_player_identifiers.emplace_back(aircraft_identifier);
 		}
 		break;
@@ -467,45 +1052,243 @@ void MultiplayerGameState::HandlePacket(sf::Int32 packet_type, sf::Packet& packe
 		}
 		break;
 
-		//Player's movement or fire keyboard state changes
-		case Server::PacketType::kPlayerRealTimeChange:
+		//Our session token when we join, or the answer to resuming with it where 0 means our place is gone
+		case Server::PacketType::kSession:
 		{
-			sf::Int32 aircraft_identifier;
-			sf::Int32 action;
-			bool action_enabled;
-			packet >> aircraft_identifier >> action >> action_enabled;
+			sf::Uint64 session_token;
+			packet >> session_token;
+			if (!m_resuming)
+			{
+				m_session_token = session_token;
+			}
+			else if (session_token == 0)
+			{
+				OnConnectionLost("The match did not hold our place");
+			}
+			else
+			{
+				std::cout << "Resumed the session" << std::endl;
+				m_resuming = false;
+				m_resume_connected = false;
+				m_time_since_last_packet = sf::Time::Zero;
+			}
+		}
+		break;
 
-			auto itr = m_players.find(aircraft_identifier);
-			if (itr != m_players.end())
+		//The server offers the unreliable channel, answer over UDP so it learns our port
+		case Server::PacketType::kUdpHandshake:
+		{
+			packet >> m_udp_token >> m_server_udp_port;
+			if (m_udp_socket.bind(sf::Socket::AnyPort) == sf::Socket::Done)
 			{
-				itr->second->HandleNetworkRealtimeChange(static_cast<Action>(action), action_enabled);
+				m_udp_offered = true;
+				SendDatagram(Client::PacketType::kUdpHello, BitWriter());
+				m_udp_hello_clock.restart();
 			}
 		}
 		break;
 
+		//Snapshots arrive here only until the UDP channel is confirmed, the bit packed payload follows the type
 		case Server::PacketType::kUpdateClientState:
 		{
-			float current_world_position;
-			sf::Int32 aircraft_count;
-			packet >> current_world_position >> aircraft_count;
+			BitReader reader(packet, sizeof(sf::Int32));
+			HandleSnapshot(reader);
+		}
+		break;
 
-			float current_view_position = m_world.GetViewBounds().top + m_world.GetViewBounds().height;
+		case Server::PacketType::kPong:
+		{
+			BitReader reader(packet, sizeof(sf::Int32));
+			HandlePong(reader);
+		}
+		break;
 
-			for (sf::Int32 i = 0; i < aircraft_count; ++i)
+		//Several messages the server generated in the same step, handled in the order they were queued
+		case Server::PacketType::kBatch:
+		{
+			std::vector<sf::Packet> messages;
+			if (!MessageBatch::Split(packet, messages))
 			{
-				sf::Vector2f aircraft_position;
-				sf::Int32 aircraft_identifier;
-				packet >> aircraft_identifier >> aircraft_position.x >> aircraft_position.y;
+				std::cout << "Malformed batch, only the messages before the error are handled" << std::endl;
+			}
 
-				Aircraft* aircraft = m_world.GetAircraft(aircraft_identifier);
-				bool is_local_plane = std::find(m_local_player_identifiers.begin(), m_local_player_identifiers.end(), aircraft_identifier) != m_local_player_identifiers.end();
-				if (aircraft && !is_local_plane)
-				{
-					sf::Vector2f interpolated_position = aircraft->getPosition() + (aircraft_position - aircraft->getPosition()) * 0.1f;
-					aircraft->setPosition(interpolated_position);
-				}
+			//The batch header is its own size and type, each message also carries its size
+			m_statistics.RecordIncoming(packet_type, sizeof(sf::Uint32) + sizeof(sf::Int32));
+			for (sf::Packet& message : messages)
+			{
+				sf::Int32 message_type;
+				message >> message_type;
+				m_statistics.RecordIncoming(message_type, message.getDataSize() + sizeof(sf::Uint32));
+				HandlePacket(message_type, message);
 			}
 		}
 		break;
+
+		default:
+			break;
 	}
-}
\ No newline at end of file
+}
+
+bool MultiplayerGameState::HasServerTime() const
+{
+	return m_replay || m_clock_sync.IsSynchronised();
+}
+
+sf::Time MultiplayerGameState::GetServerTime() const
+{
+	return m_replay ? m_replay_time : m_clock_sync.GetServerTime(m_network_clock.getElapsedTime());
+}
+
+void MultiplayerGameState::UpdateReplay(sf::Time dt)
+{
+	if (!m_replay_paused && !m_replay_finished)
+	{
+		m_replay_time += dt;
+	}
+
+	//Everything the server had sent by now is handled before the world moves, as if it arrived during the frame
+	sf::Uint32 tick = static_cast<sf::Uint32>(m_replay_time.asMicroseconds() / m_replay->GetTickInterval().asMicroseconds());
+	ReplayReader::Record record;
+	while (m_replay->Peek(record) && !Datagram::IsNewer(record.m_tick, tick))
+	{
+		m_replay->Next(record);
+		ApplyReplayRecord(record);
+	}
+
+	if (!m_replay_paused)
+	{
+		m_world.Update(dt);
+		InterpolateRemoteAircraft();
+	}
+
+	for (auto itr = m_players.begin(); itr != m_players.end();)
+	{
+		if (!m_world.GetAircraft(itr->first))
+		{
+			itr = m_players.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+
+	UpdateBroadcastMessage(dt);
+	m_replay_frame_times.Record(m_replay_frame_clock.restart());
+
+	if (!m_replay_finished && !m_replay->Peek(record))
+	{
+		m_replay_finished = true;
+		if (m_replay_unthrottled)
+		{
+			//Benchmark runs close once the replay is over, so they can be scripted
+			sf::Time elapsed = m_replay_run_clock.getElapsedTime();
+			sf::Uint32 ticks = m_replay->GetLastTick() - m_replay->GetFirstTick();
+			std::cout << "Replay played " << ticks << " ticks in " << elapsed.asSeconds() << " s, " << ticks / std::max(elapsed.asSeconds(), 0.001f) << " ticks/s" << std::endl;
+			std::cout << "Frame time over " << m_replay_frame_times.GetCount() << " frames: " << m_replay_frame_times.ToString() << std::endl;
+			RequestStackClear();
+		}
+	}
+	UpdateReplayText();
+}
+
+void MultiplayerGameState::SeekReplay(sf::Time server_time)
+{
+	sf::Time first_time = m_interpolation_clock.GetServerTime(m_replay->GetFirstTick());
+	sf::Time last_time = m_interpolation_clock.GetServerTime(m_replay->GetLastTick());
+	server_time = std::max(first_time, std::min(server_time, last_time));
+	sf::Uint32 tick = static_cast<sf::Uint32>(server_time.asMicroseconds() / m_replay->GetTickInterval().asMicroseconds());
+
+	//The world is rebuilt from the keyframe before the target, then everything up to the target is applied in one go
+	m_replay->Seek(tick);
+	ResetReplayWorld();
+	m_replay_time = server_time;
+	m_replay_finished = false;
+
+	ReplayReader::Record record;
+	if (m_replay->Next(record))
+	{
+		sf::Packet packet;
+		packet.append(record.m_data, record.m_size);
+		sf::Int32 packet_type;
+		packet >> packet_type;
+		HandlePacket(packet_type, packet);
+	}
+
+	//Playback cannot wait for the keyframe to be built over several frames
+	while (!m_joining_aircraft.empty())
+	{
+		BuildJoiningAircraft(sf::Time::Zero);
+	}
+
+	while (m_replay->Peek(record) && !Datagram::IsNewer(record.m_tick, tick))
+	{
+		m_replay->Next(record);
+		ApplyReplayRecord(record);
+	}
+	InterpolateRemoteAircraft();
+	UpdateReplayText();
+}
+
+void MultiplayerGameState::ApplyReplayRecord(const ReplayReader::Record& record)
+{
+	switch (record.m_type)
+	{
+		//Only a seek starts from a keyframe, playing through one changes nothing
+		case Replay::RecordType::kKeyframe:
+			break;
+
+		case Replay::RecordType::kSnapshot:
+		{
+			BitReader reader(record.m_data, record.m_size);
+			HandleSnapshot(reader);
+		}
+		break;
+
+		case Replay::RecordType::kMessage:
+		{
+			sf::Packet packet;
+			packet.append(record.m_data, record.m_size);
+			sf::Int32 packet_type;
+			packet >> packet_type;
+			HandlePacket(packet_type, packet);
+		}
+		break;
+
+		default:
+			break;
+	}
+}
+
+void MultiplayerGameState::ResetReplayWorld()
+{
+	for (const auto& player : m_players)
+	{
+		m_world.RemoveAircraft(player.first);
+	}
+	m_players.clear();
+	m_remote_states.clear();
+	m_snapshots.Clear();
+	m_last_snapshot_tick = 0;
+	m_broadcasts.clear();
+	m_joining_aircraft.clear();
+	m_join_total = 0;
+	m_join_built = 0;
+	m_interpolation_clock = InterpolationClock(m_replay->GetTickInterval());
+}
+
+void MultiplayerGameState::UpdateReplayText()
+{
+	sf::Time first_time = m_interpolation_clock.GetServerTime(m_replay->GetFirstTick());
+	std::string text = "Replay " + FormatReplayTime(m_replay_time - first_time) + " / " + FormatReplayTime(m_interpolation_clock.GetServerTime(m_replay->GetLastTick()) - first_time);
+	if (m_replay_paused)
+	{
+		text += ", paused";
+	}
+	else if (m_replay_finished)
+	{
+		text += ", finished";
+	}
+	text += "\nSpace pauses, left and right seek";
+	m_statistics_text.setString(text);
+}
@@ -2,13 +2,26 @@
 #include "State.hpp"
 #include "World.hpp"
 #include "Player.hpp"
+#include "BitStream.hpp"
+#include "ClockSync.hpp"
 #include "GameServer.hpp"
+#include "Histogram.hpp"
+#include "InputPredictor.hpp"
+#include "Interpolation.hpp"
+#include "MessageBatch.hpp"
 #include "NetworkProtocol.hpp"
+#include "NetworkStatistics.hpp"
+#include "ReplayReader.hpp"
+#include "ReplaySettings.hpp"
+#include "Snapshot.hpp"
+
+#include <deque>
 
 class MultiplayerGameState : public State
 {
 public:
-	MultiplayerGameState(StateStack& stack, Context context, bool is_host);
+	//With a replay path set this plays the replay instead of connecting
+	MultiplayerGameState(StateStack& stack, Context context, bool is_host, const ReplaySettings& replay = ReplaySettings());
 	~MultiplayerGameState();
 	virtual void Draw();
 	virtual bool Update(sf::Time dt);
@@ -20,10 +33,43 @@ public:
 private:
 	void UpdateBroadcastMessage(sf::Time elpased_time);
 	void HandlePacket(sf::Int32 packet_type, sf::Packet& packet);
+	std::size_t HandlePackets();
+	std::size_t HandleDatagrams();
+	void HandleSnapshot(BitReader& reader);
+	void HandlePong(BitReader& reader);
+	void HandleInitialStateChunk(sf::Packet& packet);
+	//Builds queued aircraft until the budget is spent, at least one per call so a slow machine still gets there
+	void BuildJoiningAircraft(sf::Time budget);
+	bool IsJoining() const;
+	void PredictLocalAircraft(sf::Time dt);
+	void InterpolateRemoteAircraft();
+	void UpdateStatistics(sf::Time dt);
+	void SendDatagram(Client::PacketType packet_type, const BitWriter& payload);
+	void SendUnreliable(Client::PacketType packet_type, const BitWriter& payload);
+	//Starts over from the menu once the failed connection message has been shown
+	void OnConnectionLost(const std::string& message);
+	void BeginResume();
+	//Reconnects and asks for our session back until the server answers or the grace period is over
+	void UpdateResume();
+	//The server's clock as ClockSync estimates it, or the playback position when playing a replay
+	bool HasServerTime() const;
+	sf::Time GetServerTime() const;
+
+	void UpdateReplay(sf::Time dt);
+	void SeekReplay(sf::Time server_time);
+	void ApplyReplayRecord(const ReplayReader::Record& record);
+	void ResetReplayWorld();
+	void UpdateReplayText();
 
 private:
 	typedef std::unique_ptr<Player> PlayerPtr;
 
+	struct JoiningAircraft
+	{
+		sf::Int32 m_identifier;
+		sf::Vector2f m_position;
+	};
+
 private:
 	World m_world;
 	sf::RenderWindow& m_window;
@@ -33,6 +79,33 @@ private:
 	std::vector<sf::Int32> m_local_player_identifiers;
 	sf::TcpSocket m_socket;
 	bool m_connected;
+
+	//Unreliable channel for snapshots and position updates, negotiated after connecting
+	sf::UdpSocket m_udp_socket;
+	sf::IpAddress m_server_address;
+	unsigned short m_server_udp_port;
+	sf::Uint32 m_udp_token;
+	bool m_udp_offered;
+	bool m_udp_confirmed;
+	sf::Uint16 m_udp_out_sequence;
+	sf::Uint16 m_udp_in_sequence;
+	sf::Clock m_udp_hello_clock;
+
+	//Reconstructed snapshots, the server encodes deltas against the ones we acknowledge
+	SnapshotBuffer m_snapshots;
+	sf::Uint32 m_last_snapshot_tick;
+
+	//Local aircraft are moved by prediction and corrected by the server
+	std::map<sf::Int32, InputPredictor> m_predictors;
+
+	//Remote aircraft are drawn a little in the past, between two states the server actually sent
+	std::map<sf::Int32, InterpolationBuffer> m_remote_states;
+	InterpolationClock m_interpolation_clock;
+	sf::Clock m_network_clock;
+
+	//Pings keep the connection alive while the player is idle and measure the round trip and the server's clock
+	ClockSync m_clock_sync;
+	sf::Clock m_ping_clock;
 	std::unique_ptr<GameServer> m_game_server;
 	sf::Clock m_tick_clock;
 
@@ -52,4 +125,42 @@ private:
 	bool m_game_started;
 	sf::Time m_client_timeout;
 	sf::Time m_time_since_last_packet;
+	bool m_server_closed;
+
+	//Handed out by the server when we join, a dropped connection is resumed with it and the world is kept as it is
+	sf::Uint64 m_session_token;
+	bool m_resuming;
+	bool m_resume_connecting;
+	bool m_resume_connected;
+	sf::Clock m_resume_clock;
+	sf::Time m_next_resume_attempt;
+
+	//Each channel handles packets until it has spent this much of the frame, whatever is left waits for the next frame
+	//A flood of reliable messages cannot hold up snapshots, nor the other way round
+	sf::Time m_receive_budget;
+	std::size_t m_backlog_depth;
+	std::size_t m_max_backlog_depth;
+
+	//The initial state arrives in chunks and its aircraft are built a few each frame, so joining a busy match does not stall
+	std::deque<JoiningAircraft> m_joining_aircraft;
+	std::size_t m_join_total;
+	std::size_t m_join_built;
+	sf::Time m_join_budget;
+	sf::Text m_join_text;
+
+	//Traffic and connection figures, F3 toggles the overlay
+	NetworkStatistics m_statistics;
+	bool m_show_statistics;
+	sf::Text m_statistics_text;
+
+	//Playback stands in for the server, records are handled as the server time they were sent at comes round
+	std::unique_ptr<ReplayReader> m_replay;
+	sf::Time m_replay_time;
+	bool m_replay_paused;
+	bool m_replay_finished;
+	bool m_replay_unthrottled;
+	//Unthrottled playback is a benchmark, frame times are reported when it ends
+	Histogram m_replay_frame_times;
+	sf::Clock m_replay_frame_clock;
+	sf::Clock m_replay_run_clock;
 };
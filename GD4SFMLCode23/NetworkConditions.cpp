@@ -0,0 +1,169 @@
+#include "NetworkConditions.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	bool ApplyLinkSetting(const std::string& key, float value, LinkConditions& link)
+	{
+		if (key == "latency")
+		{
+			link.m_latency = sf::milliseconds(static_cast<sf::Int32>(value));
+		}
+		else if (key == "jitter")
+		{
+			link.m_jitter = sf::milliseconds(static_cast<sf::Int32>(value));
+		}
+		else if (key == "loss")
+		{
+			link.m_loss = value / 100.f;
+		}
+		else if (key == "reorder")
+		{
+			link.m_reorder = value / 100.f;
+		}
+		else if (key == "bandwidth")
+		{
+			link.m_bandwidth = static_cast<std::size_t>(value * 1000.f);
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	void WriteLink(std::ostringstream& stream, const LinkConditions& link)
+	{
+		stream << link.m_latency.asMilliseconds() << " ms +" << link.m_jitter.asMilliseconds() << " ms, " << link.m_loss * 100.f << "% loss, " << link.m_reorder * 100.f << "% reorder, ";
+		if (link.m_bandwidth > 0)
+		{
+			stream << link.m_bandwidth / 1000 << " kbit/s";
+		}
+		else
+		{
+			stream << "no bandwidth cap";
+		}
+	}
+}
+
+ConditionScript::ConditionScript()
+	: m_next_step(0)
+	, m_ended(false)
+{
+}
+
+bool ConditionScript::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	m_steps.clear();
+	std::string line;
+	std::size_t line_number = 0;
+	while (std::getline(file, line))
+	{
+		++line_number;
+		std::istringstream words(line.substr(0, line.find('#')));
+		float seconds;
+		if (!(words >> seconds))
+		{
+			continue;
+		}
+
+		Step step;
+		step.m_time = sf::seconds(seconds);
+		step.m_end = false;
+		std::string word;
+		while (words >> word)
+		{
+			std::size_t equals = word.find('=');
+			if (word == "end")
+			{
+				step.m_end = true;
+			}
+			else if (equals != std::string::npos)
+			{
+				step.m_settings.emplace_back(word.substr(0, equals), word.substr(equals + 1));
+			}
+			else
+			{
+				std::cout << path << ":" << line_number << ": expected key=value or end, got " << word << std::endl;
+				return false;
+			}
+		}
+
+		//Check the settings now rather than part way through a run
+		NetworkConditions scratch;
+		for (const auto& setting : step.m_settings)
+		{
+			if (!ApplySetting(setting.first, setting.second, scratch))
+			{
+				std::cout << path << ":" << line_number << ": unknown setting " << setting.first << "=" << setting.second << std::endl;
+				return false;
+			}
+		}
+		m_steps.emplace_back(step);
+	}
+
+	m_next_step = 0;
+	m_ended = false;
+	return true;
+}
+
+bool ConditionScript::Update(sf::Time elapsed, NetworkConditions& conditions)
+{
+	bool changed = false;
+	while (!m_ended && m_next_step < m_steps.size() && m_steps[m_next_step].m_time <= elapsed)
+	{
+		const Step& step = m_steps[m_next_step++];
+		for (const auto& setting : step.m_settings)
+		{
+			ApplySetting(setting.first, setting.second, conditions);
+		}
+		m_ended = step.m_end;
+		changed = true;
+		std::cout << "At " << step.m_time.asSeconds() << " s: " << ToString(conditions) << std::endl;
+	}
+	return changed;
+}
+
+bool ConditionScript::HasEnded() const
+{
+	return m_ended;
+}
+
+bool ConditionScript::ApplySetting(const std::string& key, const std::string& value, NetworkConditions& conditions)
+{
+	float number;
+	std::istringstream stream(value);
+	if (!(stream >> number) || number < 0.f)
+	{
+		return false;
+	}
+
+	if (key.compare(0, 3, "up.") == 0)
+	{
+		return ApplyLinkSetting(key.substr(3), number, conditions.m_upstream);
+	}
+	if (key.compare(0, 5, "down.") == 0)
+	{
+		return ApplyLinkSetting(key.substr(5), number, conditions.m_downstream);
+	}
+	return ApplyLinkSetting(key, number, conditions.m_upstream) && ApplyLinkSetting(key, number, conditions.m_downstream);
+}
+
+std::string ConditionScript::ToString(const NetworkConditions& conditions)
+{
+	std::ostringstream stream;
+	stream << "up ";
+	WriteLink(stream, conditions.m_upstream);
+	stream << ", down ";
+	WriteLink(stream, conditions.m_downstream);
+	return stream.str();
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+//How one direction of a simulated link treats the packets passing through it
+struct LinkConditions
+{
+	sf::Time m_latency = sf::Time::Zero;
+	//Each packet is held up by a further random amount up to this
+	sf::Time m_jitter = sf::Time::Zero;
+	//Chances from 0 to 1, lost stream data is held up by a retransmission instead of disappearing
+	float m_loss = 0.f;
+	float m_reorder = 0.f;
+	//Bits per second, 0 for no cap
+	std::size_t m_bandwidth = 0;
+};
+
+//Upstream is client to server
+struct NetworkConditions
+{
+	LinkConditions m_upstream;
+	LinkConditions m_downstream;
+};
+
+//Timed changes to the conditions, read from a file so the same run can be repeated
+//Each line is a time in seconds and the settings that change then, "15 latency=120 down.loss=5" or "60 end"
+//Settings are latency and jitter in ms, loss and reorder in percent and bandwidth in kbit/s, an up. or down. prefix limits one to that direction
+class ConditionScript
+{
+public:
+	ConditionScript();
+	bool Load(const std::string& path);
+	//Applies every step that is due by elapsed, true if the conditions changed
+	bool Update(sf::Time elapsed, NetworkConditions& conditions);
+	bool HasEnded() const;
+
+	//Also used for the same settings given on the command line
+	static bool ApplySetting(const std::string& key, const std::string& value, NetworkConditions& conditions);
+	static std::string ToString(const NetworkConditions& conditions);
+
+private:
+	struct Step
+	{
+		sf::Time m_time;
+		std::vector<std::pair<std::string, std::string>> m_settings;
+		bool m_end;
+	};
+
+private:
+	std::vector<Step> m_steps;
+	std::size_t m_next_step;
+	bool m_ended;
+};
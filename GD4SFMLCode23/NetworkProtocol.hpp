@@ -1,5 +1,44 @@
 #pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System/Vector2.hpp>
 const unsigned short SERVER_PORT = 50000;
+//Positions sent over the network are rounded to this many world units
+const float POSITION_PRECISION = 1.f / 8.f;
+
+//Datagrams are bit packed: the client's start with its 32 bit token, both directions then carry a 16 bit sequence number and the packet type
+//When a bit packed message falls back to TCP it is sent as an Int32 type followed by the same payload bytes
+namespace Datagram
+{
+	const unsigned int kTokenBits = 32;
+	const unsigned int kSequenceBits = 16;
+	//Aircraft identifiers are sent as wide as the largest one in the message, the width itself takes this many bits
+	const unsigned int kIdentifierWidthBits = 5;
+
+	//True if a was sent after b, allowing the counter to wrap
+	inline bool IsNewer(sf::Uint32 a, sf::Uint32 b)
+	{
+		return static_cast<sf::Int32>(a - b) > 0;
+	}
+
+	inline bool IsNewer(sf::Uint16 a, sf::Uint16 b)
+	{
+		return static_cast<sf::Int16>(a - b) > 0;
+	}
+}
+
+//Clients ping at this rate whether or not the player is doing anything, the server answers with its own clock
+namespace Heartbeat
+{
+	const sf::Int32 kPingIntervalMilliseconds = 250;
+}
+
+//A player whose connection drops keeps their aircraft this long, reconnecting with the session token picks up where they left off
+//Tokens are 64 bits, the room's number sits in the top 16 so a MatchHost knows which room to hand the connection to
+namespace Session
+{
+	const sf::Int32 kGracePeriodMilliseconds = 15000;
+	const unsigned int kRoomShift = 48;
+}
 
 namespace Server
 {
@@ -9,7 +48,6 @@ namespace Server
 		kBroadcastMessage,
 		kInitialState,
 		kPlayerEvent,
-		kPlayerRealTimeChange,
 		kPlayerConnect,
 		kPlayerDisconnect,
 		kAcceptCoopPartner,
@@ -17,8 +55,17 @@ namespace Server
 		kSpawnPickup,
 		kSpawnSelf,
 		kUpdateClientState,
-		kMissionSuccess
+		kMissionSuccess,
+		kUdpHandshake,
+		kBatch,
+		kPong,
+		kSession,
+		kPacketTypeCount
 	};
+
+	//Width of the type field in a datagram
+	const unsigned int kPacketTypeBits = 4;
+	static_assert(static_cast<unsigned int>(PacketType::kPacketTypeCount) <= (1u << kPacketTypeBits), "Server packet types no longer fit in a datagram");
 }
 
 namespace Client
@@ -27,12 +74,25 @@ namespace Client
 	enum class PacketType
 	{
 		kPlayerEvent,
-		kPlayerRealTimeChange,
 		kRequestCoopPartner,
-		kPositionUpdate,
+		kInput,
 		kGameEvent,
-		kQuit
+		kQuit,
+		kUdpHello,
+		kSnapshotAck,
+		kPing,
+		kJoinRoom,
+		kResumeSession,
+		kPacketTypeCount
 	};
+
+	//Width of the type field in a datagram
+	const unsigned int kPacketTypeBits = 4;
+	static_assert(static_cast<unsigned int>(PacketType::kPacketTypeCount) <= (1u << kPacketTypeBits), "Client packet types no longer fit in a datagram");
+
+	//The first thing a client sends is kJoinRoom with a room number, or this to be put in any room with space
+	//A client that lost its connection sends kResumeSession with its session token instead, the server answers with kSession
+	const sf::Int32 kAnyRoom = -1;
 }
 
 namespace GameActions
@@ -0,0 +1,441 @@
+#include "NetworkProxy.hpp"
+#include "NetworkProtocol.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const std::size_t kListenerKey = static_cast<std::size_t>(-1);
+	const std::size_t kUdpKey = static_cast<std::size_t>(-2);
+	//Each connection has three sockets, their poller keys are the slot times this plus one of these
+	const std::size_t kSocketsPerConnection = 3;
+	const std::size_t kClientSocket = 0;
+	const std::size_t kServerSocket = 1;
+	const std::size_t kUdpSocket = 2;
+
+	const sf::Time kConnectTimeout = sf::seconds(2.f);
+	const std::size_t kReadSize = 16 * 1024;
+
+	//sf::Packet frames and message headers are in network byte order
+	sf::Uint32 ReadUint32(const char* data)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		return (static_cast<sf::Uint32>(bytes[0]) << 24) | (static_cast<sf::Uint32>(bytes[1]) << 16) | (static_cast<sf::Uint32>(bytes[2]) << 8) | bytes[3];
+	}
+
+	SimulatedLink::Packet CopyPacket(const char* data, std::size_t size)
+	{
+		return SimulatedLink::Packet(new std::vector<char>(data, data + size));
+	}
+}
+
+NetworkProxy::Connection::Connection()
+	: m_slot(0)
+	, m_client_udp_port(0)
+	, m_server_udp_port(0)
+	, m_udp_token(0)
+	, m_stream_up(true)
+	, m_stream_down(true)
+	, m_datagram_up(false)
+	, m_datagram_down(false)
+	, m_client_closed(false)
+	, m_server_closed(false)
+{
+}
+
+NetworkProxy::NetworkProxy(unsigned short port, const sf::IpAddress& server_address, unsigned short server_port, unsigned int seed)
+	: m_listening(false)
+	, m_server_address(server_address)
+	, m_server_port(server_port)
+	, m_random(seed)
+{
+	m_listener.setBlocking(false);
+	m_udp_socket.setBlocking(false);
+	m_listening = m_listener.listen(port) == sf::Socket::Done && m_udp_socket.bind(sf::Socket::AnyPort) == sf::Socket::Done;
+	if (m_listening)
+	{
+		m_poller.Add(m_listener, kListenerKey);
+		m_poller.Add(m_udp_socket, kUdpKey);
+	}
+}
+
+bool NetworkProxy::IsListening() const
+{
+	return m_listening;
+}
+
+void NetworkProxy::SetConditions(const NetworkConditions& conditions)
+{
+	m_conditions = conditions;
+	for (Connection* connection : m_connections)
+	{
+		connection->m_stream_up.SetConditions(conditions.m_upstream);
+		connection->m_datagram_up.SetConditions(conditions.m_upstream);
+		connection->m_stream_down.SetConditions(conditions.m_downstream);
+		connection->m_datagram_down.SetConditions(conditions.m_downstream);
+	}
+}
+
+void NetworkProxy::Update(sf::Time max_wait)
+{
+	//Sleep no later than the next arrival, packets are handed over on time rather than on the next wake up
+	sf::Time now = Now();
+	sf::Time wait = max_wait;
+	for (const Connection* connection : m_connections)
+	{
+		for (const SimulatedLink* link : { &connection->m_stream_up, &connection->m_stream_down, &connection->m_datagram_up, &connection->m_datagram_down })
+		{
+			if (!link->IsEmpty())
+			{
+				wait = std::min(wait, std::max(link->GetNextArrival() - now, sf::Time::Zero));
+			}
+		}
+	}
+	m_poller.Wait(wait);
+
+	now = Now();
+	for (std::size_t key : m_poller.GetReady())
+	{
+		if (key == kListenerKey)
+		{
+			AcceptConnections();
+			continue;
+		}
+		if (key == kUdpKey)
+		{
+			ReadClientDatagrams(now);
+			continue;
+		}
+
+		Connection* connection = m_connections.Get(key / kSocketsPerConnection);
+		if (!connection)
+		{
+			continue;
+		}
+		switch (key % kSocketsPerConnection)
+		{
+		case kClientSocket:
+			ReadClient(*connection, now);
+			break;
+		case kServerSocket:
+			ReadServer(*connection, now);
+			break;
+		case kUdpSocket:
+			ReadServerDatagrams(*connection, now);
+			break;
+		}
+	}
+
+	//Collected first, closing a connection moves another one into its place in the table
+	std::vector<std::size_t> finished_slots;
+	for (Connection* connection : m_connections)
+	{
+		if (!Deliver(*connection, now))
+		{
+			finished_slots.emplace_back(connection->m_slot);
+		}
+	}
+	for (std::size_t slot : finished_slots)
+	{
+		CloseConnection(slot);
+	}
+}
+
+std::size_t NetworkProxy::GetConnectionCount() const
+{
+	return m_connections.GetSize();
+}
+
+std::string NetworkProxy::GetReport() const
+{
+	Totals upstream = m_closed_upstream;
+	Totals downstream = m_closed_downstream;
+	for (const Connection* connection : m_connections)
+	{
+		AddTotals(*connection, upstream, downstream);
+	}
+
+	std::ostringstream report;
+	report << m_connections.GetSize() << " connections, up " << upstream.m_delivered << " packets " << upstream.m_bytes / 1024 << " KB " << upstream.m_dropped << " dropped, down " << downstream.m_delivered << " packets " << downstream.m_bytes / 1024 << " KB " << downstream.m_dropped << " dropped";
+	return report.str();
+}
+
+sf::Time NetworkProxy::Now() const
+{
+	return m_clock.getElapsedTime();
+}
+
+void NetworkProxy::AcceptConnections()
+{
+	while (true)
+	{
+		ConnectionPtr connection(new Connection());
+		if (m_listener.accept(connection->m_client) != sf::Socket::Done)
+		{
+			return;
+		}
+
+		//The server is on the same machine, so connecting is quick enough to do here
+		if (connection->m_server.connect(m_server_address, m_server_port, kConnectTimeout) != sf::Socket::Done || connection->m_udp.bind(sf::Socket::AnyPort) != sf::Socket::Done)
+		{
+			std::cout << "Could not reach the server at " << m_server_address << ":" << m_server_port << std::endl;
+			continue;
+		}
+		connection->m_client.setBlocking(false);
+		connection->m_server.setBlocking(false);
+		connection->m_udp.setBlocking(false);
+		connection->m_client_address = connection->m_client.getRemoteAddress();
+		connection->m_stream_up.SetConditions(m_conditions.m_upstream);
+		connection->m_datagram_up.SetConditions(m_conditions.m_upstream);
+		connection->m_stream_down.SetConditions(m_conditions.m_downstream);
+		connection->m_datagram_down.SetConditions(m_conditions.m_downstream);
+
+		Connection& added = *connection;
+		added.m_slot = m_connections.Add(std::move(connection));
+		m_poller.Add(added.m_client, added.m_slot * kSocketsPerConnection + kClientSocket);
+		m_poller.Add(added.m_server, added.m_slot * kSocketsPerConnection + kServerSocket);
+		m_poller.Add(added.m_udp, added.m_slot * kSocketsPerConnection + kUdpSocket);
+		std::cout << "Client " << added.m_client_address << " connected, " << m_connections.GetSize() << " connections" << std::endl;
+	}
+}
+
+void NetworkProxy::ReadClient(Connection& connection, sf::Time now)
+{
+	char buffer[kReadSize];
+	std::size_t received;
+	sf::Socket::Status status = sf::Socket::NotReady;
+	while (!connection.m_client_closed && (status = connection.m_client.receive(buffer, sizeof(buffer), received)) == sf::Socket::Done)
+	{
+		connection.m_stream_up.Push(CopyPacket(buffer, received), now, m_random);
+	}
+	if (!connection.m_client_closed && (status == sf::Socket::Disconnected || status == sf::Socket::Error))
+	{
+		m_poller.Remove(connection.m_client);
+		connection.m_client_closed = true;
+	}
+}
+
+void NetworkProxy::ReadServer(Connection& connection, sf::Time now)
+{
+	char buffer[kReadSize];
+	std::size_t received;
+	sf::Socket::Status status = sf::Socket::NotReady;
+	while (!connection.m_server_closed && (status = connection.m_server.receive(buffer, sizeof(buffer), received)) == sf::Socket::Done)
+	{
+		connection.m_downstream_bytes.insert(connection.m_downstream_bytes.end(), buffer, buffer + received);
+	}
+	if (!connection.m_server_closed && (status == sf::Socket::Disconnected || status == sf::Socket::Error))
+	{
+		m_poller.Remove(connection.m_server);
+		connection.m_server_closed = true;
+	}
+
+	//Only whole packets go on, each is its size followed by that many bytes
+	std::vector<char>& bytes = connection.m_downstream_bytes;
+	std::size_t offset = 0;
+	while (bytes.size() - offset >= sizeof(sf::Uint32))
+	{
+		std::size_t size = sizeof(sf::Uint32) + ReadUint32(bytes.data() + offset);
+		if (bytes.size() - offset < size)
+		{
+			break;
+		}
+
+		std::vector<char>* packet = new std::vector<char>(bytes.begin() + offset, bytes.begin() + offset + size);
+		SimulatedLink::Packet shared(packet);
+		RewriteHandshakes(connection, *packet);
+		connection.m_stream_down.Push(shared, now, m_random);
+		offset += size;
+	}
+	bytes.erase(bytes.begin(), bytes.begin() + offset);
+}
+
+void NetworkProxy::ReadClientDatagrams(sf::Time now)
+{
+	char buffer[sf::UdpSocket::MaxDatagramSize];
+	std::size_t received;
+	sf::IpAddress sender;
+	unsigned short sender_port;
+	while (m_udp_socket.receive(buffer, sizeof(buffer), received, sender, sender_port) == sf::Socket::Done)
+	{
+		//Client datagrams start with the token the server handed out, which is how the proxy knows whose they are
+		if (received < sizeof(sf::Uint32))
+		{
+			continue;
+		}
+		auto itr = m_slots_by_token.find(ReadUint32(buffer));
+		Connection* connection = itr != m_slots_by_token.end() ? m_connections.Get(itr->second) : nullptr;
+		if (!connection)
+		{
+			continue;
+		}
+
+		connection->m_client_address = sender;
+		connection->m_client_udp_port = sender_port;
+		connection->m_datagram_up.Push(CopyPacket(buffer, received), now, m_random);
+	}
+}
+
+void NetworkProxy::ReadServerDatagrams(Connection& connection, sf::Time now)
+{
+	char buffer[sf::UdpSocket::MaxDatagramSize];
+	std::size_t received;
+	sf::IpAddress sender;
+	unsigned short sender_port;
+	while (connection.m_udp.receive(buffer, sizeof(buffer), received, sender, sender_port) == sf::Socket::Done)
+	{
+		if (sender == m_server_address)
+		{
+			connection.m_datagram_down.Push(CopyPacket(buffer, received), now, m_random);
+		}
+	}
+}
+
+void NetworkProxy::RewriteHandshakes(Connection& connection, std::vector<char>& packet)
+{
+	char* data = packet.data() + sizeof(sf::Uint32);
+	std::size_t size = packet.size() - sizeof(sf::Uint32);
+	if (size < sizeof(sf::Int32))
+	{
+		return;
+	}
+
+	sf::Int32 packet_type = static_cast<sf::Int32>(ReadUint32(data));
+	if (packet_type == static_cast<sf::Int32>(Server::PacketType::kUdpHandshake))
+	{
+		RewriteHandshake(connection, data, size);
+	}
+	else if (packet_type == static_cast<sf::Int32>(Server::PacketType::kBatch))
+	{
+		//The handshake usually goes out in a batch with the spawn messages
+		std::size_t offset = sizeof(sf::Int32);
+		while (size - offset >= sizeof(sf::Uint32))
+		{
+			std::size_t message_size = ReadUint32(data + offset);
+			offset += sizeof(sf::Uint32);
+			if (size - offset < message_size)
+			{
+				break;
+			}
+			if (message_size >= sizeof(sf::Int32) && static_cast<sf::Int32>(ReadUint32(data + offset)) == static_cast<sf::Int32>(Server::PacketType::kUdpHandshake))
+			{
+				RewriteHandshake(connection, data + offset, message_size);
+			}
+			offset += message_size;
+		}
+	}
+}
+
+void NetworkProxy::RewriteHandshake(Connection& connection, char* message, std::size_t size)
+{
+	//The type, the token and the server's UDP port, which becomes the proxy's so the client sends its datagrams here
+	if (size < sizeof(sf::Int32) + sizeof(sf::Uint32) + sizeof(sf::Uint16))
+	{
+		return;
+	}
+
+	char* port = message + sizeof(sf::Int32) + sizeof(sf::Uint32);
+	connection.m_udp_token = ReadUint32(message + sizeof(sf::Int32));
+	connection.m_server_udp_port = static_cast<unsigned short>((static_cast<unsigned char>(port[0]) << 8) | static_cast<unsigned char>(port[1]));
+	m_slots_by_token[connection.m_udp_token] = connection.m_slot;
+
+	unsigned short proxy_port = m_udp_socket.getLocalPort();
+	port[0] = static_cast<char>(proxy_port >> 8);
+	port[1] = static_cast<char>(proxy_port);
+}
+
+bool NetworkProxy::Deliver(Connection& connection, sf::Time now)
+{
+	std::vector<SimulatedLink::Packet> ready;
+	connection.m_stream_up.Pop(now, ready);
+	for (const SimulatedLink::Packet& packet : ready)
+	{
+		connection.m_server_queue.Push(packet);
+	}
+
+	ready.clear();
+	connection.m_stream_down.Pop(now, ready);
+	for (const SimulatedLink::Packet& packet : ready)
+	{
+		connection.m_client_queue.Push(packet);
+	}
+
+	ready.clear();
+	connection.m_datagram_up.Pop(now, ready);
+	for (const SimulatedLink::Packet& packet : ready)
+	{
+		if (connection.m_server_udp_port != 0)
+		{
+			connection.m_udp.send(packet->data(), packet->size(), m_server_address, connection.m_server_udp_port);
+		}
+	}
+
+	ready.clear();
+	connection.m_datagram_down.Pop(now, ready);
+	for (const SimulatedLink::Packet& packet : ready)
+	{
+		if (connection.m_client_udp_port != 0)
+		{
+			m_udp_socket.send(packet->data(), packet->size(), connection.m_client_address, connection.m_client_udp_port);
+		}
+	}
+
+	if (!connection.m_server_closed && !connection.m_server_queue.IsEmpty())
+	{
+		sf::Socket::Status status = connection.m_server_queue.Flush(connection.m_server);
+		if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+		{
+			m_poller.Remove(connection.m_server);
+			connection.m_server_closed = true;
+		}
+	}
+	if (!connection.m_client_closed && !connection.m_client_queue.IsEmpty())
+	{
+		sf::Socket::Status status = connection.m_client_queue.Flush(connection.m_client);
+		if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+		{
+			m_poller.Remove(connection.m_client);
+			connection.m_client_closed = true;
+		}
+	}
+
+	//Once a side has hung up the connection lasts until what it sent has reached the other side
+	bool client_done = connection.m_client_closed && (connection.m_server_closed || (connection.m_stream_up.IsEmpty() && connection.m_server_queue.IsEmpty()));
+	bool server_done = connection.m_server_closed && (connection.m_client_closed || (connection.m_stream_down.IsEmpty() && connection.m_client_queue.IsEmpty()));
+	return !client_done && !server_done;
+}
+
+void NetworkProxy::CloseConnection(std::size_t slot)
+{
+	ConnectionPtr connection = m_connections.Remove(slot);
+	if (!connection->m_client_closed)
+	{
+		m_poller.Remove(connection->m_client);
+	}
+	if (!connection->m_server_closed)
+	{
+		m_poller.Remove(connection->m_server);
+	}
+	m_poller.Remove(connection->m_udp);
+	m_slots_by_token.erase(connection->m_udp_token);
+	AddTotals(*connection, m_closed_upstream, m_closed_downstream);
+	std::cout << "Client " << connection->m_client_address << " disconnected, " << m_connections.GetSize() << " connections" << std::endl;
+}
+
+void NetworkProxy::AddTotals(const Connection& connection, Totals& upstream, Totals& downstream) const
+{
+	for (const SimulatedLink* link : { &connection.m_stream_up, &connection.m_datagram_up })
+	{
+		upstream.m_delivered += link->GetDeliveredCount();
+		upstream.m_dropped += link->GetDroppedCount();
+		upstream.m_bytes += link->GetDeliveredBytes();
+	}
+	for (const SimulatedLink* link : { &connection.m_stream_down, &connection.m_datagram_down })
+	{
+		downstream.m_delivered += link->GetDeliveredCount();
+		downstream.m_dropped += link->GetDroppedCount();
+		downstream.m_bytes += link->GetDeliveredBytes();
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/TcpListener.hpp>
+#include <SFML/Network/TcpSocket.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <SFML/System/Clock.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "NetworkConditions.hpp"
+#include "OutboundQueue.hpp"
+#include "SimulatedLink.hpp"
+#include "SlotTable.hpp"
+#include "SocketPoller.hpp"
+
+//Sits between clients and a GameServer and passes their traffic through SimulatedLinks
+//Clients connect to it as if it were the server, the UDP handshake is rewritten on the way through so datagrams come through it too
+class NetworkProxy
+{
+public:
+	//The same seed and script give the same losses and delays for the same traffic
+	NetworkProxy(unsigned short port, const sf::IpAddress& server_address, unsigned short server_port, unsigned int seed);
+	bool IsListening() const;
+	void SetConditions(const NetworkConditions& conditions);
+
+	//Waits up to max_wait for traffic or the next packet to arrive, then forwards whatever is due
+	void Update(sf::Time max_wait);
+	std::size_t GetConnectionCount() const;
+	//Packets, bytes and drops in each direction since the proxy started
+	std::string GetReport() const;
+
+private:
+	struct Connection
+	{
+		Connection();
+		std::size_t m_slot;
+		Pollable<sf::TcpSocket> m_client;
+		Pollable<sf::TcpSocket> m_server;
+		//Talks to the server's UDP socket for this client, so the server still sees one sender per client
+		Pollable<sf::UdpSocket> m_udp;
+		sf::IpAddress m_client_address;
+		unsigned short m_client_udp_port;
+		unsigned short m_server_udp_port;
+		sf::Uint32 m_udp_token;
+
+		//Server bytes that do not make up a whole packet yet, packets are passed on whole so the handshake can be found
+		std::vector<char> m_downstream_bytes;
+		OutboundQueue m_client_queue;
+		OutboundQueue m_server_queue;
+		SimulatedLink m_stream_up;
+		SimulatedLink m_stream_down;
+		SimulatedLink m_datagram_up;
+		SimulatedLink m_datagram_down;
+
+		//A side that hung up still gets what was already on its way to the other side
+		bool m_client_closed;
+		bool m_server_closed;
+	};
+
+	typedef std::unique_ptr<Connection> ConnectionPtr;
+
+	struct Totals
+	{
+		std::size_t m_delivered = 0;
+		std::size_t m_dropped = 0;
+		std::size_t m_bytes = 0;
+	};
+
+private:
+	sf::Time Now() const;
+	void AcceptConnections();
+	void ReadClient(Connection& connection, sf::Time now);
+	void ReadServer(Connection& connection, sf::Time now);
+	void ReadClientDatagrams(sf::Time now);
+	void ReadServerDatagrams(Connection& connection, sf::Time now);
+	void RewriteHandshakes(Connection& connection, std::vector<char>& packet);
+	void RewriteHandshake(Connection& connection, char* message, std::size_t size);
+	//Hands over whatever has arrived, false once the connection is finished with
+	bool Deliver(Connection& connection, sf::Time now);
+	void CloseConnection(std::size_t slot);
+	void AddTotals(const Connection& connection, Totals& upstream, Totals& downstream) const;
+
+private:
+	Pollable<sf::TcpListener> m_listener;
+	//Client facing, every client's datagrams arrive here and are told apart by their token
+	Pollable<sf::UdpSocket> m_udp_socket;
+	SocketPoller m_poller;
+	bool m_listening;
+	sf::IpAddress m_server_address;
+	unsigned short m_server_port;
+
+	SlotTable<Connection> m_connections;
+	std::unordered_map<sf::Uint32, std::size_t> m_slots_by_token;
+	NetworkConditions m_conditions;
+	std::mt19937 m_random;
+	sf::Clock m_clock;
+
+	//Traffic of connections that have closed, open ones are added when reporting
+	Totals m_closed_upstream;
+	Totals m_closed_downstream;
+};
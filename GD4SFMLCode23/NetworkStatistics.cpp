@@ -0,0 +1,195 @@
+#include "NetworkStatistics.hpp"
+#include "NetworkProtocol.hpp"
+
+#include <sstream>
+
+namespace
+{
+	const char* const kServerPacketNames[] =
+	{
+		"BroadcastMessage",
+		"InitialState",
+		"PlayerEvent",
+		"PlayerConnect",
+		"PlayerDisconnect",
+		"AcceptCoopPartner",
+		"SpawnEnemy",
+		"SpawnPickup",
+		"SpawnSelf",
+		"UpdateClientState",
+		"MissionSuccess",
+		"UdpHandshake",
+		"Batch",
+		"Pong",
+		"Session"
+	};
+	static_assert(sizeof(kServerPacketNames) / sizeof(kServerPacketNames[0]) == static_cast<std::size_t>(Server::PacketType::kPacketTypeCount), "Every server packet type needs a name");
+
+	const char* const kClientPacketNames[] =
+	{
+		"PlayerEvent",
+		"RequestCoopPartner",
+		"Input",
+		"GameEvent",
+		"Quit",
+		"UdpHello",
+		"SnapshotAck",
+		"Ping",
+		"JoinRoom",
+		"ResumeSession"
+	};
+	static_assert(sizeof(kClientPacketNames) / sizeof(kClientPacketNames[0]) == static_cast<std::size_t>(Client::PacketType::kPacketTypeCount), "Every client packet type needs a name");
+}
+
+NetworkStatistics::Counter::Counter()
+	: m_packets(0)
+	, m_bytes(0)
+{
+}
+
+NetworkStatistics::NetworkStatistics(bool server_side)
+	: m_server_side(server_side)
+	, m_elapsed(sf::Time::Zero)
+	, m_dropped_datagrams(0)
+	, m_out_of_order_datagrams(0)
+	, m_dropped_per_second(0)
+	, m_out_of_order_per_second(0)
+	, m_round_trip_time(sf::Time::Zero)
+	, m_snapshot_age(sf::Time::Zero)
+	, m_interpolation_delay(sf::Time::Zero)
+	, m_jitter(sf::Time::Zero)
+	, m_prediction_corrections(0)
+	, m_receive_backlog(0)
+	, m_receive_budget_hits(0)
+	, m_receive_budget_hits_per_second(0)
+{
+	std::size_t server_types = static_cast<std::size_t>(Server::PacketType::kPacketTypeCount);
+	std::size_t client_types = static_cast<std::size_t>(Client::PacketType::kPacketTypeCount);
+	m_incoming.m_counting.resize(server_side ? client_types : server_types);
+	m_outgoing.m_counting.resize(server_side ? server_types : client_types);
+	m_incoming.m_per_second = m_incoming.m_counting;
+	m_outgoing.m_per_second = m_outgoing.m_counting;
+}
+
+void NetworkStatistics::RecordIncoming(sf::Int32 packet_type, std::size_t bytes)
+{
+	Record(m_incoming, packet_type, bytes);
+}
+
+void NetworkStatistics::RecordOutgoing(sf::Int32 packet_type, std::size_t bytes)
+{
+	Record(m_outgoing, packet_type, bytes);
+}
+
+void NetworkStatistics::RecordDatagramSequence(sf::Uint16 sequence, sf::Uint16 last_sequence)
+{
+	if (Datagram::IsNewer(sequence, last_sequence))
+	{
+		m_dropped_datagrams += static_cast<sf::Uint16>(sequence - last_sequence) - 1;
+	}
+	else
+	{
+		++m_out_of_order_datagrams;
+	}
+}
+
+void NetworkStatistics::SetRoundTripTime(sf::Time round_trip_time)
+{
+	m_round_trip_time = round_trip_time;
+}
+
+void NetworkStatistics::SetSnapshotAge(sf::Time snapshot_age)
+{
+	m_snapshot_age = snapshot_age;
+}
+
+void NetworkStatistics::SetInterpolation(sf::Time delay, sf::Time jitter)
+{
+	m_interpolation_delay = delay;
+	m_jitter = jitter;
+}
+
+void NetworkStatistics::SetPredictionCorrections(std::size_t corrections)
+{
+	m_prediction_corrections = corrections;
+}
+
+void NetworkStatistics::SetReceiveBacklog(std::size_t backlog)
+{
+	m_receive_backlog = backlog;
+}
+
+void NetworkStatistics::RecordReceiveBudgetHit()
+{
+	++m_receive_budget_hits;
+}
+
+void NetworkStatistics::Update(sf::Time dt)
+{
+	m_elapsed += dt;
+	if (m_elapsed < sf::seconds(1.f))
+	{
+		return;
+	}
+
+	m_incoming.m_per_second.swap(m_incoming.m_counting);
+	m_outgoing.m_per_second.swap(m_outgoing.m_counting);
+	m_incoming.m_counting.assign(m_incoming.m_counting.size(), Counter());
+	m_outgoing.m_counting.assign(m_outgoing.m_counting.size(), Counter());
+
+	m_dropped_per_second = m_dropped_datagrams;
+	m_out_of_order_per_second = m_out_of_order_datagrams;
+	m_receive_budget_hits_per_second = m_receive_budget_hits;
+	m_dropped_datagrams = 0;
+	m_out_of_order_datagrams = 0;
+	m_receive_budget_hits = 0;
+	m_elapsed = sf::Time::Zero;
+}
+
+std::string NetworkStatistics::ToString() const
+{
+	std::string text;
+	AppendTraffic(text, "In", m_incoming, m_server_side ? kClientPacketNames : kServerPacketNames);
+	AppendTraffic(text, "Out", m_outgoing, m_server_side ? kServerPacketNames : kClientPacketNames);
+
+	std::ostringstream health;
+	health << "RTT " << m_round_trip_time.asMilliseconds() << " ms, snapshot age " << m_snapshot_age.asMilliseconds() << " ms\n";
+	if (!m_server_side)
+	{
+		health << "Interpolation delay " << m_interpolation_delay.asMilliseconds() << " ms, jitter " << m_jitter.asMilliseconds() << " ms, prediction corrections " << m_prediction_corrections << "\n";
+	}
+	health << "Datagrams dropped " << m_dropped_per_second << "/s, out of order " << m_out_of_order_per_second << "/s, receive backlog " << m_receive_backlog << ", budget hit " << m_receive_budget_hits_per_second << "/s\n";
+	return text + health.str();
+}
+
+void NetworkStatistics::Record(Traffic& traffic, sf::Int32 packet_type, std::size_t bytes)
+{
+	std::size_t index = static_cast<std::size_t>(packet_type);
+	if (packet_type < 0 || index >= traffic.m_counting.size())
+	{
+		return;
+	}
+
+	++traffic.m_counting[index].m_packets;
+	traffic.m_counting[index].m_bytes += bytes;
+}
+
+void NetworkStatistics::AppendTraffic(std::string& text, const char* title, const Traffic& traffic, const char* const* names)
+{
+	Counter total;
+	std::ostringstream types;
+	for (std::size_t i = 0; i < traffic.m_per_second.size(); ++i)
+	{
+		const Counter& counter = traffic.m_per_second[i];
+		if (counter.m_packets > 0)
+		{
+			types << "  " << names[i] << " " << counter.m_packets << "/s " << counter.m_bytes << " B/s\n";
+		}
+		total.m_packets += counter.m_packets;
+		total.m_bytes += counter.m_bytes;
+	}
+
+	std::ostringstream summary;
+	summary << title << " " << total.m_packets << " packets/s " << total.m_bytes << " B/s\n";
+	text += summary.str() + types.str();
+}
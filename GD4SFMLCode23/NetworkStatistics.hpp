@@ -0,0 +1,71 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//Traffic per packet type in each direction, as packets and bytes per second, plus the figures that say how healthy the connection is
+//The client counts server packets coming in and its own going out, the server the other way round
+class NetworkStatistics
+{
+public:
+	explicit NetworkStatistics(bool server_side);
+	void RecordIncoming(sf::Int32 packet_type, std::size_t bytes);
+	void RecordOutgoing(sf::Int32 packet_type, std::size_t bytes);
+	//A datagram sequence gap counts the missing ones as dropped, an older sequence arriving late counts as out of order
+	void RecordDatagramSequence(sf::Uint16 sequence, sf::Uint16 last_sequence);
+
+	void SetRoundTripTime(sf::Time round_trip_time);
+	void SetSnapshotAge(sf::Time snapshot_age);
+	//How far behind the server's clock remote aircraft are drawn, and the snapshot arrival jitter that delay allows for
+	void SetInterpolation(sf::Time delay, sf::Time jitter);
+	//Times the server disagreed with where our own aircraft were predicted to be
+	void SetPredictionCorrections(std::size_t corrections);
+	void SetReceiveBacklog(std::size_t backlog);
+	//A frame that stopped reading at the receive budget with more still waiting
+	void RecordReceiveBudgetHit();
+
+	//Turns the counts of the last whole second into rates
+	void Update(sf::Time dt);
+	std::string ToString() const;
+
+private:
+	struct Counter
+	{
+		Counter();
+		std::size_t m_packets;
+		std::size_t m_bytes;
+	};
+
+	struct Traffic
+	{
+		std::vector<Counter> m_counting;
+		std::vector<Counter> m_per_second;
+	};
+
+private:
+	static void Record(Traffic& traffic, sf::Int32 packet_type, std::size_t bytes);
+	static void AppendTraffic(std::string& text, const char* title, const Traffic& traffic, const char* const* names);
+
+private:
+	bool m_server_side;
+	Traffic m_incoming;
+	Traffic m_outgoing;
+	sf::Time m_elapsed;
+
+	std::size_t m_dropped_datagrams;
+	std::size_t m_out_of_order_datagrams;
+	std::size_t m_dropped_per_second;
+	std::size_t m_out_of_order_per_second;
+
+	sf::Time m_round_trip_time;
+	sf::Time m_snapshot_age;
+	sf::Time m_interpolation_delay;
+	sf::Time m_jitter;
+	std::size_t m_prediction_corrections;
+	std::size_t m_receive_backlog;
+	std::size_t m_receive_budget_hits;
+	std::size_t m_receive_budget_hits_per_second;
+};
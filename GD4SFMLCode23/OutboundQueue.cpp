@@ -0,0 +1,90 @@
+#include "OutboundQueue.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	//Most a single write gathers, larger queues take several writes in one flush
+	const std::size_t kMaxWriteSize = 64 * 1024;
+}
+
+OutboundQueue::OutboundQueue()
+	: m_size(0)
+{
+}
+
+void OutboundQueue::Push(const Buffer& buffer)
+{
+	Push(buffer, 0, buffer->size());
+}
+
+void OutboundQueue::Push(const Buffer& buffer, std::size_t offset, std::size_t size)
+{
+	if (size > 0)
+	{
+		m_chunks.push_back({ buffer, offset, size });
+		m_size += size;
+	}
+}
+
+sf::Socket::Status OutboundQueue::Flush(sf::TcpSocket& socket)
+{
+	while (!m_chunks.empty())
+	{
+		m_scratch.clear();
+		for (const Chunk& chunk : m_chunks)
+		{
+			std::size_t size = std::min(chunk.m_size, kMaxWriteSize - m_scratch.size());
+			const char* data = chunk.m_buffer->data() + chunk.m_offset;
+			m_scratch.insert(m_scratch.end(), data, data + size);
+			if (m_scratch.size() == kMaxWriteSize)
+			{
+				break;
+			}
+		}
+
+		std::size_t sent = 0;
+		sf::Socket::Status status = socket.send(m_scratch.data(), m_scratch.size(), sent);
+		Consume(sent);
+
+		//Partial and NotReady both mean the socket is full for now, what is left waits for the next flush
+		if (status != sf::Socket::Done)
+		{
+			return status;
+		}
+	}
+	return sf::Socket::Done;
+}
+
+std::size_t OutboundQueue::GetSize() const
+{
+	return m_size;
+}
+
+bool OutboundQueue::IsEmpty() const
+{
+	return m_chunks.empty();
+}
+
+void OutboundQueue::Clear()
+{
+	m_chunks.clear();
+	m_size = 0;
+}
+
+void OutboundQueue::Consume(std::size_t size)
+{
+	m_size -= size;
+	while (size > 0)
+	{
+		Chunk& chunk = m_chunks.front();
+		std::size_t used = std::min(size, chunk.m_size);
+		chunk.m_offset += used;
+		chunk.m_size -= used;
+		size -= used;
+		if (chunk.m_size == 0)
+		{
+			m_chunks.pop_front();
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <SFML/Network/Socket.hpp>
+#include <SFML/Network/TcpSocket.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+
+//Bytes waiting to go out on one peer's non-blocking socket
+//Buffers are shared, a message sent to every peer is serialised once and each queue only holds a reference to it
+//A write the socket could only partly take resumes from where it stopped on the next flush
+class OutboundQueue
+{
+public:
+	typedef std::shared_ptr<const std::vector<char>> Buffer;
+
+public:
+	OutboundQueue();
+	void Push(const Buffer& buffer);
+	void Push(const Buffer& buffer, std::size_t offset, std::size_t size);
+	//Writes as much as the socket takes, Done means the queue is empty
+	sf::Socket::Status Flush(sf::TcpSocket& socket);
+	std::size_t GetSize() const;
+	bool IsEmpty() const;
+	void Clear();
+
+private:
+	struct Chunk
+	{
+		Buffer m_buffer;
+		std::size_t m_offset;
+		std::size_t m_size;
+	};
+
+private:
+	void Consume(std::size_t size);
+
+private:
+	std::deque<Chunk> m_chunks;
+	std::size_t m_size;
+	//Chunks are gathered here so a flush is one write rather than one per chunk
+	std::vector<char> m_scratch;
+};
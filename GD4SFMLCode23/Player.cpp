@@ -5,7 +5,9 @@
 #include <string>
 #include <algorithm>
 #include <iostream>
+#include "InputCommand.hpp"
 #include "NetworkProtocol.hpp"
+#include "PositionCodec.hpp"
 #include <SFML/Network/Packet.hpp>
 
 struct AircraftMover
@@ -41,10 +43,11 @@ struct AircraftFireTrigger
     int aircraft_id;
 };
 
-Player::Player(sf::TcpSocket* socket, sf::Int32 identifier, const KeyBinding* binding) 
+Player::Player(sf::TcpSocket* socket, sf::Int32 identifier, const KeyBinding* binding, NetworkStatistics* statistics) 
     : m_key_binding(binding)
     , m_identifier(identifier)
     , m_socket(socket)
+    , m_statistics(statistics)
 {
 
     //Set initial action bindings
@@ -72,7 +75,12 @@ void Player::HandleEvent(const sf::Event& event, CommandQueue& commands)
                 packet << static_cast<sf::Int32>(Client::PacketType::kPlayerEvent);
                 packet << m_identifier;
                 packet << static_cast<sf::Int32>(action);
-                m_socket->send(packet);
+                if (action == Action::kFireTrigger)
+                {
+                    packet << static_cast<sf::Int64>(m_view_time.asMicroseconds());
+                    PositionCodec::Write(packet, m_aim_position);
+                }
+                SendPacket(Client::PacketType::kPlayerEvent, packet);
             }
 
             // Network disconnected -> local event
@@ -82,22 +90,6 @@ void Player::HandleEvent(const sf::Event& event, CommandQueue& commands)
             }
         }
     }
-
-    // Realtime change (network connected)
-    if ((event.type == sf::Event::KeyPressed || event.type == sf::Event::KeyReleased) && m_socket)
-    {
-        Action action;
-        if (m_key_binding && m_key_binding->CheckAction(event.key.code, action) && IsRealtimeAction(action))
-        {
-            // Send realtime change over network
-            sf::Packet packet;
-            packet << static_cast<sf::Int32>(Client::PacketType::kPlayerRealTimeChange);
-            packet << m_identifier;
-            packet << static_cast<sf::Int32>(action);
-            packet << (event.type == sf::Event::KeyPressed);
-            m_socket->send(packet);
-        }
-    }
 }
 
 bool Player::IsLocal() const
@@ -106,17 +98,41 @@ bool Player::IsLocal() const
     return m_key_binding != nullptr;
 }
 
-void Player::DisableAllRealtimeActions()
+sf::Uint8 Player::GetInputButtons() const
 {
-    for (auto& action : m_action_proxies)
+    sf::Uint8 buttons = 0;
+    if (!m_key_binding)
     {
-        sf::Packet packet;
-        packet << static_cast<sf::Int32>(Client::PacketType::kPlayerRealTimeChange);
-        packet << m_identifier;
-        packet << static_cast<sf::Int32>(action.first);
-        packet << false;
-        m_socket->send(packet);
+        return buttons;
     }
+
+    for (Action action : m_key_binding->GetRealtimeActions())
+    {
+        switch (action)
+        {
+        case Action::kMoveLeft:
+            buttons |= InputCommand::kMoveLeft;
+            break;
+        case Action::kMoveRight:
+            buttons |= InputCommand::kMoveRight;
+            break;
+        case Action::kMoveUp:
+            buttons |= InputCommand::kMoveUp;
+            break;
+        case Action::kMoveDown:
+            buttons |= InputCommand::kMoveDown;
+            break;
+        default:
+            break;
+        }
+    }
+    return buttons;
+}
+
+void Player::SetAim(sf::Time view_time, sf::Vector2f aim_position)
+{
+    m_view_time = view_time;
+    m_aim_position = aim_position;
 }
 
 void Player::HandleRealtimeInput(CommandQueue& commands)
@@ -131,29 +147,11 @@ void Player::HandleRealtimeInput(CommandQueue& commands)
     }
 }
 
-void Player::HandleRealtimeNetworkInput(CommandQueue& commands)
-{
-    if (m_socket && !IsLocal())
-    {
-        // Traverse all realtime input proxies. Because this is a networked game, the input isn't handled directly
-        for (auto pair : m_action_proxies)
-        {
-            if (pair.second && IsRealtimeAction(pair.first))
-                commands.Push(m_action_binding[pair.first]);
-        }
-    }
-}
-
 void Player::HandleNetworkEvent(Action action, CommandQueue& commands)
 {
     commands.Push(m_action_binding[action]);
 }
 
-void Player::HandleNetworkRealtimeChange(Action action, bool actionEnabled)
-{
-    m_action_proxies[action] = actionEnabled;
-}
-
 void Player::InitializeActions()
 {
     const float kPlayerSpeed = 200.f;
@@ -163,3 +161,12 @@ void Player::InitializeActions()
     m_action_binding[Action::kMoveDown].action = DerivedAction<Aircraft>(AircraftMover(0.f, kPlayerSpeed, m_identifier));
     m_action_binding[Action::kFireTrigger].action = DerivedAction<Aircraft>(AircraftFireTrigger(m_identifier));
 }
+
+void Player::SendPacket(Client::PacketType packet_type, sf::Packet& packet)
+{
+    if (m_statistics)
+    {
+        m_statistics->RecordOutgoing(static_cast<sf::Int32>(packet_type), packet.getDataSize() + sizeof(sf::Uint32));
+    }
+    m_socket->send(packet);
+}
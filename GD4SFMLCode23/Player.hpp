@@ -5,32 +5,40 @@
 #include <map>
 #include "KeyBinding.hpp"
 #include "CommandQueue.hpp"
+#include "NetworkProtocol.hpp"
+#include "NetworkStatistics.hpp"
 #include <SFML/Network/TcpSocket.hpp>
+#include <SFML/System/Time.hpp>
+#include <SFML/System/Vector2.hpp>
 
 class Player
 {
 public:
-	Player(sf::TcpSocket* socket, sf::Int32 identifier, const KeyBinding* binding);
+	Player(sf::TcpSocket* socket, sf::Int32 identifier, const KeyBinding* binding, NetworkStatistics* statistics = nullptr);
 	void HandleEvent(const sf::Event& event, CommandQueue& command);
 	void HandleRealtimeInput(CommandQueue& command);
-	void HandleRealtimeNetworkInput(CommandQueue& commands);
 
-	//React to events or realtime state changes recevied over the network
+	//React to events recevied over the network, held keys travel in InputCommands instead
 	void HandleNetworkEvent(Action action, CommandQueue& commands);
-	void HandleNetworkRealtimeChange(Action action, bool action_enabled);
 
-	void DisableAllRealtimeActions();
 	bool IsLocal() const;
+	//Movement keys held right now, as InputCommand buttons
+	sf::Uint8 GetInputButtons() const;
+	//Sent along with shots so the server can check them against what this player was looking at
+	void SetAim(sf::Time view_time, sf::Vector2f aim_position);
 
 private:
 	void InitializeActions();
+	void SendPacket(Client::PacketType packet_type, sf::Packet& packet);
 
 private:
 	const KeyBinding* m_key_binding;
 	std::map<Action, Command> m_action_binding;
-	std::map<Action, bool> m_action_proxies;
 	int m_identifier;
 	sf::TcpSocket* m_socket;
+	NetworkStatistics* m_statistics;
+	sf::Time m_view_time;
+	sf::Vector2f m_aim_position;
 
 };
 
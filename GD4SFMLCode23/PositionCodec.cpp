@@ -0,0 +1,152 @@
+#include "PositionCodec.hpp"
+#include "NetworkProtocol.hpp"
+#include "Snapshot.hpp"
+#include <SFML/Network/Packet.hpp>
+
+#include <cstdlib>
+
+namespace
+{
+	//The battlefield is 1024 wide and the world 5000 tall, aircraft may briefly leave either
+	const Quantizer QuantizerX(-512.f, 1536.f, POSITION_PRECISION);
+	const Quantizer QuantizerY(-1024.f, 6144.f, POSITION_PRECISION);
+
+	//A baseline is at most the snapshot history old, at the default 20 ticks a second
+	//Nothing moves faster than a player aircraft at InputCommand's 400 units a second
+	const float kMaxBaselineAge = SnapshotBuffer::kCapacity / 20.f;
+	const float kMaxDeltaDistance = 400.f * kMaxBaselineAge;
+
+	//Deltas come in three widths per axis behind a 2 bit tag, the last tag is a full position
+	//Narrow covers drifting in place, medium a few ticks at full speed which is a typical baseline's age, wide anything up to the oldest baseline
+	//Only a jump such as a respawn, or a slower tick rate than the default, needs the full position
+	const unsigned int kDeltaTagBits = 2;
+	const unsigned int kDeltaBits[] =
+	{
+		7,
+		10,
+		BitsRequired(static_cast<sf::Uint32>(kMaxDeltaDistance / POSITION_PRECISION)) + 1
+	};
+	const sf::Uint32 kFullPositionTag = sizeof(kDeltaBits) / sizeof(kDeltaBits[0]);
+	static_assert(sizeof(kDeltaBits) / sizeof(kDeltaBits[0]) < (1u << kDeltaTagBits), "Delta widths and the full position tag no longer fit the tag");
+
+	bool FitsDelta(int value, unsigned int bits)
+	{
+		int limit = 1 << (bits - 1);
+		return value >= -limit && value < limit;
+	}
+
+	void WriteValue(sf::Packet& packet, sf::Uint32 value, const Quantizer& quantizer)
+	{
+		if (quantizer.GetBits() <= 16)
+		{
+			packet << static_cast<sf::Uint16>(value);
+		}
+		else
+		{
+			packet << value;
+		}
+	}
+
+	sf::Uint32 ReadValue(sf::Packet& packet, const Quantizer& quantizer)
+	{
+		if (quantizer.GetBits() <= 16)
+		{
+			sf::Uint16 value = 0;
+			packet >> value;
+			return value;
+		}
+		sf::Uint32 value = 0;
+		packet >> value;
+		return value;
+	}
+}
+
+const Quantizer& PositionCodec::AxisX()
+{
+	return QuantizerX;
+}
+
+const Quantizer& PositionCodec::AxisY()
+{
+	return QuantizerY;
+}
+
+sf::Vector2i PositionCodec::Quantize(sf::Vector2f position)
+{
+	return sf::Vector2i(static_cast<int>(QuantizerX.Quantize(position.x)), static_cast<int>(QuantizerY.Quantize(position.y)));
+}
+
+sf::Vector2f PositionCodec::Dequantize(sf::Vector2i position)
+{
+	return sf::Vector2f(QuantizerX.Dequantize(static_cast<sf::Uint32>(position.x)), QuantizerY.Dequantize(static_cast<sf::Uint32>(position.y)));
+}
+
+sf::Vector2f PositionCodec::Round(sf::Vector2f position)
+{
+	return Dequantize(Quantize(position));
+}
+
+void PositionCodec::Write(BitWriter& writer, sf::Vector2f position)
+{
+	sf::Vector2i quantized = Quantize(position);
+	writer.Write(static_cast<sf::Uint32>(quantized.x), QuantizerX.GetBits());
+	writer.Write(static_cast<sf::Uint32>(quantized.y), QuantizerY.GetBits());
+}
+
+sf::Vector2f PositionCodec::Read(BitReader& reader)
+{
+	sf::Vector2i quantized;
+	quantized.x = static_cast<int>(reader.Read(QuantizerX.GetBits()));
+	quantized.y = static_cast<int>(reader.Read(QuantizerY.GetBits()));
+	return Dequantize(quantized);
+}
+
+void PositionCodec::WriteDelta(BitWriter& writer, sf::Vector2f from, sf::Vector2f to)
+{
+	sf::Vector2i delta = Quantize(to) - Quantize(from);
+	for (sf::Uint32 tag = 0; tag < kFullPositionTag; ++tag)
+	{
+		unsigned int bits = kDeltaBits[tag];
+		if (FitsDelta(delta.x, bits) && FitsDelta(delta.y, bits))
+		{
+			int limit = 1 << (bits - 1);
+			writer.Write(tag, kDeltaTagBits);
+			writer.Write(static_cast<sf::Uint32>(delta.x + limit), bits);
+			writer.Write(static_cast<sf::Uint32>(delta.y + limit), bits);
+			return;
+		}
+	}
+
+	writer.Write(kFullPositionTag, kDeltaTagBits);
+	Write(writer, to);
+}
+
+sf::Vector2f PositionCodec::ReadDelta(BitReader& reader, sf::Vector2f from)
+{
+	sf::Uint32 tag = reader.Read(kDeltaTagBits);
+	if (tag < kFullPositionTag)
+	{
+		unsigned int bits = kDeltaBits[tag];
+		int limit = 1 << (bits - 1);
+		sf::Vector2i quantized = Quantize(from);
+		quantized.x += static_cast<int>(reader.Read(bits)) - limit;
+		quantized.y += static_cast<int>(reader.Read(bits)) - limit;
+		return Dequantize(quantized);
+	}
+	return Read(reader);
+}
+
+void PositionCodec::Write(sf::Packet& packet, sf::Vector2f position)
+{
+	sf::Vector2i quantized = Quantize(position);
+	WriteValue(packet, static_cast<sf::Uint32>(quantized.x), QuantizerX);
+	WriteValue(packet, static_cast<sf::Uint32>(quantized.y), QuantizerY);
+}
+
+sf::Vector2f PositionCodec::Read(sf::Packet& packet)
+{
+	sf::Vector2i quantized;
+	quantized.x = static_cast<int>(ReadValue(packet, QuantizerX));
+	quantized.y = static_cast<int>(ReadValue(packet, QuantizerY));
+	return Dequantize(quantized);
+}
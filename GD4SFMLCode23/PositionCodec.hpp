@@ -0,0 +1,32 @@
+#pragma once
+#include <SFML/System/Vector2.hpp>
+#include "BitStream.hpp"
+
+namespace sf
+{
+	class Packet;
+}
+
+//World positions travel as fixed-point values at POSITION_PRECISION, covering the world plus a margin on every side
+class PositionCodec
+{
+public:
+	static const Quantizer& AxisX();
+	static const Quantizer& AxisY();
+
+	static sf::Vector2i Quantize(sf::Vector2f position);
+	static sf::Vector2f Dequantize(sf::Vector2i position);
+	//Snaps a position to the nearest value the codec can represent
+	static sf::Vector2f Round(sf::Vector2f position);
+
+	static void Write(BitWriter& writer, sf::Vector2f position);
+	static sf::Vector2f Read(BitReader& reader);
+
+	//Moves relative to a known position are sent as an offset per axis, only as wide as the move needs
+	static void WriteDelta(BitWriter& writer, sf::Vector2f from, sf::Vector2f to);
+	static sf::Vector2f ReadDelta(BitReader& reader, sf::Vector2f from);
+
+	//Byte aligned form for packets that are not bit packed
+	static void Write(sf::Packet& packet, sf::Vector2f position);
+	static sf::Vector2f Read(sf::Packet& packet);
+};
@@ -0,0 +1,152 @@
+#include "PositionHistory.hpp"
+#include "NetworkProtocol.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	sf::Vector2f Lerp(sf::Vector2f from, sf::Vector2f to, float fraction)
+	{
+		return from + (to - from) * fraction;
+	}
+
+	//Slab test, returns where along the segment it enters the box
+	bool Intersects(sf::Vector2f start, sf::Vector2f end, const sf::FloatRect& box, float& entry)
+	{
+		const float starts[2] = { start.x, start.y };
+		const float deltas[2] = { end.x - start.x, end.y - start.y };
+		const float mins[2] = { box.left, box.top };
+		const float maxs[2] = { box.left + box.width, box.top + box.height };
+
+		float near_t = 0.f;
+		float far_t = 1.f;
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			if (deltas[axis] == 0.f)
+			{
+				if (starts[axis] < mins[axis] || starts[axis] > maxs[axis])
+				{
+					return false;
+				}
+				continue;
+			}
+
+			float t1 = (mins[axis] - starts[axis]) / deltas[axis];
+			float t2 = (maxs[axis] - starts[axis]) / deltas[axis];
+			if (t1 > t2)
+			{
+				std::swap(t1, t2);
+			}
+			near_t = std::max(near_t, t1);
+			far_t = std::min(far_t, t2);
+			if (near_t > far_t)
+			{
+				return false;
+			}
+		}
+
+		entry = near_t;
+		return true;
+	}
+}
+
+PositionHistory::PositionHistory()
+	: m_frames(kCapacity)
+	, m_newest(0)
+	, m_size(0)
+{
+}
+
+void PositionHistory::Record(sf::Uint32 tick, const ServerWorld::AircraftMap& aircraft)
+{
+	if (m_size > 0 && tick != GetNewestTick() + 1)
+	{
+		m_size = 0;
+	}
+
+	m_newest = (m_newest + 1) % kCapacity;
+	if (m_size < kCapacity)
+	{
+		++m_size;
+	}
+
+	Frame& frame = m_frames[m_newest];
+	frame.m_tick = tick;
+	frame.m_entries.clear();
+	//The map is ordered by identifier, so the frame comes out sorted
+	for (const auto& pair : aircraft)
+	{
+		frame.m_entries.push_back({ pair.first, pair.second.m_position });
+	}
+}
+
+bool PositionHistory::IsEmpty() const
+{
+	return m_size == 0;
+}
+
+sf::Uint32 PositionHistory::GetOldestTick() const
+{
+	return GetNewestTick() - static_cast<sf::Uint32>(m_size - 1);
+}
+
+sf::Uint32 PositionHistory::GetNewestTick() const
+{
+	return m_frames[m_newest].m_tick;
+}
+
+bool PositionHistory::Raycast(sf::Uint32 tick, float fraction, sf::Vector2f start, sf::Vector2f end, sf::Int32 shooter, sf::Int32& hit_identifier) const
+{
+	const Frame* from = Find(tick);
+	const Frame* to = Find(tick + 1);
+	if (!from)
+	{
+		return false;
+	}
+
+	float closest = std::numeric_limits<float>::max();
+	for (const Entry& entry : from->m_entries)
+	{
+		if (entry.m_identifier == shooter)
+		{
+			continue;
+		}
+
+		//Past the newest tick the aircraft is held where it was last seen
+		const Entry* next = to ? FindEntry(*to, entry.m_identifier) : nullptr;
+		sf::Vector2f position = next ? Lerp(entry.m_position, next->m_position, fraction) : entry.m_position;
+
+		float distance;
+		if (Intersects(start, end, ServerWorld::GetHitbox(position), distance) && distance < closest)
+		{
+			closest = distance;
+			hit_identifier = entry.m_identifier;
+		}
+	}
+	return closest != std::numeric_limits<float>::max();
+}
+
+const PositionHistory::Frame* PositionHistory::Find(sf::Uint32 tick) const
+{
+	if (m_size == 0 || Datagram::IsNewer(tick, GetNewestTick()))
+	{
+		return nullptr;
+	}
+
+	sf::Uint32 age = GetNewestTick() - tick;
+	if (age >= m_size)
+	{
+		return nullptr;
+	}
+	return &m_frames[(m_newest + kCapacity - age) % kCapacity];
+}
+
+const PositionHistory::Entry* PositionHistory::FindEntry(const Frame& frame, sf::Int32 identifier)
+{
+	auto itr = std::lower_bound(frame.m_entries.begin(), frame.m_entries.end(), identifier, [](const Entry& entry, sf::Int32 value)
+	{
+		return entry.m_identifier < value;
+	});
+	return itr != frame.m_entries.end() && itr->m_identifier == identifier ? &*itr : nullptr;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstddef>
+#include <vector>
+#include "ServerWorld.hpp"
+
+//Where every aircraft was at each of the last few server ticks, so a shot can be checked against what its shooter saw
+//Frames are reused in place, recording a tick does not allocate once the ring has warmed up
+class PositionHistory
+{
+public:
+	static const std::size_t kCapacity = 32;
+
+public:
+	PositionHistory();
+	//Ticks are expected one after the other, a gap clears the older frames
+	void Record(sf::Uint32 tick, const ServerWorld::AircraftMap& aircraft);
+	bool IsEmpty() const;
+	sf::Uint32 GetOldestTick() const;
+	sf::Uint32 GetNewestTick() const;
+
+	//Closest aircraft other than the shooter whose hitbox the segment crosses between tick and tick + 1
+	//Positions are interpolated the way clients draw remote aircraft
+	bool Raycast(sf::Uint32 tick, float fraction, sf::Vector2f start, sf::Vector2f end, sf::Int32 shooter, sf::Int32& hit_identifier) const;
+
+private:
+	struct Entry
+	{
+		sf::Int32 m_identifier;
+		sf::Vector2f m_position;
+	};
+
+	struct Frame
+	{
+		sf::Uint32 m_tick;
+		//Sorted by identifier
+		std::vector<Entry> m_entries;
+	};
+
+private:
+	const Frame* Find(sf::Uint32 tick) const;
+	static const Entry* FindEntry(const Frame& frame, sf::Int32 identifier);
+
+private:
+	std::vector<Frame> m_frames;
+	std::size_t m_newest;
+	std::size_t m_size;
+};
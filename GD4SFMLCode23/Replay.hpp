@@ -0,0 +1,28 @@
+#pragma once
+#include <SFML/Config.hpp>
+
+#include <cstddef>
+
+//A match replay is a header followed by records in the order the server produced them
+//Each record is its type, the server tick it belongs to and its payload size, integers are in network byte order like sf::Packet
+namespace Replay
+{
+	const char kMagic[4] = { 'G', 'D', '4', 'R' };
+	const sf::Uint32 kVersion = 4;
+	//Magic, version and the tick interval in microseconds
+	const std::size_t kHeaderSize = 12;
+	const std::size_t kRecordHeaderSize = 9;
+	//A seek lands on the keyframe before the target and plays forward from there, so this bounds how much a seek replays
+	const sf::Uint32 kKeyframeInterval = 100;
+
+	enum class RecordType : sf::Uint8
+	{
+		//A kInitialState message carrying every aircraft, playback rebuilds the world from one after a seek
+		kKeyframe,
+		//The kUpdateClientState payload a spectator who sees every aircraft would get, deltas are against the previous tick
+		kSnapshot,
+		//A reliable message the server sent to every peer, as the packet's bytes without the size prefix
+		kMessage,
+		kRecordTypeCount
+	};
+}
@@ -0,0 +1,133 @@
+#include "ReplayReader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	sf::Uint32 ReadUint32(const char* data)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		return (static_cast<sf::Uint32>(bytes[0]) << 24) | (static_cast<sf::Uint32>(bytes[1]) << 16) | (static_cast<sf::Uint32>(bytes[2]) << 8) | bytes[3];
+	}
+}
+
+ReplayReader::ReplayReader()
+	: m_tick_interval(sf::Time::Zero)
+	, m_cursor(0)
+	, m_end(0)
+	, m_first_tick(0)
+	, m_last_tick(0)
+{
+}
+
+bool ReplayReader::Open(const std::string& path)
+{
+	m_keyframe_ticks.clear();
+	m_keyframe_offsets.clear();
+	if (!m_file.Open(path))
+	{
+		return false;
+	}
+
+	const char* data = m_file.GetData();
+	if (m_file.GetSize() < Replay::kHeaderSize || std::memcmp(data, Replay::kMagic, sizeof(Replay::kMagic)) != 0 || ReadUint32(data + 4) != Replay::kVersion)
+	{
+		m_file.Close();
+		return false;
+	}
+	m_tick_interval = sf::microseconds(ReadUint32(data + 8));
+
+	//Only the headers are read here, so even a long match opens without touching most of its pages
+	std::size_t offset = Replay::kHeaderSize;
+	m_end = m_file.GetSize();
+	Record record;
+	while (ReadRecord(offset, record))
+	{
+		if (record.m_type == Replay::RecordType::kKeyframe)
+		{
+			m_keyframe_ticks.emplace_back(record.m_tick);
+			m_keyframe_offsets.emplace_back(offset);
+		}
+		m_last_tick = record.m_tick;
+		offset += Replay::kRecordHeaderSize + record.m_size;
+	}
+	m_end = offset;
+
+	//Playback has to start from a keyframe, a replay without one has nothing to show
+	if (m_keyframe_offsets.empty() || m_tick_interval == sf::Time::Zero)
+	{
+		m_file.Close();
+		return false;
+	}
+	m_first_tick = m_keyframe_ticks.front();
+	m_cursor = m_keyframe_offsets.front();
+	return true;
+}
+
+sf::Time ReplayReader::GetTickInterval() const
+{
+	return m_tick_interval;
+}
+
+sf::Uint32 ReplayReader::GetFirstTick() const
+{
+	return m_first_tick;
+}
+
+sf::Uint32 ReplayReader::GetLastTick() const
+{
+	return m_last_tick;
+}
+
+bool ReplayReader::Peek(Record& record) const
+{
+	return ReadRecord(m_cursor, record);
+}
+
+bool ReplayReader::Next(Record& record)
+{
+	if (!ReadRecord(m_cursor, record))
+	{
+		return false;
+	}
+	m_cursor += Replay::kRecordHeaderSize + record.m_size;
+	return true;
+}
+
+void ReplayReader::Seek(sf::Uint32 tick)
+{
+	if (m_keyframe_ticks.empty())
+	{
+		return;
+	}
+
+	auto itr = std::upper_bound(m_keyframe_ticks.begin(), m_keyframe_ticks.end(), tick);
+	if (itr != m_keyframe_ticks.begin())
+	{
+		--itr;
+	}
+	m_cursor = m_keyframe_offsets[itr - m_keyframe_ticks.begin()];
+}
+
+bool ReplayReader::ReadRecord(std::size_t offset, Record& record) const
+{
+	if (offset + Replay::kRecordHeaderSize > m_end)
+	{
+		return false;
+	}
+
+	const char* header = m_file.GetData() + offset;
+	sf::Uint8 type = static_cast<sf::Uint8>(header[0]);
+	record.m_tick = ReadUint32(header + 1);
+	record.m_size = ReadUint32(header + 5);
+	record.m_data = header + Replay::kRecordHeaderSize;
+
+	//A record running past the end was still being written when the recording stopped
+	if (type >= static_cast<sf::Uint8>(Replay::RecordType::kRecordTypeCount) || record.m_size > m_end - offset - Replay::kRecordHeaderSize)
+	{
+		return false;
+	}
+	record.m_type = static_cast<Replay::RecordType>(type);
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+#include "Replay.hpp"
+
+//Reads a replay written by ReplayRecorder straight out of a memory mapping, records point into the mapping instead of being copied
+//Opening walks the record headers once to find the keyframes, a recording cut short ends at its last whole record
+class ReplayReader
+{
+public:
+	struct Record
+	{
+		Replay::RecordType m_type;
+		sf::Uint32 m_tick;
+		const char* m_data;
+		std::size_t m_size;
+	};
+
+public:
+	ReplayReader();
+	bool Open(const std::string& path);
+	sf::Time GetTickInterval() const;
+	sf::Uint32 GetFirstTick() const;
+	sf::Uint32 GetLastTick() const;
+
+	//The next record without moving past it, false at the end of the replay
+	bool Peek(Record& record) const;
+	bool Next(Record& record);
+	//Moves to the last keyframe at or before the tick, or the first one if the tick is earlier
+	void Seek(sf::Uint32 tick);
+
+private:
+	bool ReadRecord(std::size_t offset, Record& record) const;
+
+private:
+	MappedFile m_file;
+	sf::Time m_tick_interval;
+	std::size_t m_cursor;
+	std::size_t m_end;
+	sf::Uint32 m_first_tick;
+	sf::Uint32 m_last_tick;
+	//Ticks and file offsets of every keyframe, in order
+	std::vector<sf::Uint32> m_keyframe_ticks;
+	std::vector<std::size_t> m_keyframe_offsets;
+};
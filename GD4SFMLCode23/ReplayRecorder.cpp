@@ -0,0 +1,116 @@
+#include "ReplayRecorder.hpp"
+#include "BitStream.hpp"
+#include "PositionCodec.hpp"
+
+namespace
+{
+	void WriteUint32(std::vector<char>& buffer, sf::Uint32 value)
+	{
+		buffer.push_back(static_cast<char>(value >> 24));
+		buffer.push_back(static_cast<char>(value >> 16));
+		buffer.push_back(static_cast<char>(value >> 8));
+		buffer.push_back(static_cast<char>(value));
+	}
+}
+
+ReplayRecorder::ReplayRecorder()
+	: m_last_keyframe_tick(0)
+	, m_has_keyframe(false)
+	, m_bytes_written(0)
+{
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+	Close();
+}
+
+bool ReplayRecorder::Open(const std::string& path, sf::Time tick_interval)
+{
+	Close();
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file)
+	{
+		return false;
+	}
+
+	std::vector<char> header(Replay::kMagic, Replay::kMagic + sizeof(Replay::kMagic));
+	WriteUint32(header, Replay::kVersion);
+	WriteUint32(header, static_cast<sf::Uint32>(tick_interval.asMicroseconds()));
+	m_file.write(header.data(), header.size());
+
+	m_bytes_written = header.size();
+	m_has_keyframe = false;
+	m_last_snapshot.reset();
+	return m_file.good();
+}
+
+void ReplayRecorder::Close()
+{
+	if (m_file.is_open())
+	{
+		m_file.close();
+	}
+}
+
+bool ReplayRecorder::IsOpen() const
+{
+	return m_file.is_open();
+}
+
+bool ReplayRecorder::IsKeyframeDue(sf::Uint32 tick) const
+{
+	return !m_has_keyframe || tick - m_last_keyframe_tick >= Replay::kKeyframeInterval;
+}
+
+void ReplayRecorder::RecordKeyframe(sf::Uint32 tick, const sf::Packet& initial_state)
+{
+	WriteRecord(Replay::RecordType::kKeyframe, tick, initial_state.getData(), initial_state.getDataSize());
+	m_last_keyframe_tick = tick;
+	m_has_keyframe = true;
+
+	//Playback can start at a keyframe, so the snapshot after it must not need an earlier one
+	m_last_snapshot.reset();
+
+	//A crash only loses what was recorded since the last keyframe
+	m_file.flush();
+}
+
+void ReplayRecorder::RecordSnapshot(float battlefield_bottom, SnapshotPtr snapshot)
+{
+	BitWriter payload;
+	payload.Write(PositionCodec::AxisY().Quantize(battlefield_bottom), PositionCodec::AxisY().GetBits());
+	//A spectator has no aircraft of its own, so there is no input to acknowledge
+	payload.WriteCompact(0);
+	WriteSnapshotDelta(payload, m_last_snapshot.get(), *snapshot);
+
+	WriteRecord(Replay::RecordType::kSnapshot, snapshot->m_tick, payload.GetData(), payload.GetByteCount());
+	m_last_snapshot = snapshot;
+}
+
+void ReplayRecorder::RecordMessage(sf::Uint32 tick, const MessageBatch::Message& message)
+{
+	WriteRecord(Replay::RecordType::kMessage, tick, message->data() + sizeof(sf::Uint32), message->size() - sizeof(sf::Uint32));
+}
+
+std::size_t ReplayRecorder::GetBytesWritten() const
+{
+	return m_bytes_written;
+}
+
+void ReplayRecorder::WriteRecord(Replay::RecordType type, sf::Uint32 tick, const void* data, std::size_t size)
+{
+	if (!m_file.is_open())
+	{
+		return;
+	}
+
+	std::vector<char> header;
+	header.reserve(Replay::kRecordHeaderSize);
+	header.push_back(static_cast<char>(type));
+	WriteUint32(header, tick);
+	WriteUint32(header, static_cast<sf::Uint32>(size));
+	m_file.write(header.data(), header.size());
+	m_file.write(static_cast<const char*>(data), size);
+	m_bytes_written += header.size() + size;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/Network/Packet.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MessageBatch.hpp"
+#include "Replay.hpp"
+#include "Snapshot.hpp"
+
+//Writes what a spectator of the match would receive to a replay file, see Replay.hpp for the layout
+//The server hands it every broadcast message and one snapshot of every aircraft per tick, it picks the keyframes itself
+class ReplayRecorder
+{
+public:
+	ReplayRecorder();
+	~ReplayRecorder();
+	bool Open(const std::string& path, sf::Time tick_interval);
+	void Close();
+	bool IsOpen() const;
+
+	//A keyframe is written before the first snapshot and then every Replay::kKeyframeInterval ticks
+	bool IsKeyframeDue(sf::Uint32 tick) const;
+	void RecordKeyframe(sf::Uint32 tick, const sf::Packet& initial_state);
+	//The battlefield bottom and every aircraft's rounded position, encoded against the previous snapshot unless it follows a keyframe
+	void RecordSnapshot(float battlefield_bottom, SnapshotPtr snapshot);
+	void RecordMessage(sf::Uint32 tick, const MessageBatch::Message& message);
+
+	std::size_t GetBytesWritten() const;
+
+private:
+	void WriteRecord(Replay::RecordType type, sf::Uint32 tick, const void* data, std::size_t size);
+
+private:
+	std::ofstream m_file;
+	SnapshotPtr m_last_snapshot;
+	sf::Uint32 m_last_keyframe_tick;
+	bool m_has_keyframe;
+	std::size_t m_bytes_written;
+};
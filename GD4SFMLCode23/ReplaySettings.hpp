@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+//Set from the command line, the client then plays this replay instead of showing the title screen
+struct ReplaySettings
+{
+	std::string m_path;
+	//Steps the replay as fast as frames can be drawn, with the same frame time as 1x so every run simulates the same thing
+	bool m_unthrottled = false;
+};
@@ -0,0 +1,177 @@
+#include "SendPriorities.hpp"
+#include "BitStream.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <utility>
+
+namespace
+{
+	//A share is one, divided by 1 + distance over this and multiplied by 1 + velocity change over the other
+	//An aircraft a view away gains a fifth as fast as one alongside, one that turned around at full speed three times as fast
+	const float kPriorityDistance = 256.f;
+	const float kPriorityVelocityChange = 400.f;
+	//Room for the snapshot's counts growing as aircraft are added
+	const std::size_t kSnapshotSlackBits = 16;
+
+	float Length(sf::Vector2f vector)
+	{
+		return std::sqrt(vector.x * vector.x + vector.y * vector.y);
+	}
+}
+
+SendPriorities::Entry::Entry()
+	: m_priority(0.f)
+{
+}
+
+void SendPriorities::Update(const std::vector<VisibleAircraft>& visible, const std::vector<sf::Vector2f>& viewers)
+{
+	std::map<sf::Int32, Entry> entries;
+	for (const VisibleAircraft& aircraft : visible)
+	{
+		float distance = std::numeric_limits<float>::max();
+		for (sf::Vector2f viewer : viewers)
+		{
+			distance = std::min(distance, Length(aircraft.m_position - viewer));
+		}
+		if (viewers.empty())
+		{
+			distance = 0.f;
+		}
+
+		Entry& entry = entries[aircraft.m_identifier];
+		auto itr = m_entries.find(aircraft.m_identifier);
+		if (itr != m_entries.end())
+		{
+			entry = itr->second;
+		}
+
+		//Every tick the aircraft is left out adds another share, so even the least important one gets its turn
+		entry.m_velocity = aircraft.m_velocity;
+		float velocity_change = Length(entry.m_velocity - entry.m_sent_velocity);
+		entry.m_priority += (1.f + velocity_change / kPriorityVelocityChange) / (1.f + distance / kPriorityDistance);
+	}
+	m_entries.swap(entries);
+}
+
+float SendPriorities::GetPriority(sf::Int32 identifier) const
+{
+	auto itr = m_entries.find(identifier);
+	return itr != m_entries.end() ? itr->second.m_priority : 0.f;
+}
+
+void SendPriorities::MarkSent(sf::Int32 identifier)
+{
+	auto itr = m_entries.find(identifier);
+	if (itr != m_entries.end())
+	{
+		itr->second.m_priority = 0.f;
+		itr->second.m_sent_velocity = itr->second.m_velocity;
+	}
+}
+
+void SendPriorities::MarkAllSent()
+{
+	for (auto& entry : m_entries)
+	{
+		entry.second.m_priority = 0.f;
+		entry.second.m_sent_velocity = entry.second.m_velocity;
+	}
+}
+
+SnapshotPtr BuildBudgetedSnapshot(const Snapshot& full, const Snapshot* baseline, const std::vector<sf::Int32>& always_sent, SendPriorities& priorities, std::size_t available_bits)
+{
+	std::shared_ptr<Snapshot> snapshot(new Snapshot());
+	snapshot->m_tick = full.m_tick;
+	std::vector<sf::Int32> sent;
+	std::vector<std::pair<float, sf::Int32>> candidates;
+	for (const auto& aircraft : full.m_aircraft)
+	{
+		const Snapshot::AircraftState* previous = nullptr;
+		if (baseline)
+		{
+			auto itr = baseline->m_aircraft.find(aircraft.first);
+			if (itr != baseline->m_aircraft.end())
+			{
+				previous = &itr->second;
+				snapshot->m_aircraft[aircraft.first] = *previous;
+			}
+		}
+
+		if (std::find(always_sent.begin(), always_sent.end(), aircraft.first) != always_sent.end())
+		{
+			snapshot->m_aircraft[aircraft.first] = aircraft.second;
+			sent.emplace_back(aircraft.first);
+		}
+		else if (!previous || !SameAircraftState(*previous, aircraft.second))
+		{
+			candidates.emplace_back(priorities.GetPriority(aircraft.first), aircraft.first);
+		}
+		else
+		{
+			sent.emplace_back(aircraft.first);
+		}
+	}
+
+	BitWriter delta;
+	WriteSnapshotDelta(delta, baseline, *snapshot);
+	std::size_t used_bits = delta.GetBitCount() + kSnapshotSlackBits;
+
+	//Identifiers are written as wide as the largest one in the delta, which is at most the largest of these
+	sf::Uint32 max_identifier = full.m_aircraft.empty() ? 0 : static_cast<sf::Uint32>(full.m_aircraft.rbegin()->first);
+	if (baseline && !baseline->m_aircraft.empty())
+	{
+		max_identifier = std::max(max_identifier, static_cast<sf::Uint32>(baseline->m_aircraft.rbegin()->first));
+	}
+	unsigned int identifier_bits = BitsRequired(max_identifier);
+
+	//Whatever is owed most goes first, a smaller update further down can still use up what is left
+	std::sort(candidates.begin(), candidates.end(), std::greater<std::pair<float, sf::Int32>>());
+	std::vector<sf::Int32> chosen;
+	for (const auto& candidate : candidates)
+	{
+		const Snapshot::AircraftState& state = full.m_aircraft.at(candidate.second);
+		auto previous = snapshot->m_aircraft.find(candidate.second);
+		std::size_t bits = identifier_bits + GetAircraftStateBits(previous != snapshot->m_aircraft.end() ? &previous->second : nullptr, state);
+		if (used_bits + bits > available_bits)
+		{
+			continue;
+		}
+		used_bits += bits;
+		snapshot->m_aircraft[candidate.second] = state;
+		chosen.emplace_back(candidate.second);
+	}
+
+	//The estimate is a little generous, but if it was not enough the least owed of the chosen give way
+	for (;;)
+	{
+		delta = BitWriter();
+		WriteSnapshotDelta(delta, baseline, *snapshot);
+		if (delta.GetBitCount() <= available_bits || chosen.empty())
+		{
+			break;
+		}
+
+		sf::Int32 identifier = chosen.back();
+		chosen.pop_back();
+		auto previous = baseline ? baseline->m_aircraft.find(identifier) : snapshot->m_aircraft.end();
+		if (baseline && previous != baseline->m_aircraft.end())
+		{
+			snapshot->m_aircraft[identifier] = previous->second;
+		}
+		else
+		{
+			snapshot->m_aircraft.erase(identifier);
+		}
+	}
+
+	sent.insert(sent.end(), chosen.begin(), chosen.end());
+	for (sf::Int32 identifier : sent)
+	{
+		priorities.MarkSent(identifier);
+	}
+	return snapshot;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+#include "Snapshot.hpp"
+
+//How much one peer is owed an update about each aircraft it can see
+//Every tick an aircraft is not sent adds to its share, more for one close to the peer's own aircraft or one that changed course
+class SendPriorities
+{
+public:
+	struct VisibleAircraft
+	{
+		sf::Int32 m_identifier;
+		sf::Vector2f m_position;
+		sf::Vector2f m_velocity;
+	};
+
+public:
+	//Aircraft missing from visible are forgotten, they start from nothing if they come back
+	//Distances are measured from the nearest viewer, the peer's own aircraft, and without any every aircraft is weighed the same
+	void Update(const std::vector<VisibleAircraft>& visible, const std::vector<sf::Vector2f>& viewers);
+	float GetPriority(sf::Int32 identifier) const;
+	void MarkSent(sf::Int32 identifier);
+	void MarkAllSent();
+
+private:
+	struct Entry
+	{
+		Entry();
+		float m_priority;
+		sf::Vector2f m_velocity;
+		sf::Vector2f m_sent_velocity;
+	};
+
+private:
+	std::map<sf::Int32, Entry> m_entries;
+};
+
+//The aircraft in always_sent, then the ones owed most until available_bits is spent, are marked sent
+//The rest keep their baseline state so the delta says nothing about them, one the peer has never been sent stays out altogether
+SnapshotPtr BuildBudgetedSnapshot(const Snapshot& full, const Snapshot* baseline, const std::vector<sf::Int32>& always_sent, SendPriorities& priorities, std::size_t available_bits);
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <SFML/System/Time.hpp>
+#include "NetworkProtocol.hpp"
+
+//Tunables for a GameServer, shared by the hosted server and the dedicated server executable
+struct ServerSettings
+{
+	unsigned short m_port = SERVER_PORT;
+	sf::Time m_tick_rate = sf::seconds(1.f / 20.f);
+	std::size_t m_max_players = 15;
+	//Unsent bytes a peer may build up before it counts as lagging, four times this drops it
+	std::size_t m_max_queued_bytes = 256 * 1024;
+	//Each peer's snapshot is kept to this many bytes by sending the aircraft that matter most to it first, 0 sends every aircraft
+	std::size_t m_snapshot_byte_budget = 1200;
+	//A room of a MatchHost, stepped on the host's thread pool and given connections by its listener, -1 runs standalone
+	sf::Int32 m_room_identifier = -1;
+	//Records the match to this file for playback in the client, nothing is recorded when it is empty
+	std::string m_replay_path;
+};
@@ -0,0 +1,162 @@
+#include "ServerWorld.hpp"
+#include "NetworkProtocol.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	//Simulation time an aircraft may bank while no input arrives, so a client cannot move faster than real time by sending commands in bursts
+	const sf::Time kMaxInputTime = sf::milliseconds(250);
+	const std::size_t kMaxPendingInput = 64;
+	//Same as the character's fire interval in DataTables
+	const sf::Time kFireInterval = sf::seconds(1.f);
+	//The character texture is 32x32 and drawn centred on the aircraft position
+	const sf::Vector2f kHitboxSize(32.f, 32.f);
+}
+
+ServerWorld::PlayerAircraft::PlayerAircraft()
+	: m_hitpoints(100)
+	, m_missile_ammo(2)
+	, m_aim(0)
+	, m_last_queued_sequence(0)
+	, m_last_input_sequence(0)
+	, m_input_time(sf::Time::Zero)
+	, m_fire_cooldown(sf::Time::Zero)
+{
+}
+
+ServerWorld::ServerWorld(sf::Vector2f battlefield_size, float world_height)
+	: m_world_height(world_height)
+	, m_battlefield_rect(0.f, world_height - battlefield_size.y, battlefield_size.x, battlefield_size.y)
+	, m_scroll_speed(0.f)
+{
+}
+
+void ServerWorld::Update(sf::Time dt)
+{
+	m_battlefield_rect.top += m_scroll_speed * dt.asSeconds();
+
+	for (auto itr = m_aircraft.begin(); itr != m_aircraft.end();)
+	{
+		ConsumeInput(itr->second, dt);
+		itr->second.m_fire_cooldown = std::max(itr->second.m_fire_cooldown - dt, sf::Time::Zero);
+
+		//Remove aircraft that have been destroyed
+		if (itr->second.m_hitpoints <= 0)
+		{
+			m_destroyed_aircraft.emplace_back(itr->first);
+			itr = m_aircraft.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+}
+
+ServerWorld::PlayerAircraft& ServerWorld::AddAircraft(sf::Int32 identifier)
+{
+	PlayerAircraft& aircraft = m_aircraft[identifier];
+	aircraft.m_position = sf::Vector2f(m_battlefield_rect.width / 2, m_battlefield_rect.top + m_battlefield_rect.height / 2);
+	return aircraft;
+}
+
+void ServerWorld::RemoveAircraft(sf::Int32 identifier)
+{
+	m_aircraft.erase(identifier);
+}
+
+ServerWorld::PlayerAircraft* ServerWorld::GetAircraft(sf::Int32 identifier)
+{
+	auto itr = m_aircraft.find(identifier);
+	return itr != m_aircraft.end() ? &itr->second : nullptr;
+}
+
+const ServerWorld::AircraftMap& ServerWorld::GetAllAircraft() const
+{
+	return m_aircraft;
+}
+
+void ServerWorld::QueueInput(sf::Int32 identifier, const InputCommand& command)
+{
+	PlayerAircraft* aircraft = GetAircraft(identifier);
+	if (!aircraft || !Datagram::IsNewer(command.m_sequence, aircraft->m_last_queued_sequence) || aircraft->m_pending_input.size() >= kMaxPendingInput)
+	{
+		return;
+	}
+
+	aircraft->m_pending_input.push_back(command);
+	aircraft->m_last_queued_sequence = command.m_sequence;
+}
+
+bool ServerWorld::TryFire(sf::Int32 identifier)
+{
+	PlayerAircraft* aircraft = GetAircraft(identifier);
+	if (!aircraft || aircraft->m_fire_cooldown > sf::Time::Zero)
+	{
+		return false;
+	}
+
+	aircraft->m_fire_cooldown = kFireInterval;
+	return true;
+}
+
+void ServerWorld::Damage(sf::Int32 identifier, sf::Int32 hitpoints)
+{
+	if (PlayerAircraft* aircraft = GetAircraft(identifier))
+	{
+		aircraft->m_hitpoints -= hitpoints;
+	}
+}
+
+std::vector<sf::Int32> ServerWorld::TakeDestroyedAircraft()
+{
+	std::vector<sf::Int32> destroyed;
+	destroyed.swap(m_destroyed_aircraft);
+	return destroyed;
+}
+
+bool ServerWorld::HasEveryAircraftFinished() const
+{
+	//As long one player has not crossed the finish line game on
+	for (const auto& aircraft : m_aircraft)
+	{
+		if (aircraft.second.m_position.y > 0.f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+const sf::FloatRect& ServerWorld::GetBattlefieldRect() const
+{
+	return m_battlefield_rect;
+}
+
+float ServerWorld::GetWorldHeight() const
+{
+	return m_world_height;
+}
+
+sf::FloatRect ServerWorld::GetHitbox(sf::Vector2f position)
+{
+	return sf::FloatRect(position - kHitboxSize / 2.f, kHitboxSize);
+}
+
+void ServerWorld::ConsumeInput(PlayerAircraft& aircraft, sf::Time dt)
+{
+	//Each step gives the aircraft dt of simulation time to spend on its queued commands
+	aircraft.m_input_time = std::min(aircraft.m_input_time + dt, kMaxInputTime);
+	sf::Vector2f start_position = aircraft.m_position;
+	while (!aircraft.m_pending_input.empty() && aircraft.m_pending_input.front().GetDuration() <= aircraft.m_input_time)
+	{
+		const InputCommand& command = aircraft.m_pending_input.front();
+		aircraft.m_input_time -= command.GetDuration();
+		aircraft.m_position = ApplyInput(aircraft.m_position, command, m_battlefield_rect);
+		aircraft.m_aim = command.m_aim;
+		aircraft.m_last_input_sequence = command.m_sequence;
+		aircraft.m_pending_input.pop_front();
+	}
+	aircraft.m_velocity = (aircraft.m_position - start_position) / dt.asSeconds();
+}
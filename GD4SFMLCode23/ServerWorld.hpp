@@ -0,0 +1,71 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/System/Time.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <deque>
+#include <map>
+#include <vector>
+#include "InputCommand.hpp"
+
+//Graphics free simulation of the battlefield that the server runs at its own fixed step
+//Clients draw what it reports, player aircraft only move by the input commands their owners send
+class ServerWorld
+{
+public:
+	struct PlayerAircraft
+	{
+		PlayerAircraft();
+		sf::Vector2f m_position;
+		//How far the last step's commands moved the aircraft, per second
+		sf::Vector2f m_velocity;
+		sf::Int32 m_hitpoints;
+		sf::Int32 m_missile_ammo;
+		//Taken from the latest applied command, clients turn the sprite to it
+		sf::Uint8 m_aim;
+
+		//Commands waiting for simulation time, and the last one applied
+		std::deque<InputCommand> m_pending_input;
+		sf::Uint32 m_last_queued_sequence;
+		sf::Uint32 m_last_input_sequence;
+		sf::Time m_input_time;
+
+		//Time left before the aircraft may fire again
+		sf::Time m_fire_cooldown;
+	};
+
+	typedef std::map<sf::Int32, PlayerAircraft> AircraftMap;
+
+public:
+	ServerWorld(sf::Vector2f battlefield_size, float world_height);
+	void Update(sf::Time dt);
+
+	PlayerAircraft& AddAircraft(sf::Int32 identifier);
+	void RemoveAircraft(sf::Int32 identifier);
+	PlayerAircraft* GetAircraft(sf::Int32 identifier);
+	const AircraftMap& GetAllAircraft() const;
+
+	//Commands that were already applied or queued are ignored, so clients can resend freely
+	void QueueInput(sf::Int32 identifier, const InputCommand& command);
+	//False while the aircraft is still reloading, otherwise starts its cooldown
+	bool TryFire(sf::Int32 identifier);
+	void Damage(sf::Int32 identifier, sf::Int32 hitpoints);
+	//Aircraft that ran out of hitpoints since the last call, they are already gone from the world
+	std::vector<sf::Int32> TakeDestroyedAircraft();
+	bool HasEveryAircraftFinished() const;
+
+	const sf::FloatRect& GetBattlefieldRect() const;
+	float GetWorldHeight() const;
+	static sf::FloatRect GetHitbox(sf::Vector2f position);
+
+private:
+	void ConsumeInput(PlayerAircraft& aircraft, sf::Time dt);
+
+private:
+	float m_world_height;
+	sf::FloatRect m_battlefield_rect;
+	float m_scroll_speed;
+	AircraftMap m_aircraft;
+	std::vector<sf::Int32> m_destroyed_aircraft;
+};
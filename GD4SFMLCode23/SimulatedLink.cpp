@@ -0,0 +1,120 @@
+#include "SimulatedLink.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	//A lost segment holds up everything behind it until it is sent again
+	const sf::Time kRetransmitDelay = sf::milliseconds(200);
+	//How far a reordered datagram falls behind the ones sent after it
+	const sf::Time kReorderDelay = sf::milliseconds(30);
+	//Datagrams that would wait longer than this for the bandwidth are dropped, like a router with a full buffer
+	const sf::Time kMaxQueueDelay = sf::milliseconds(250);
+}
+
+bool SimulatedLink::InFlight::operator>(const InFlight& other) const
+{
+	return m_arrival > other.m_arrival || (m_arrival == other.m_arrival && m_order > other.m_order);
+}
+
+SimulatedLink::SimulatedLink(bool is_stream)
+	: m_is_stream(is_stream)
+	, m_next_order(0)
+	, m_link_free_time(sf::Time::Zero)
+	, m_last_arrival(sf::Time::Zero)
+	, m_delivered_count(0)
+	, m_dropped_count(0)
+	, m_delivered_bytes(0)
+{
+}
+
+void SimulatedLink::SetConditions(const LinkConditions& conditions)
+{
+	m_conditions = conditions;
+}
+
+void SimulatedLink::Push(const Packet& packet, sf::Time now, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> chance(0.f, 1.f);
+	bool lost = chance(random) < m_conditions.m_loss;
+	if (lost && !m_is_stream)
+	{
+		++m_dropped_count;
+		return;
+	}
+
+	//The bandwidth cap serialises packets one after another, each arrives once its last bit has crossed
+	sf::Time sent = now;
+	if (m_conditions.m_bandwidth > 0)
+	{
+		sent = std::max(now, m_link_free_time);
+		if (!m_is_stream && sent - now > kMaxQueueDelay)
+		{
+			++m_dropped_count;
+			return;
+		}
+		sent += sf::microseconds(static_cast<sf::Int64>(packet->size()) * 8 * 1000000 / static_cast<sf::Int64>(m_conditions.m_bandwidth));
+		m_link_free_time = sent;
+	}
+
+	sf::Time arrival = sent + m_conditions.m_latency;
+	if (m_conditions.m_jitter > sf::Time::Zero)
+	{
+		std::uniform_int_distribution<sf::Int64> jitter(0, m_conditions.m_jitter.asMicroseconds());
+		arrival += sf::microseconds(jitter(random));
+	}
+
+	if (m_is_stream)
+	{
+		if (lost)
+		{
+			arrival += kRetransmitDelay;
+		}
+		//Jitter cannot reorder a stream, a late segment holds back the ones behind it
+		arrival = std::max(arrival, m_last_arrival);
+		m_last_arrival = arrival;
+	}
+	else if (chance(random) < m_conditions.m_reorder)
+	{
+		arrival += kReorderDelay;
+	}
+
+	m_in_flight.push(InFlight{ arrival, m_next_order++, packet });
+}
+
+void SimulatedLink::Pop(sf::Time now, std::vector<Packet>& ready)
+{
+	while (!m_in_flight.empty() && m_in_flight.top().m_arrival <= now)
+	{
+		const Packet& packet = m_in_flight.top().m_packet;
+		++m_delivered_count;
+		m_delivered_bytes += packet->size();
+		ready.emplace_back(packet);
+		m_in_flight.pop();
+	}
+}
+
+bool SimulatedLink::IsEmpty() const
+{
+	return m_in_flight.empty();
+}
+
+sf::Time SimulatedLink::GetNextArrival() const
+{
+	return m_in_flight.empty() ? sf::Time::Zero : m_in_flight.top().m_arrival;
+}
+
+std::size_t SimulatedLink::GetDeliveredCount() const
+{
+	return m_delivered_count;
+}
+
+std::size_t SimulatedLink::GetDroppedCount() const
+{
+	return m_dropped_count;
+}
+
+std::size_t SimulatedLink::GetDeliveredBytes() const
+{
+	return m_delivered_bytes;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <queue>
+#include <random>
+#include <vector>
+#include "NetworkConditions.hpp"
+#include "OutboundQueue.hpp"
+
+//One direction of a simulated connection, packets go in as they are read and come out when they would have arrived
+//A stream link keeps its bytes in order and never loses them, a datagram link drops, reorders and overflows its queue
+class SimulatedLink
+{
+public:
+	typedef OutboundQueue::Buffer Packet;
+
+public:
+	explicit SimulatedLink(bool is_stream);
+	void SetConditions(const LinkConditions& conditions);
+	void Push(const Packet& packet, sf::Time now, std::mt19937& random);
+	//Moves every packet that has arrived by now into ready, in the order they arrive
+	void Pop(sf::Time now, std::vector<Packet>& ready);
+	bool IsEmpty() const;
+	sf::Time GetNextArrival() const;
+
+	std::size_t GetDeliveredCount() const;
+	std::size_t GetDroppedCount() const;
+	std::size_t GetDeliveredBytes() const;
+
+private:
+	struct InFlight
+	{
+		sf::Time m_arrival;
+		//Packets arriving at the same time keep the order they were sent in
+		std::size_t m_order;
+		Packet m_packet;
+
+		bool operator>(const InFlight& other) const;
+	};
+
+private:
+	bool m_is_stream;
+	LinkConditions m_conditions;
+	std::priority_queue<InFlight, std::vector<InFlight>, std::greater<InFlight>> m_in_flight;
+	std::size_t m_next_order;
+	//When the bandwidth cap lets the next packet start, and the latest arrival so far for streams
+	sf::Time m_link_free_time;
+	sf::Time m_last_arrival;
+
+	std::size_t m_delivered_count;
+	std::size_t m_dropped_count;
+	std::size_t m_delivered_bytes;
+};
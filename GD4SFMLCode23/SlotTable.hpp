@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//Owns objects under a slot id that stays the same for as long as the object lives, adding and removing are O(1)
+//The live objects are also kept packed, so walking them never touches an empty slot
+template <typename T>
+class SlotTable
+{
+public:
+	typedef std::unique_ptr<T> Ptr;
+	typedef typename std::vector<T*>::const_iterator ConstIterator;
+
+public:
+	std::size_t Add(Ptr object);
+	//Hands the object back, its slot id may be given to the next object added
+	//nullptr and no change for a slot that is already empty
+	Ptr Remove(std::size_t slot);
+	//nullptr for a slot that is empty or was never used
+	T* Get(std::size_t slot) const;
+	std::size_t GetSize() const;
+	bool IsEmpty() const;
+
+	ConstIterator begin() const;
+	ConstIterator end() const;
+
+private:
+	std::vector<Ptr> m_slots;
+	std::vector<std::size_t> m_free_slots;
+	//Live objects packed together, the slot each came from, and where each slot's object sits in the packed list
+	std::vector<T*> m_live;
+	std::vector<std::size_t> m_live_slots;
+	std::vector<std::size_t> m_live_index;
+};
+
+#include "SlotTable.inl"
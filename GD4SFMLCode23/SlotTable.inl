@@ -0,0 +1,75 @@
+#include "SlotTable.hpp"
+
+template <typename T>
+std::size_t SlotTable<T>::Add(Ptr object)
+{
+    std::size_t slot;
+    if (m_free_slots.empty())
+    {
+        slot = m_slots.size();
+        m_slots.emplace_back();
+        m_live_index.emplace_back(0);
+    }
+    else
+    {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+    }
+
+    m_live_index[slot] = m_live.size();
+    m_live.emplace_back(object.get());
+    m_live_slots.emplace_back(slot);
+    m_slots[slot] = std::move(object);
+    return slot;
+}
+
+template <typename T>
+typename SlotTable<T>::Ptr SlotTable<T>::Remove(std::size_t slot)
+{
+    //Removing an empty slot again would put it on the free list twice and hand it to two objects
+    if (!Get(slot))
+    {
+        return Ptr();
+    }
+
+    //Move the last live object into the hole so the packed list stays packed
+    std::size_t index = m_live_index[slot];
+    m_live[index] = m_live.back();
+    m_live_slots[index] = m_live_slots.back();
+    m_live_index[m_live_slots[index]] = index;
+    m_live.pop_back();
+    m_live_slots.pop_back();
+
+    m_free_slots.emplace_back(slot);
+    return std::move(m_slots[slot]);
+}
+
+template <typename T>
+T* SlotTable<T>::Get(std::size_t slot) const
+{
+    return slot < m_slots.size() ? m_slots[slot].get() : nullptr;
+}
+
+template <typename T>
+std::size_t SlotTable<T>::GetSize() const
+{
+    return m_live.size();
+}
+
+template <typename T>
+bool SlotTable<T>::IsEmpty() const
+{
+    return m_live.empty();
+}
+
+template <typename T>
+typename SlotTable<T>::ConstIterator SlotTable<T>::begin() const
+{
+    return m_live.begin();
+}
+
+template <typename T>
+typename SlotTable<T>::ConstIterator SlotTable<T>::end() const
+{
+    return m_live.end();
+}
@@ -0,0 +1,197 @@
+#include "Snapshot.hpp"
+#include "BitStream.hpp"
+#include "InputCommand.hpp"
+#include "NetworkProtocol.hpp"
+#include "PositionCodec.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	//Enough to reach back over the whole history ring
+	const unsigned int kBaselineOffsetBits = 6;
+	static_assert(SnapshotBuffer::kCapacity < (1u << kBaselineOffsetBits), "Baseline offset field is too narrow for the history ring");
+
+	void WriteAircraftState(BitWriter& writer, const Snapshot::AircraftState* previous, const Snapshot::AircraftState& current)
+	{
+		//Aircraft the client already knows about usually only moved a little
+		if (previous)
+		{
+			PositionCodec::WriteDelta(writer, previous->m_position, current.m_position);
+			writer.WriteBool(current.m_aim != previous->m_aim);
+			if (current.m_aim != previous->m_aim)
+			{
+				writer.Write(current.m_aim, InputCommand::kAimBits);
+			}
+		}
+		else
+		{
+			PositionCodec::Write(writer, current.m_position);
+			writer.Write(current.m_aim, InputCommand::kAimBits);
+		}
+	}
+}
+
+Snapshot::AircraftState::AircraftState()
+	: m_aim(0)
+{
+}
+
+Snapshot::Snapshot()
+	: m_tick(0)
+{
+}
+
+SnapshotBuffer::SnapshotBuffer()
+	: m_snapshots(kCapacity)
+{
+}
+
+void SnapshotBuffer::Insert(SnapshotPtr snapshot)
+{
+	m_snapshots[snapshot->m_tick % kCapacity] = snapshot;
+}
+
+SnapshotPtr SnapshotBuffer::Find(sf::Uint32 tick) const
+{
+	const SnapshotPtr& snapshot = m_snapshots[tick % kCapacity];
+	if (tick != 0 && snapshot && snapshot->m_tick == tick)
+	{
+		return snapshot;
+	}
+	return nullptr;
+}
+
+void SnapshotBuffer::Clear()
+{
+	m_snapshots.assign(kCapacity, nullptr);
+}
+
+void WriteSnapshotDelta(BitWriter& writer, const Snapshot* baseline, const Snapshot& current)
+{
+	writer.Write(current.m_tick, 32);
+	writer.Write(baseline ? current.m_tick - baseline->m_tick : 0, kBaselineOffsetBits);
+
+	//Only aircraft that are new or moved since the baseline are written
+	std::vector<std::pair<sf::Int32, const Snapshot::AircraftState*>> changed;
+	sf::Uint32 max_identifier = 0;
+	for (const auto& aircraft : current.m_aircraft)
+	{
+		if (baseline)
+		{
+			auto itr = baseline->m_aircraft.find(aircraft.first);
+			if (itr != baseline->m_aircraft.end() && SameAircraftState(itr->second, aircraft.second))
+			{
+				continue;
+			}
+		}
+		changed.emplace_back(aircraft.first, &aircraft.second);
+		max_identifier = std::max(max_identifier, static_cast<sf::Uint32>(aircraft.first));
+	}
+
+	//Aircraft the baseline had that are gone now
+	std::vector<sf::Int32> removed;
+	if (baseline)
+	{
+		for (const auto& aircraft : baseline->m_aircraft)
+		{
+			if (current.m_aircraft.find(aircraft.first) == current.m_aircraft.end())
+			{
+				removed.emplace_back(aircraft.first);
+				max_identifier = std::max(max_identifier, static_cast<sf::Uint32>(aircraft.first));
+			}
+		}
+	}
+
+	//Identifiers are small, so they are written only as wide as the largest one in this snapshot
+	unsigned int identifier_bits = BitsRequired(max_identifier);
+	writer.Write(identifier_bits - 1, Datagram::kIdentifierWidthBits);
+
+	writer.WriteCompact(static_cast<sf::Uint32>(changed.size()));
+	for (const auto& aircraft : changed)
+	{
+		writer.Write(static_cast<sf::Uint32>(aircraft.first), identifier_bits);
+
+		const Snapshot::AircraftState* previous = nullptr;
+		if (baseline)
+		{
+			auto itr = baseline->m_aircraft.find(aircraft.first);
+			if (itr != baseline->m_aircraft.end())
+			{
+				previous = &itr->second;
+			}
+		}
+		WriteAircraftState(writer, previous, *aircraft.second);
+	}
+
+	writer.WriteCompact(static_cast<sf::Uint32>(removed.size()));
+	for (sf::Int32 identifier : removed)
+	{
+		writer.Write(static_cast<sf::Uint32>(identifier), identifier_bits);
+	}
+}
+
+bool ReadSnapshotHeader(BitReader& reader, sf::Uint32& tick, sf::Uint32& baseline_tick)
+{
+	tick = reader.Read(32);
+	sf::Uint32 baseline_offset = reader.Read(kBaselineOffsetBits);
+	baseline_tick = baseline_offset != 0 ? tick - baseline_offset : 0;
+	return reader.IsValid();
+}
+
+bool ReadSnapshotDelta(BitReader& reader, const Snapshot* baseline, Snapshot& current, std::vector<sf::Int32>* written)
+{
+	//Start from the baseline and apply what changed on top of it
+	if (baseline)
+	{
+		current.m_aircraft = baseline->m_aircraft;
+	}
+
+	unsigned int identifier_bits = reader.Read(Datagram::kIdentifierWidthBits) + 1;
+
+	sf::Uint32 changed_count = reader.ReadCompact();
+	for (sf::Uint32 i = 0; i < changed_count && reader.IsValid(); ++i)
+	{
+		sf::Int32 identifier = static_cast<sf::Int32>(reader.Read(identifier_bits));
+		auto itr = baseline ? baseline->m_aircraft.find(identifier) : current.m_aircraft.end();
+		Snapshot::AircraftState& state = current.m_aircraft[identifier];
+		if (baseline && itr != baseline->m_aircraft.end())
+		{
+			state.m_position = PositionCodec::ReadDelta(reader, itr->second.m_position);
+			if (reader.ReadBool())
+			{
+				state.m_aim = static_cast<sf::Uint8>(reader.Read(InputCommand::kAimBits));
+			}
+		}
+		else
+		{
+			state.m_position = PositionCodec::Read(reader);
+			state.m_aim = static_cast<sf::Uint8>(reader.Read(InputCommand::kAimBits));
+		}
+
+		if (written)
+		{
+			written->emplace_back(identifier);
+		}
+	}
+
+	sf::Uint32 removed_count = reader.ReadCompact();
+	for (sf::Uint32 i = 0; i < removed_count && reader.IsValid(); ++i)
+	{
+		current.m_aircraft.erase(static_cast<sf::Int32>(reader.Read(identifier_bits)));
+	}
+
+	return reader.IsValid();
+}
+
+bool SameAircraftState(const Snapshot::AircraftState& lhs, const Snapshot::AircraftState& rhs)
+{
+	return lhs.m_position == rhs.m_position && lhs.m_aim == rhs.m_aim;
+}
+
+std::size_t GetAircraftStateBits(const Snapshot::AircraftState* previous, const Snapshot::AircraftState& current)
+{
+	BitWriter writer;
+	WriteAircraftState(writer, previous, current);
+	return writer.GetBitCount();
+}
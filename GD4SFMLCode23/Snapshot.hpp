@@ -0,0 +1,58 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <vector>
+
+class BitWriter;
+class BitReader;
+
+//What a client knows about every aircraft at one server tick
+struct Snapshot
+{
+	struct AircraftState
+	{
+		AircraftState();
+		//Always a value PositionCodec can represent exactly, so both ends agree on what changed
+		sf::Vector2f m_position;
+		//From the owner's latest input, see InputCommand::QuantizeAim
+		sf::Uint8 m_aim;
+	};
+
+	Snapshot();
+	sf::Uint32 m_tick;
+	std::map<sf::Int32, AircraftState> m_aircraft;
+};
+
+typedef std::shared_ptr<const Snapshot> SnapshotPtr;
+
+//Ring of the most recent snapshots, looked up by tick
+class SnapshotBuffer
+{
+public:
+	static const sf::Uint32 kCapacity = 32;
+
+public:
+	SnapshotBuffer();
+	void Insert(SnapshotPtr snapshot);
+	SnapshotPtr Find(sf::Uint32 tick) const;
+	void Clear();
+
+private:
+	std::vector<SnapshotPtr> m_snapshots;
+};
+
+//A baseline tick of 0 means the snapshot is not a delta and carries every aircraft
+//The baseline must be one of the last kCapacity ticks before the current one
+void WriteSnapshotDelta(BitWriter& writer, const Snapshot* baseline, const Snapshot& current);
+bool ReadSnapshotHeader(BitReader& reader, sf::Uint32& tick, sf::Uint32& baseline_tick);
+//Written lists the aircraft the delta carried in identifier order, the others were copied from the baseline
+bool ReadSnapshotDelta(BitReader& reader, const Snapshot* baseline, Snapshot& current, std::vector<sf::Int32>* written = nullptr);
+
+//An aircraft in the same state as in the baseline is left out of the delta
+bool SameAircraftState(const Snapshot::AircraftState& lhs, const Snapshot::AircraftState& rhs);
+//What WriteSnapshotDelta spends on one aircraft apart from its identifier, previous is its baseline state if it has one
+std::size_t GetAircraftStateBits(const Snapshot::AircraftState* previous, const Snapshot::AircraftState& current);
@@ -0,0 +1,106 @@
+#include "SocketPoller.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	//Most sockets reported by one wait, any others are still readable on the next one
+	const int kMaxEvents = 256;
+}
+
+#ifdef __linux__
+
+SocketPoller::SocketPoller()
+	: m_epoll(epoll_create1(0))
+{
+}
+
+SocketPoller::~SocketPoller()
+{
+	if (m_epoll >= 0)
+	{
+		close(m_epoll);
+	}
+}
+
+void SocketPoller::Add(sf::Socket&, sf::SocketHandle handle, std::size_t key)
+{
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.u64 = key;
+	epoll_ctl(m_epoll, EPOLL_CTL_ADD, handle, &event);
+}
+
+void SocketPoller::Remove(sf::Socket&, sf::SocketHandle handle)
+{
+	epoll_ctl(m_epoll, EPOLL_CTL_DEL, handle, nullptr);
+}
+
+void SocketPoller::Wait(sf::Time timeout)
+{
+	//Round up so a wait shorter than a millisecond still sleeps instead of spinning
+	int timeout_ms = static_cast<int>((timeout.asMicroseconds() + 999) / 1000);
+	epoll_event events[kMaxEvents];
+	int count = epoll_wait(m_epoll, events, kMaxEvents, std::max(timeout_ms, 0));
+
+	m_ready.clear();
+	for (int i = 0; i < count; ++i)
+	{
+		m_ready.emplace_back(static_cast<std::size_t>(events[i].data.u64));
+	}
+}
+
+#else
+
+SocketPoller::SocketPoller()
+{
+}
+
+SocketPoller::~SocketPoller()
+{
+}
+
+void SocketPoller::Add(sf::Socket& socket, sf::SocketHandle handle, std::size_t key)
+{
+	m_selector.add(socket);
+	m_sockets[handle] = std::make_pair(&socket, key);
+}
+
+void SocketPoller::Remove(sf::Socket& socket, sf::SocketHandle handle)
+{
+	m_selector.remove(socket);
+	m_sockets.erase(handle);
+}
+
+void SocketPoller::Wait(sf::Time timeout)
+{
+	//A zero timeout would make the selector wait forever
+	m_ready.clear();
+	if (m_selector.wait(std::max(timeout, sf::microseconds(1))))
+	{
+		for (const auto& socket : m_sockets)
+		{
+			if (m_selector.isReady(*socket.second.first) && m_ready.size() < static_cast<std::size_t>(kMaxEvents))
+			{
+				m_ready.emplace_back(socket.second.second);
+			}
+		}
+	}
+}
+
+#endif
+
+const std::vector<std::size_t>& SocketPoller::GetReady() const
+{
+	return m_ready;
+}
+
+bool SocketPoller::IsReady(std::size_t key) const
+{
+	return std::find(m_ready.begin(), m_ready.end(), key) != m_ready.end();
+}
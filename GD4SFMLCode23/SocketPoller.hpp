@@ -0,0 +1,59 @@
+#pragma once
+#include <SFML/Network/Socket.hpp>
+#include <SFML/Network/SocketHandle.hpp>
+#include <SFML/Network/SocketSelector.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+//SFML keeps a socket's native handle protected, this exposes it so the socket can be registered with a SocketPoller
+template <typename Socket>
+class Pollable : public Socket
+{
+public:
+	using Socket::getHandle;
+};
+
+//Waits on many sockets at once and reports the readable ones by the key each was added with
+//On Linux this is epoll, so a wait costs the same with hundreds of sockets as with a few, elsewhere it falls back to sf::SocketSelector
+class SocketPoller
+{
+public:
+	SocketPoller();
+	~SocketPoller();
+
+	template <typename Socket>
+	void Add(Pollable<Socket>& socket, std::size_t key)
+	{
+		Add(socket, socket.getHandle(), key);
+	}
+
+	//Remove sockets before closing them, the handle is how they are found
+	template <typename Socket>
+	void Remove(Pollable<Socket>& socket)
+	{
+		Remove(socket, socket.getHandle());
+	}
+
+	//Blocks until a socket is readable or the timeout passes, a zero timeout only checks
+	void Wait(sf::Time timeout);
+	//Keys of the sockets found readable by the last wait
+	const std::vector<std::size_t>& GetReady() const;
+	bool IsReady(std::size_t key) const;
+
+private:
+	void Add(sf::Socket& socket, sf::SocketHandle handle, std::size_t key);
+	void Remove(sf::Socket& socket, sf::SocketHandle handle);
+
+private:
+#ifdef __linux__
+	int m_epoll;
+#else
+	sf::SocketSelector m_selector;
+	std::map<sf::SocketHandle, std::pair<sf::Socket*, std::size_t>> m_sockets;
+#endif
+	std::vector<std::size_t> m_ready;
+};
@@ -10,5 +10,6 @@ enum class StateID
 	kGameOver,
 	kHostGame,
 	kNetworkPause,
-	kJoinGame
+	kJoinGame,
+	kReplay
 };
\ No newline at end of file
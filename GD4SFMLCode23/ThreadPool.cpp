@@ -0,0 +1,64 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t thread_count)
+	: m_stopping(false)
+{
+	if (thread_count == 0)
+	{
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (std::size_t i = 0; i < thread_count; ++i)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerThread, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_task_available.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit(Task task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.emplace_back(std::move(task));
+	}
+	m_task_available.notify_one();
+}
+
+std::size_t ThreadPool::GetThreadCount() const
+{
+	return m_workers.size();
+}
+
+void ThreadPool::WorkerThread()
+{
+	while (true)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_task_available.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			if (m_tasks.empty())
+			{
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A fixed set of worker threads running queued tasks in the order they were submitted
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+public:
+	//Zero means one worker per hardware thread
+	explicit ThreadPool(std::size_t thread_count = 0);
+	//Tasks already queued are still run before the workers stop
+	~ThreadPool();
+	void Submit(Task task);
+	std::size_t GetThreadCount() const;
+
+private:
+	void WorkerThread();
+
+private:
+	std::vector<std::thread> m_workers;
+	std::deque<Task> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_task_available;
+	bool m_stopping;
+};
@@ -0,0 +1,49 @@
+#include "TickScheduler.hpp"
+
+TickScheduler::TickScheduler(sf::Time period, unsigned int max_catch_up)
+	: m_period(period)
+	, m_next_deadline(sf::Time::Zero)
+	, m_max_catch_up(max_catch_up > 0 ? max_catch_up : 1)
+	, m_skipped_count(0)
+{
+}
+
+void TickScheduler::Reset(sf::Time now)
+{
+	m_next_deadline = now + m_period;
+}
+
+bool TickScheduler::Consume(sf::Time now)
+{
+	if (now < m_next_deadline)
+	{
+		return false;
+	}
+
+	//Steps owed besides this one, anything past the catch-up limit is given up
+	sf::Int64 behind = (now - m_next_deadline).asMicroseconds() / m_period.asMicroseconds();
+	if (behind >= m_max_catch_up)
+	{
+		sf::Int64 skipped = behind - m_max_catch_up + 1;
+		m_skipped_count += static_cast<std::size_t>(skipped);
+		m_next_deadline += m_period * skipped;
+	}
+
+	m_next_deadline += m_period;
+	return true;
+}
+
+sf::Time TickScheduler::GetPeriod() const
+{
+	return m_period;
+}
+
+sf::Time TickScheduler::GetNextDeadline() const
+{
+	return m_next_deadline;
+}
+
+std::size_t TickScheduler::GetSkippedCount() const
+{
+	return m_skipped_count;
+}
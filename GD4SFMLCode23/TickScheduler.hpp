@@ -0,0 +1,26 @@
+#pragma once
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+
+//Runs a fixed step against deadlines, so a pass that starts late does not push every later step back with it
+//After a stall it runs at most max_catch_up steps back to back and drops the rest, a burst of catch-up steps would only fall further behind
+class TickScheduler
+{
+public:
+	TickScheduler(sf::Time period, unsigned int max_catch_up);
+	void Reset(sf::Time now);
+	//True if a step is due by now, the deadline then moves on by one period
+	bool Consume(sf::Time now);
+
+	sf::Time GetPeriod() const;
+	sf::Time GetNextDeadline() const;
+	//Steps dropped because the scheduler was too far behind
+	std::size_t GetSkippedCount() const;
+
+private:
+	sf::Time m_period;
+	sf::Time m_next_deadline;
+	unsigned int m_max_catch_up;
+	std::size_t m_skipped_count;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <SFML/System/Time.hpp>
+
+#include <cstddef>
+#include <vector>
+
+//Timers bucketed by when they fire, scheduling is O(1) and advancing only visits the buckets that have come due
+//A timer more than one turn of the wheel away waits in its bucket until the turn it is due on
+template <typename T>
+class TimerWheel
+{
+public:
+	TimerWheel(sf::Time resolution, std::size_t slot_count);
+	//A time already past fires on the next advance
+	void Schedule(sf::Time when, const T& value);
+	//Moves every timer due by now into expired
+	void Advance(sf::Time now, std::vector<T>& expired);
+	std::size_t GetSize() const;
+
+private:
+	struct Timer
+	{
+		sf::Time m_when;
+		T m_value;
+	};
+
+private:
+	sf::Int64 GetTick(sf::Time time) const;
+
+private:
+	sf::Time m_resolution;
+	std::vector<std::vector<Timer>> m_slots;
+	//Every tick before this one has been advanced past
+	sf::Int64 m_current_tick;
+	std::size_t m_size;
+};
+
+#include "TimerWheel.inl"
@@ -0,0 +1,63 @@
+#include "TimerWheel.hpp"
+#include <algorithm>
+#include <cassert>
+
+template <typename T>
+TimerWheel<T>::TimerWheel(sf::Time resolution, std::size_t slot_count)
+    : m_resolution(resolution)
+    , m_slots(slot_count)
+    , m_current_tick(0)
+    , m_size(0)
+{
+    assert(resolution > sf::Time::Zero && slot_count > 0);
+}
+
+template <typename T>
+void TimerWheel<T>::Schedule(sf::Time when, const T& value)
+{
+    sf::Int64 tick = std::max(GetTick(when), m_current_tick);
+    m_slots[tick % m_slots.size()].push_back(Timer{ when, value });
+    ++m_size;
+}
+
+template <typename T>
+void TimerWheel<T>::Advance(sf::Time now, std::vector<T>& expired)
+{
+    sf::Int64 target_tick = GetTick(now);
+    if (target_tick < m_current_tick)
+    {
+        return;
+    }
+
+    //A long gap visits each slot once, not once per tick that passed
+    sf::Int64 visits = std::min(target_tick - m_current_tick + 1, static_cast<sf::Int64>(m_slots.size()));
+    for (sf::Int64 i = 0; i < visits; ++i)
+    {
+        std::vector<Timer>& slot = m_slots[(m_current_tick + i) % m_slots.size()];
+        auto due = std::partition(slot.begin(), slot.end(), [now](const Timer& timer)
+        {
+            return timer.m_when > now;
+        });
+        for (auto itr = due; itr != slot.end(); ++itr)
+        {
+            expired.push_back(itr->m_value);
+        }
+        m_size -= static_cast<std::size_t>(slot.end() - due);
+        slot.erase(due, slot.end());
+    }
+
+    //The current tick's slot is visited again next time, timers later in this tick may still be added to it
+    m_current_tick = target_tick;
+}
+
+template <typename T>
+std::size_t TimerWheel<T>::GetSize() const
+{
+    return m_size;
+}
+
+template <typename T>
+sf::Int64 TimerWheel<T>::GetTick(sf::Time time) const
+{
+    return time.asMicroseconds() / m_resolution.asMicroseconds();
+}
@@ -4,21 +4,9 @@
 #include <cassert>
 
 #include <cmath>
-#include <random>
 
 #include "Animation.hpp"
 
-namespace
-{
-	std::default_random_engine CreateRandomEngine()
-	{
-		auto seed = static_cast<unsigned long>(std::time(nullptr));
-		return std::default_random_engine(seed);
-	}
-
-	auto RandomEngine = CreateRandomEngine();
-}
-
 void Utility::CentreOrigin(sf::Sprite& sprite)
 {
 	sf::FloatRect bounds = sprite.getLocalBounds();
@@ -143,31 +131,3 @@ std::string Utility::toString(sf::Keyboard::Key key)
 
 	return "";
 }
-
-double Utility::ToRadians(int degrees)
-{
-	return (degrees*M_PI)/180;
-}
-
-double Utility::ToDegrees(double angle)
-{
-	return angle * (180 / M_PI);
-}
-
-
-sf::Vector2f Utility::UnitVector(sf::Vector2f vector)
-{
-	assert(vector != sf::Vector2f(0.f, 0.f));
-	return vector / Length(vector);
-}
-
-float Utility::Length(sf::Vector2f vector)
-{
-	return sqrtf(powf(vector.x, 2) + powf(vector.y, 2));
-}
-
-int Utility::RandomInt(int exclusiveMax)
-{
-	std::uniform_int_distribution<> distr(0, exclusiveMax - 1);
-	return distr(RandomEngine);
-}
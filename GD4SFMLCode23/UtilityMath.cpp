@@ -0,0 +1,50 @@
+#include "Utility.hpp"
+#include <cassert>
+
+#include <cmath>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <thread>
+
+//The helpers in this file only depend on sfml-system so the dedicated server can link them without the graphics module
+
+namespace
+{
+	//Every thread gets its own engine, servers sharing a thread pool call RandomInt at the same time
+	std::default_random_engine CreateRandomEngine()
+	{
+		auto seed = static_cast<unsigned long>(std::time(nullptr)) ^ static_cast<unsigned long>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		return std::default_random_engine(seed);
+	}
+
+	thread_local auto RandomEngine = CreateRandomEngine();
+}
+
+double Utility::ToRadians(int degrees)
+{
+	return (degrees*M_PI)/180;
+}
+
+double Utility::ToDegrees(double angle)
+{
+	return angle * (180 / M_PI);
+}
+
+
+sf::Vector2f Utility::UnitVector(sf::Vector2f vector)
+{
+	assert(vector != sf::Vector2f(0.f, 0.f));
+	return vector / Length(vector);
+}
+
+float Utility::Length(sf::Vector2f vector)
+{
+	return sqrtf(powf(vector.x, 2) + powf(vector.y, 2));
+}
+
+int Utility::RandomInt(int exclusiveMax)
+{
+	std::uniform_int_distribution<> distr(0, exclusiveMax - 1);
+	return distr(RandomEngine);
+}
@@ -1,14 +1,36 @@
 #include <SFML/Graphics.hpp>
 #include "Application.hpp"
+#include "ReplaySettings.hpp"
 #include "ResourceHolder.hpp"
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main()
+//Usage: GD4SFMLCode23 [--replay FILE [--unthrottled]]
+int main(int argc, char* argv[])
 {
+	ReplaySettings replay;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (argument == "--replay" && i + 1 < argc)
+		{
+			replay.m_path = argv[++i];
+		}
+		else if (argument == "--unthrottled")
+		{
+			replay.m_unthrottled = true;
+		}
+		else
+		{
+			std::cout << "Usage: GD4SFMLCode23 [--replay FILE [--unthrottled]]" << std::endl;
+			return 1;
+		}
+	}
+
 	try
 	{
-		Application app;
+		Application app(replay);
 		app.Run();
 	}
 	catch (std::runtime_error& e)
@@ -16,4 +38,4 @@ int main()
 		std::cout << e.what() << std::endl;
 	}
 
-}
\ No newline at end of file
+}
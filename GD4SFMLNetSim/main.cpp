@@ -0,0 +1,155 @@
+#include "NetworkConditions.hpp"
+#include "NetworkProtocol.hpp"
+#include "NetworkProxy.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+//Network simulator: a proxy between clients and a GameServer that adds latency, jitter, loss, reordering and bandwidth caps
+//Run the server on another port, then point clients or GD4SFMLBot at the proxy's port
+//Condition settings are --latency MS, --jitter MS, --loss PERCENT, --reorder PERCENT and --bandwidth KBITS, an up. or down. prefix applies one to that direction only
+//Usage: GD4SFMLNetSim [--port N] [--server-host ADDRESS] [--server-port N] [--seed N] [--script FILE] [SETTINGS]
+
+namespace
+{
+	volatile std::sig_atomic_t g_running = 1;
+
+	struct SimulatorSettings
+	{
+		unsigned short m_port = SERVER_PORT;
+		sf::IpAddress m_server_host = sf::IpAddress::LocalHost;
+		unsigned short m_server_port = SERVER_PORT + 1;
+		unsigned int m_seed = 1;
+		std::string m_script_path;
+		NetworkConditions m_conditions;
+	};
+
+	const sf::Time kMaxWait = sf::milliseconds(10);
+	const sf::Time kReportInterval = sf::seconds(5.f);
+
+	void HandleSignal(int)
+	{
+		g_running = 0;
+	}
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: GD4SFMLNetSim [--port N] [--server-host ADDRESS] [--server-port N] [--seed N] [--script FILE] [--latency MS] [--jitter MS] [--loss PERCENT] [--reorder PERCENT] [--bandwidth KBITS]" << std::endl;
+		std::cout << "Prefix a condition with up. or down. to set one direction, for example --down.loss 5" << std::endl;
+	}
+
+	bool ParseArguments(int argc, char* argv[], SimulatorSettings& settings)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string argument = argv[i];
+			if (argument == "--help" || argument == "-h")
+			{
+				return false;
+			}
+
+			if (i + 1 >= argc)
+			{
+				std::cout << "Missing value for " << argument << std::endl;
+				return false;
+			}
+
+			std::string value = argv[++i];
+			if (argument == "--port")
+			{
+				settings.m_port = static_cast<unsigned short>(std::stoi(value));
+			}
+			else if (argument == "--server-host")
+			{
+				settings.m_server_host = sf::IpAddress(value);
+				if (settings.m_server_host == sf::IpAddress::None)
+				{
+					throw std::runtime_error("Could not resolve " + value);
+				}
+			}
+			else if (argument == "--server-port")
+			{
+				settings.m_server_port = static_cast<unsigned short>(std::stoi(value));
+			}
+			else if (argument == "--seed")
+			{
+				settings.m_seed = static_cast<unsigned int>(std::stoul(value));
+			}
+			else if (argument == "--script")
+			{
+				settings.m_script_path = value;
+			}
+			else if (argument.compare(0, 2, "--") != 0 || !ConditionScript::ApplySetting(argument.substr(2), value, settings.m_conditions))
+			{
+				std::cout << "Unknown argument " << argument << " " << value << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		SimulatorSettings settings;
+		if (!ParseArguments(argc, argv, settings))
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+
+		ConditionScript script;
+		if (!settings.m_script_path.empty() && !script.Load(settings.m_script_path))
+		{
+			std::cout << "Could not load the script " << settings.m_script_path << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		std::signal(SIGINT, HandleSignal);
+		std::signal(SIGTERM, HandleSignal);
+
+		NetworkProxy proxy(settings.m_port, settings.m_server_host, settings.m_server_port, settings.m_seed);
+		if (!proxy.IsListening())
+		{
+			std::cout << "Could not listen on port " << settings.m_port << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		NetworkConditions conditions = settings.m_conditions;
+		proxy.SetConditions(conditions);
+		std::cout << "Forwarding port " << settings.m_port << " to " << settings.m_server_host << ":" << settings.m_server_port << ", " << ConditionScript::ToString(conditions) << std::endl;
+
+		//The script's clock starts with the proxy, so a run with the same script and seed sees the same conditions at the same times
+		sf::Clock clock;
+		sf::Time last_report = sf::Time::Zero;
+		while (g_running && !script.HasEnded())
+		{
+			proxy.Update(kMaxWait);
+			if (script.Update(clock.getElapsedTime(), conditions))
+			{
+				proxy.SetConditions(conditions);
+			}
+
+			if (clock.getElapsedTime() - last_report >= kReportInterval)
+			{
+				std::cout << proxy.GetReport() << std::endl;
+				last_report = clock.getElapsedTime();
+			}
+		}
+		std::cout << proxy.GetReport() << std::endl;
+	}
+	catch (std::exception& e)
+	{
+		std::cout << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
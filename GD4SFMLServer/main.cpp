@@ -0,0 +1,147 @@
+#include "MatchHost.hpp"
+#include "ServerSettings.hpp"
+
+#include <SFML/System/Sleep.hpp>
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+//Dedicated server: runs matches without a window, fonts or textures
+//Every room is a separate match, --max-players applies to each room
+//Usage: GD4SFMLServer [--port N] [--tick-rate HZ] [--max-players N] [--max-queued-kb N] [--snapshot-bytes N] [--rooms N] [--threads N] [--record FILE]
+
+namespace
+{
+	volatile std::sig_atomic_t g_running = 1;
+	const std::size_t kDedicatedMaxPlayers = 512;
+
+	void HandleSignal(int)
+	{
+		g_running = 0;
+	}
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: GD4SFMLServer [--port N] [--tick-rate HZ] [--max-players N] [--max-queued-kb N] [--snapshot-bytes N] [--rooms N] [--threads N] [--record FILE]" << std::endl;
+	}
+
+	//How the matches are spread over the process, the rest is per room
+	struct HostSettings
+	{
+		std::size_t m_rooms = 1;
+		//0 uses one worker per core
+		std::size_t m_threads = 0;
+	};
+
+	bool ParseArguments(int argc, char* argv[], ServerSettings& settings, HostSettings& host_settings)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string argument = argv[i];
+			if (argument == "--help" || argument == "-h")
+			{
+				return false;
+			}
+
+			if (i + 1 >= argc)
+			{
+				std::cout << "Missing value for " << argument << std::endl;
+				return false;
+			}
+
+			std::string value = argv[++i];
+			if (argument == "--port")
+			{
+				settings.m_port = static_cast<unsigned short>(std::stoi(value));
+			}
+			else if (argument == "--tick-rate")
+			{
+				float ticks_per_second = std::stof(value);
+				if (ticks_per_second <= 0.f)
+				{
+					throw std::runtime_error("Tick rate must be positive");
+				}
+				settings.m_tick_rate = sf::seconds(1.f / ticks_per_second);
+			}
+			else if (argument == "--max-players")
+			{
+				settings.m_max_players = static_cast<std::size_t>(std::stoul(value));
+			}
+			else if (argument == "--max-queued-kb")
+			{
+				settings.m_max_queued_bytes = static_cast<std::size_t>(std::stoul(value)) * 1024;
+			}
+			else if (argument == "--snapshot-bytes")
+			{
+				settings.m_snapshot_byte_budget = static_cast<std::size_t>(std::stoul(value));
+			}
+			else if (argument == "--rooms")
+			{
+				host_settings.m_rooms = static_cast<std::size_t>(std::stoul(value));
+				if (host_settings.m_rooms == 0)
+				{
+					throw std::runtime_error("At least one room is needed");
+				}
+			}
+			else if (argument == "--threads")
+			{
+				host_settings.m_threads = static_cast<std::size_t>(std::stoul(value));
+			}
+			else if (argument == "--record")
+			{
+				settings.m_replay_path = value;
+			}
+			else
+			{
+				std::cout << "Unknown argument " << argument << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		//Hosted games keep the small default, a dedicated server has the machine to itself
+		ServerSettings settings;
+		settings.m_max_players = kDedicatedMaxPlayers;
+		HostSettings host_settings;
+		if (!ParseArguments(argc, argv, settings, host_settings))
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+
+		std::signal(SIGINT, HandleSignal);
+		std::signal(SIGTERM, HandleSignal);
+
+		//The battlefield matches the client window
+		MatchHost server(sf::Vector2f(1024.f, 768.f), settings, host_settings.m_rooms, host_settings.m_threads);
+		if (!server.IsListening())
+		{
+			std::cout << "Could not listen on port " << settings.m_port << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		std::cout << "Server listening on port " << settings.m_port << " at " << 1.f / settings.m_tick_rate.asSeconds() << " ticks/s, " << host_settings.m_rooms << " rooms of " << settings.m_max_players << " players on " << server.GetThreadCount() << " threads" << std::endl;
+
+		//The rooms run on the host's threads, this one only waits for a shutdown signal
+		while (g_running)
+		{
+			sf::sleep(sf::milliseconds(100));
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::cout << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "TestCheck.hpp"
+#include "ClockSync.hpp"
+#include "Interpolation.hpp"
+
+namespace
+{
+	const sf::Time kTickInterval = sf::milliseconds(50);
+	//The server started this long before the client
+	const sf::Time kServerAhead = sf::seconds(90.f);
+
+	sf::Time Abs(sf::Time time)
+	{
+		return time < sf::Time::Zero ? -time : time;
+	}
+
+	void TestClockSyncFindsServerTime()
+	{
+		ClockSync clock_sync;
+		CHECK(!clock_sync.IsSynchronised());
+
+		//Replies take 20ms back, but some pings wait up to 60ms on the way out
+		for (int i = 0; i < 16; ++i)
+		{
+			sf::Time sent_time = sf::milliseconds(250 * i);
+			sf::Time outbound = sf::milliseconds(20 + (i % 3) * 20);
+			sf::Time server_time = sent_time + outbound + kServerAhead;
+			clock_sync.OnPong(sent_time, server_time, sent_time + outbound + sf::milliseconds(20));
+		}
+
+		CHECK(clock_sync.IsSynchronised());
+		CHECK(Abs(clock_sync.GetServerTime(sf::seconds(10.f)) - (sf::seconds(10.f) + kServerAhead)) < sf::milliseconds(5));
+	}
+
+	void TestRenderTimeTrailsNewestSnapshot()
+	{
+		ClockSync clock_sync;
+		clock_sync.OnPong(sf::Time::Zero, kServerAhead + sf::milliseconds(30), sf::milliseconds(60));
+
+		//Snapshots reach the client 30ms after their tick, some are held up another tick
+		InterpolationClock interpolation_clock(kTickInterval);
+		sf::Uint32 first_tick = static_cast<sf::Uint32>(kServerAhead.asMicroseconds() / kTickInterval.asMicroseconds());
+		for (sf::Uint32 tick = first_tick; tick < first_tick + 100; ++tick)
+		{
+			sf::Time delay = sf::milliseconds(30) + (tick % 5 == 0 ? kTickInterval : sf::Time::Zero);
+			sf::Time local_time = interpolation_clock.GetServerTime(tick) - kServerAhead + delay;
+			interpolation_clock.OnSnapshot(tick, clock_sync.GetServerTime(local_time));
+		}
+
+		//Drawn between snapshots that have arrived, not so far back that the view lags needlessly
+		sf::Uint32 newest_tick = first_tick + 99;
+		sf::Time now = clock_sync.GetServerTime(interpolation_clock.GetServerTime(newest_tick) - kServerAhead + sf::milliseconds(30));
+		sf::Time render_time = interpolation_clock.GetRenderTime(now);
+		CHECK(render_time <= interpolation_clock.GetServerTime(newest_tick) - kTickInterval);
+		CHECK(render_time >= interpolation_clock.GetServerTime(newest_tick) - kTickInterval * static_cast<sf::Int64>(6));
+		CHECK(interpolation_clock.GetJitter() > sf::Time::Zero);
+	}
+}
+
+void RunClockTests()
+{
+	TestClockSyncFindsServerTime();
+	TestRenderTimeTrailsNewestSnapshot();
+}
@@ -0,0 +1,143 @@
+#include "TestCheck.hpp"
+#include "BitStream.hpp"
+#include "NetworkProtocol.hpp"
+#include "PositionCodec.hpp"
+
+#include <SFML/Network/Packet.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	//Positions across the battlefield, the world's height and the margins around them
+	std::vector<sf::Vector2f> GetSamplePositions()
+	{
+		std::vector<sf::Vector2f> positions;
+		for (float x = -500.f; x <= 1530.f; x += 37.3f)
+		{
+			for (float y = -1000.f; y <= 6140.f; y += 211.7f)
+			{
+				positions.emplace_back(x, y);
+			}
+		}
+		return positions;
+	}
+
+	bool WithinPrecision(sf::Vector2f lhs, sf::Vector2f rhs)
+	{
+		//Rounding to the nearest step is off by at most half a step, the rest is float error
+		const float tolerance = POSITION_PRECISION / 2.f + 0.001f;
+		return std::abs(lhs.x - rhs.x) <= tolerance && std::abs(lhs.y - rhs.y) <= tolerance;
+	}
+
+	void TestBitPackedRoundTrip()
+	{
+		BitWriter writer;
+		std::vector<sf::Vector2f> positions = GetSamplePositions();
+		for (sf::Vector2f position : positions)
+		{
+			PositionCodec::Write(writer, position);
+		}
+
+		BitReader reader(writer.GetData(), writer.GetByteCount());
+		for (sf::Vector2f position : positions)
+		{
+			CHECK(WithinPrecision(PositionCodec::Read(reader), position));
+		}
+		CHECK(reader.IsValid());
+	}
+
+	void TestPacketRoundTrip()
+	{
+		sf::Packet packet;
+		std::vector<sf::Vector2f> positions = GetSamplePositions();
+		for (sf::Vector2f position : positions)
+		{
+			PositionCodec::Write(packet, position);
+		}
+
+		for (sf::Vector2f position : positions)
+		{
+			CHECK(WithinPrecision(PositionCodec::Read(packet), position));
+		}
+	}
+
+	void TestRoundIsStable()
+	{
+		for (sf::Vector2f position : GetSamplePositions())
+		{
+			sf::Vector2f rounded = PositionCodec::Round(position);
+			CHECK(PositionCodec::Round(rounded) == rounded);
+			CHECK(WithinPrecision(rounded, position));
+		}
+	}
+
+	void TestDeltaRoundTrip()
+	{
+		//Drifting in place, one tick at full speed, a round trip's worth of ticks, the whole snapshot history and a respawn
+		const sf::Vector2f moves[] =
+		{
+			sf::Vector2f(0.f, 0.f),
+			sf::Vector2f(1.5f, -2.f),
+			sf::Vector2f(20.f, 0.f),
+			sf::Vector2f(-14.2f, 14.2f),
+			sf::Vector2f(60.f, -60.f),
+			sf::Vector2f(-640.f, 640.f),
+			sf::Vector2f(900.f, -3000.f)
+		};
+
+		sf::Vector2f from = PositionCodec::Round(sf::Vector2f(500.f, 4000.f));
+		for (sf::Vector2f move : moves)
+		{
+			sf::Vector2f to = PositionCodec::Round(from + move);
+			BitWriter writer;
+			PositionCodec::WriteDelta(writer, from, to);
+			BitReader reader(writer.GetData(), writer.GetByteCount());
+			CHECK(PositionCodec::ReadDelta(reader, from) == to);
+			CHECK(reader.IsValid());
+		}
+	}
+
+	void TestDeltaIsSmaller()
+	{
+		BitWriter full;
+		PositionCodec::Write(full, sf::Vector2f(500.f, 4000.f));
+
+		//Anything a baseline can be behind by at full speed is cheaper as a delta than as a position
+		const sf::Vector2f moves[] =
+		{
+			sf::Vector2f(0.f, 0.f),
+			sf::Vector2f(20.f, 0.f),
+			sf::Vector2f(0.f, -60.f),
+			sf::Vector2f(640.f, 0.f),
+			sf::Vector2f(-452.f, -452.f)
+		};
+
+		sf::Vector2f from = PositionCodec::Round(sf::Vector2f(500.f, 4000.f));
+		std::size_t previous_bits = 0;
+		for (sf::Vector2f move : moves)
+		{
+			BitWriter delta;
+			PositionCodec::WriteDelta(delta, from, PositionCodec::Round(from + move));
+			CHECK(delta.GetBitCount() < full.GetBitCount());
+			//Longer moves never take fewer bits
+			CHECK(delta.GetBitCount() >= previous_bits);
+			previous_bits = delta.GetBitCount();
+		}
+
+		//A single tick at full speed is the common case and should take well under a full position
+		BitWriter one_tick;
+		PositionCodec::WriteDelta(one_tick, from, PositionCodec::Round(from + sf::Vector2f(20.f, 0.f)));
+		CHECK(one_tick.GetBitCount() * 4 <= full.GetBitCount() * 3);
+	}
+}
+
+void RunPositionCodecTests()
+{
+	TestBitPackedRoundTrip();
+	TestPacketRoundTrip();
+	TestRoundIsStable();
+	TestDeltaRoundTrip();
+	TestDeltaIsSmaller();
+}
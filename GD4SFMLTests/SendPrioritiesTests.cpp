@@ -0,0 +1,137 @@
+#include "TestCheck.hpp"
+#include "BitStream.hpp"
+#include "PositionCodec.hpp"
+#include "SendPriorities.hpp"
+#include "Snapshot.hpp"
+
+#include <map>
+#include <vector>
+
+namespace
+{
+	const sf::Int32 kOwnAircraft = 1;
+	const sf::Int32 kAircraftCount = 60;
+
+	//The peer's own aircraft sits at the left edge, the others spread out to the right of it and weave up and down
+	Snapshot::AircraftState GetState(sf::Int32 identifier, sf::Uint32 tick)
+	{
+		Snapshot::AircraftState state;
+		float x = 20.f * (identifier - 1);
+		float y = 3000.f + ((tick + identifier) % 8 < 4 ? 20.f : -20.f) * ((tick + identifier) % 4);
+		state.m_position = PositionCodec::Round(sf::Vector2f(x, y));
+		return state;
+	}
+
+	void TestForgetsHiddenAircraft()
+	{
+		SendPriorities priorities;
+		std::vector<SendPriorities::VisibleAircraft> visible = { { 2, sf::Vector2f(0.f, 0.f), sf::Vector2f() }, { 3, sf::Vector2f(1000.f, 0.f), sf::Vector2f() } };
+		std::vector<sf::Vector2f> viewers = { sf::Vector2f(0.f, 0.f) };
+		priorities.Update(visible, viewers);
+		priorities.Update(visible, viewers);
+		CHECK(priorities.GetPriority(2) > priorities.GetPriority(3));
+		CHECK(priorities.GetPriority(3) > 0.f);
+
+		//Aircraft 3 leaves the area of interest and comes back with nothing owed
+		visible.pop_back();
+		priorities.Update(visible, viewers);
+		CHECK(priorities.GetPriority(3) == 0.f);
+
+		priorities.MarkAllSent();
+		CHECK(priorities.GetPriority(2) == 0.f);
+	}
+
+	void TestVelocityChangeRaisesPriority()
+	{
+		SendPriorities priorities;
+		std::vector<SendPriorities::VisibleAircraft> visible = { { 2, sf::Vector2f(500.f, 0.f), sf::Vector2f(400.f, 0.f) }, { 3, sf::Vector2f(500.f, 0.f), sf::Vector2f(400.f, 0.f) } };
+		std::vector<sf::Vector2f> viewers = { sf::Vector2f(0.f, 0.f) };
+		priorities.Update(visible, viewers);
+		priorities.MarkAllSent();
+
+		//Same distance, but 2 turned around since it was last sent
+		visible[0].m_velocity = sf::Vector2f(-400.f, 0.f);
+		priorities.Update(visible, viewers);
+		CHECK(priorities.GetPriority(2) > priorities.GetPriority(3));
+	}
+
+	void TestBudgetFavoursNearAircraft()
+	{
+		const std::size_t budget_bits = 80 * 8;
+		const sf::Uint32 tick_count = 200;
+		//The peer acknowledges each snapshot this many ticks after it was sent
+		const sf::Uint32 ack_delay = 3;
+
+		SendPriorities priorities;
+		SnapshotBuffer sent_snapshots;
+		SnapshotBuffer received_snapshots;
+		std::map<sf::Int32, int> send_counts;
+		std::vector<sf::Int32> always_sent = { kOwnAircraft };
+
+		for (sf::Uint32 tick = 1; tick <= tick_count; ++tick)
+		{
+			Snapshot full;
+			full.m_tick = tick;
+			std::vector<SendPriorities::VisibleAircraft> visible;
+			for (sf::Int32 identifier = 1; identifier <= kAircraftCount; ++identifier)
+			{
+				full.m_aircraft[identifier] = GetState(identifier, tick);
+				visible.push_back({ identifier, full.m_aircraft[identifier].m_position, sf::Vector2f() });
+			}
+			priorities.Update(visible, { full.m_aircraft[kOwnAircraft].m_position });
+
+			SnapshotPtr baseline = tick > ack_delay ? sent_snapshots.Find(tick - ack_delay) : nullptr;
+			SnapshotPtr snapshot = BuildBudgetedSnapshot(full, baseline.get(), always_sent, priorities, budget_bits);
+			sent_snapshots.Insert(snapshot);
+
+			BitWriter writer;
+			WriteSnapshotDelta(writer, baseline.get(), *snapshot);
+			CHECK(writer.GetBitCount() <= budget_bits);
+
+			//Decode it the way the client does and check it arrives at the snapshot the server remembers
+			BitReader reader(writer.GetData(), writer.GetByteCount());
+			sf::Uint32 received_tick;
+			sf::Uint32 baseline_tick;
+			CHECK(ReadSnapshotHeader(reader, received_tick, baseline_tick));
+			std::shared_ptr<Snapshot> received(new Snapshot());
+			received->m_tick = received_tick;
+			std::vector<sf::Int32> written;
+			CHECK(ReadSnapshotDelta(reader, received_snapshots.Find(baseline_tick).get(), *received, &written));
+			received_snapshots.Insert(received);
+
+			CHECK(received->m_aircraft.size() == snapshot->m_aircraft.size());
+			for (const auto& aircraft : snapshot->m_aircraft)
+			{
+				auto itr = received->m_aircraft.find(aircraft.first);
+				CHECK(itr != received->m_aircraft.end() && SameAircraftState(itr->second, aircraft.second));
+			}
+
+			for (sf::Int32 identifier : written)
+			{
+				++send_counts[identifier];
+			}
+		}
+
+		//The view is too crowded to send everything every tick
+		int total_sends = 0;
+		for (const auto& count : send_counts)
+		{
+			total_sends += count.second;
+		}
+		CHECK(total_sends < static_cast<int>(tick_count) * kAircraftCount / 2);
+
+		//The peer's own aircraft moves every tick it is checked, close ones go out more often than distant ones, and distant ones still go out
+		int near_sends = send_counts[2] + send_counts[3] + send_counts[4];
+		int far_sends = send_counts[kAircraftCount - 2] + send_counts[kAircraftCount - 1] + send_counts[kAircraftCount];
+		CHECK(send_counts[kOwnAircraft] == static_cast<int>(tick_count));
+		CHECK(near_sends > far_sends * 2);
+		CHECK(send_counts[kAircraftCount] >= static_cast<int>(tick_count) / 20);
+	}
+}
+
+void RunSendPrioritiesTests()
+{
+	TestForgetsHiddenAircraft();
+	TestVelocityChangeRaisesPriority();
+	TestBudgetFavoursNearAircraft();
+}
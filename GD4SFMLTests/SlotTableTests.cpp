@@ -0,0 +1,30 @@
+#include "TestCheck.hpp"
+#include "SlotTable.hpp"
+
+namespace
+{
+	void TestRemovingAnEmptySlot()
+	{
+		SlotTable<int> table;
+		std::size_t first = table.Add(SlotTable<int>::Ptr(new int(1)));
+		std::size_t second = table.Add(SlotTable<int>::Ptr(new int(2)));
+
+		CHECK(table.Remove(first) != nullptr);
+		CHECK(table.Remove(first) == nullptr);
+		CHECK(table.GetSize() == 1);
+		CHECK(*table.Get(second) == 2);
+
+		//The slot was freed once, so only one new object may take it
+		std::size_t third = table.Add(SlotTable<int>::Ptr(new int(3)));
+		std::size_t fourth = table.Add(SlotTable<int>::Ptr(new int(4)));
+		CHECK(third != fourth);
+		CHECK(*table.Get(third) == 3);
+		CHECK(*table.Get(fourth) == 4);
+		CHECK(table.GetSize() == 3);
+	}
+}
+
+void RunSlotTableTests()
+{
+	TestRemovingAnEmptySlot();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+//A failed check prints the expression and where it is, the run carries on and exits with a failure at the end
+#define CHECK(condition) Tests::Check((condition), #condition, __FILE__, __LINE__)
+
+namespace Tests
+{
+	void Check(bool passed, const char* expression, const char* file, int line);
+	int GetFailureCount();
+}
+
+void RunClockTests();
+void RunPositionCodecTests();
+void RunSendPrioritiesTests();
+void RunSlotTableTests();
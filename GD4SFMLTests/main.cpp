@@ -0,0 +1,42 @@
+#include "TestCheck.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+//Checks for the parts of the networking code that can run without a window or a connection
+//Usage: GD4SFMLTests, exits with a failure if any check failed
+
+namespace
+{
+	int g_failures = 0;
+}
+
+void Tests::Check(bool passed, const char* expression, const char* file, int line)
+{
+	if (!passed)
+	{
+		std::cout << file << "(" << line << "): check failed: " << expression << std::endl;
+		++g_failures;
+	}
+}
+
+int Tests::GetFailureCount()
+{
+	return g_failures;
+}
+
+int main()
+{
+	RunClockTests();
+	RunPositionCodecTests();
+	RunSendPrioritiesTests();
+	RunSlotTableTests();
+
+	if (Tests::GetFailureCount() > 0)
+	{
+		std::cout << Tests::GetFailureCount() << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}